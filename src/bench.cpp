@@ -0,0 +1,669 @@
+/**
+ ************** TORUS PARTICLE SIMULATOR (BENCHMARKS) **************
+ *
+ * Measures the solvers on generated workloads, for tracking
+ * performance regressions and comparing algorithms. Two kinds
+ * of benchmark are run:
+ *
+ *   - Microbenchmarks, timing each phase of SpatialHashSolver
+ *     steps apart (as timed in each step's SolverStats):
+ *     populating the grid, checking cells for overlapping pairs,
+ *     resolving the pairs, and integrating positions (which also
+ *     bins the balls for the next step).
+ *   - End-to-end runs, stepping a solver for a fixed time.
+ *
+ * Both are repeated for each thread count, and every result is
+ * written as JSON and CSV, with steps per second, ball-steps per
+ * second, pair tests per second (for solvers that count them)
+ * and the parallel efficiency relative to the fewest threads run.
+ *
+ * The workloads fill a world of area 4 at a fixed packing
+ * fraction whatever the number of balls, shrinking the balls as
+ * their number grows:
+ *     dilute        one size, 5% of the area covered
+ *     dense         one size, 40% covered
+ *     clustered     one size, 5% covered, in 16 Gaussian clumps
+ *     polydisperse  the sizes and area shares of preset2.json
+ *     anisotropic   the sizes and area shares of preset5.json,
+ *                   in a world 3 times wider than it is tall
+ * The timestep moves a typical ball about twice the smallest
+ * radius per step.
+ *
+ * Usage:
+ *     ./TorusParticlesBench [--workloads W,...] [--sizes N,...] [--threads P,...]
+ *                           [--solvers S,...] [--seconds T] [--micro-balls N]
+ *                           [--no-micro] [--no-runs] [--autotune]
+ *                           [--json FILE] [--csv FILE]
+ *
+ * --workloads W  Workloads to run (default all five)
+ * --sizes N      Numbers of balls for end-to-end runs (default
+ *                1000,10000,100000,1000000,10000000)
+ * --threads P    Thread counts (default 1, 2, 4, ... up to the
+ *                number of hardware threads)
+ * --solvers S    Solvers for end-to-end runs (default SpatialHash).
+ *                Only SpatialHash accepts the clustered workload
+ * --seconds T    Time spent on each benchmark (default 1), after a
+ *                few warm-up steps
+ * --micro-balls N  Number of balls for microbenchmarks (default 100000)
+ * --no-micro, --no-runs  Skip the microbenchmarks or end-to-end runs
+ * --autotune     Let the grid resolution be tuned during runs (off
+ *                by default, so results are repeatable)
+ * --json, --csv  Where to write the results (default bench.json and
+ *                bench.csv)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <memory>
+#include <algorithm>
+
+#include "json/json.h"
+
+#include "createSolver.hpp"
+#include "SpatialHashSolver.hpp"
+#include "Topology.hpp"
+
+static const char* USAGE =
+    "Usage: TorusParticlesBench [--workloads W,...] [--sizes N,...] [--threads P,...]\n"
+    "                           [--solvers S,...] [--seconds T] [--micro-balls N]\n"
+    "                           [--no-micro] [--no-runs] [--autotune] [--json FILE] [--csv FILE]";
+
+static const unsigned int WARMUP_STEPS = 3;
+
+struct BenchResult
+{
+    std::string  kind;     // "micro" or "run"
+    std::string  workload;
+    std::string  solver;
+    std::string  phase;    // Phase of the step timed ("step" for end-to-end runs)
+    std::size_t  numBalls;
+    unsigned int numThreads;
+    std::size_t  numSteps;
+    double       seconds;
+    double       stepsPerSecond;     // Calls of the phase per second for microbenchmarks
+    double       ballStepsPerSecond;
+    double       pairTestsPerSecond; // Negative if not measured
+    double       efficiency;         // Speedup over the fewest threads run, divided by the increase in threads
+};
+
+// A generated workload: a preset, and positions for the balls if not uniformly random
+struct Workload
+{
+    Preset preset;
+    bool   clustered = false;
+};
+
+// Time spent in each phase of a SpatialHashSolver's steps, summed from their SolverStats
+struct PhaseSeconds
+{
+    double populate  = 0.0;
+    double check     = 0.0;
+    double resolve   = 0.0;
+    double integrate = 0.0;
+    std::size_t pairTests = 0;
+    std::size_t numSteps  = 0;
+};
+
+static PhaseSeconds timePhases(Solver& solver, float dt, double timeBudget)
+/**
+ * Step the solver until timeBudget seconds have passed,
+ * adding up the time each step's SolverStats gives for
+ * each phase.
+ */
+{
+    using Clock = std::chrono::steady_clock;
+    PhaseSeconds seconds;
+
+    auto begin = Clock::now();
+
+    while (seconds.numSteps < 2 || std::chrono::duration<double>(Clock::now() - begin).count() < timeBudget)
+    {
+        solver.update(dt);
+
+        const SolverStats& stats = solver.getStats();
+
+        seconds.populate  += stats.populateSeconds;
+        seconds.check     += stats.checkSeconds;
+        seconds.resolve   += stats.resolveSeconds;
+        seconds.integrate += stats.integrateSeconds;
+        seconds.pairTests += stats.pairTests;
+        seconds.numSteps++;
+    }
+
+    return seconds;
+}
+
+static std::unique_ptr<SpatialHashSolver> createClustered(const Preset& preset)
+/**
+ * A SpatialHashSolver whose balls lie in Gaussian clumps,
+ * with random velocities as in a preset.
+ */
+{
+    const std::size_t NUM_CLUMPS = 16;
+
+    World world(preset.worldAspectRatio);
+    Particles particles = Solver::randomParticles(preset.ballTypes, world, preset.seed, preset.numThreads);
+
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<float> xCentre(world.xMin, world.xMax);
+    std::uniform_real_distribution<float> yCentre(world.yMin, world.yMax);
+    std::uniform_int_distribution<std::size_t> clump(0, NUM_CLUMPS - 1);
+    std::normal_distribution<float> offset(0.0f, 0.08f);
+
+    std::vector<float> xCentres(NUM_CLUMPS), yCentres(NUM_CLUMPS);
+    for (std::size_t i = 0; i < NUM_CLUMPS; i++)
+    {
+        xCentres[i] = xCentre(gen);
+        yCentres[i] = yCentre(gen);
+    }
+
+    auto wrap = [](float position, float lower, float width)
+    {
+        return lower + (position - lower) - width * std::floor((position - lower) / width);
+    };
+
+    for (std::size_t i = 0; i < particles.size(); i++)
+    {
+        std::size_t c = clump(gen);
+        particles.x[i] = wrap(xCentres[c] + offset(gen), world.xMin, world.xWidth);
+        particles.y[i] = wrap(yCentres[c] + offset(gen), world.yMin, world.yWidth);
+    }
+
+    return std::make_unique<SpatialHashSolver>(preset, world, std::move(particles));
+}
+
+static BallType makeBallType(float mass, float radius, std::size_t count)
+{
+    BallType ballType;
+    ballType.mass = mass;
+    ballType.radius = radius;
+    ballType.count = count;
+    ballType.rgba = { 1.0f, 1.0f, 1.0f, 1.0f };
+    ballType.totalMomentum = { 0.0f, 0.0f };
+    ballType.wrapTexture = true;
+    ballType.render = true;
+    return ballType;
+}
+
+static Workload makeWorkload(const std::string& name, std::size_t numBalls)
+/**
+ * Generate the named workload with about numBalls balls (see
+ * the top of this file). Mixtures keep the ratio of their
+ * counts, and the share of the area covered by each size, by
+ * multiplying the counts and dividing the radii by the square
+ * root of the same factor.
+ */
+{
+    const float area = 4.0f;
+    const float pi   = 3.14159265f;
+
+    Workload workload;
+    Preset& preset = workload.preset;
+    preset.worldAspectRatio = 1.0f;
+    preset.antialiasing = false;
+    preset.loadSuccessful = true;
+
+    std::vector<BallType>& ballTypes = preset.ballTypes;
+
+    if (name == "dilute" || name == "dense" || name == "clustered")
+    {
+        float packing = name == "dense" ? 0.4f : 0.05f;
+        float radius  = std::sqrt(packing * area / (pi * static_cast<float>(numBalls)));
+
+        ballTypes.push_back(makeBallType(1.0f, radius, numBalls));
+        workload.clustered = name == "clustered";
+    }
+    else
+    {
+        // Masses, radii and counts of the presets
+        if (name == "polydisperse")
+        {
+            ballTypes = { makeBallType(6.4f, 0.15f, 2), makeBallType(3.4f, 0.07f, 10),
+                          makeBallType(1.5f, 0.04f, 30), makeBallType(0.1f, 0.005f, 5000) };
+        }
+        else
+        {
+            preset.worldAspectRatio = 3.0f;
+            ballTypes = { makeBallType(6.4f, 0.09f, 4), makeBallType(3.4f, 0.04f, 20),
+                          makeBallType(1.5f, 0.025f, 60), makeBallType(0.5f, 0.015f, 120) };
+        }
+
+        std::size_t presetBalls = 0;
+        for (const BallType& ballType : ballTypes)
+            presetBalls += ballType.count;
+
+        float scale = static_cast<float>(numBalls) / static_cast<float>(presetBalls);
+
+        for (BallType& ballType : ballTypes)
+        {
+            ballType.count  = std::max<std::size_t>(1, static_cast<std::size_t>(std::round(ballType.count * scale)));
+            ballType.radius = ballType.radius / std::sqrt(scale);
+        }
+    }
+
+    float minRadius = ballTypes[0].radius;
+    for (const BallType& ballType : ballTypes)
+        minRadius = std::min(minRadius, ballType.radius);
+
+    preset.dt = 2.0f * minRadius / 0.12f; // Balls are given velocities with a spread of 0.12 (see Solver::randomParticles())
+
+    return workload;
+}
+
+static bool isWorkload(const std::string& name)
+{
+    return name == "dilute" || name == "dense" || name == "clustered" || name == "polydisperse" || name == "anisotropic";
+}
+
+static std::unique_ptr<Solver> createWorkloadSolver(const Workload& workload)
+{
+    if (workload.clustered)
+        return createClustered(workload.preset);
+
+    return createSolver(workload.preset);
+}
+
+static std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+
+    return items;
+}
+
+static void setEfficiency(BenchResult& result, const std::vector<BenchResult>& results)
+/**
+ * Compare a result with the first result of the same benchmark
+ * (thread counts run in increasing order, so the one with the
+ * fewest threads), in ball-steps per second.
+ */
+{
+    result.efficiency = 1.0;
+
+    for (const BenchResult& base : results)
+    {
+        if (base.kind == result.kind && base.workload == result.workload && base.solver == result.solver
+            && base.phase == result.phase && base.numBalls == result.numBalls)
+        {
+            double speedup = base.ballStepsPerSecond > 0.0 ? result.ballStepsPerSecond / base.ballStepsPerSecond : 0.0;
+            result.efficiency = speedup * static_cast<double>(base.numThreads) / static_cast<double>(result.numThreads);
+            return;
+        }
+    }
+}
+
+static void printResult(const BenchResult& result)
+{
+    std::cout << std::fixed
+              << "  " << std::left << std::setw(6) << result.kind << std::setw(14) << result.workload
+              << std::setw(15) << result.solver << std::setw(10) << result.phase << std::right
+              << std::setw(10) << result.numBalls << std::setw(8) << result.numThreads
+              << std::setprecision(1) << std::setw(12) << result.stepsPerSecond
+              << std::setprecision(0) << std::setw(15) << result.ballStepsPerSecond
+              << std::setw(15);
+
+    if (result.pairTestsPerSecond >= 0.0)
+        std::cout << result.pairTestsPerSecond;
+    else
+        std::cout << "-";
+
+    std::cout << std::setprecision(2) << std::setw(12) << result.efficiency << std::defaultfloat << std::endl;
+}
+
+static void addResult(BenchResult result, std::vector<BenchResult>& results)
+{
+    setEfficiency(result, results);
+    printResult(result);
+    results.push_back(result);
+}
+
+static bool allFinite(const Solver& solver, const std::string& workloadName)
+/**
+ * A run whose particles went non-finite (e.g. NaN velocities
+ * spreading through collisions) measured nothing useful, so
+ * is reported as an error rather than as a result.
+ */
+{
+    const Particles& particles = solver.getParticles();
+
+    for (std::size_t i = 0; i < particles.size(); i++)
+    {
+        if (!std::isfinite(particles.x[i]) || !std::isfinite(particles.y[i]) || !std::isfinite(particles.vx[i]) || !std::isfinite(particles.vy[i]))
+        {
+            std::cout << "Error: particle " << particles.id[i] << " of the " << workloadName << " workload (" << particles.size() << " balls) is no longer finite" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool runMicrobenchmarks(const std::string& workloadName, std::size_t numBalls, unsigned int numThreads,
+                               double timeBudget, std::vector<BenchResult>& results)
+{
+    Workload workload = makeWorkload(workloadName, numBalls);
+    workload.preset.numThreads = numThreads;
+    workload.preset.autoTuneGrid = false;
+
+    std::unique_ptr<SpatialHashSolver> solver = workload.clustered
+        ? createClustered(workload.preset)
+        : std::make_unique<SpatialHashSolver>(workload.preset);
+
+    for (unsigned int step = 0; step < WARMUP_STEPS; step++)
+        solver->update(workload.preset.dt);
+
+    PhaseSeconds seconds = timePhases(*solver, workload.preset.dt, timeBudget);
+
+    if (!allFinite(*solver, workloadName))
+        return false;
+
+    const std::pair<const char*, double> phases[] = {
+        { "populate", seconds.populate }, { "check", seconds.check },
+        { "resolve", seconds.resolve },   { "integrate", seconds.integrate }
+    };
+
+    for (const std::pair<const char*, double>& phase : phases)
+    {
+        BenchResult result;
+        result.kind = "micro";
+        result.workload = workloadName;
+        result.solver = "SpatialHash";
+        result.phase = phase.first;
+        result.numBalls = solver->getParticles().size();
+        result.numThreads = numThreads;
+        result.numSteps = seconds.numSteps;
+        result.seconds = phase.second;
+        result.stepsPerSecond = phase.second > 0.0 ? static_cast<double>(seconds.numSteps) / phase.second : 0.0;
+        result.ballStepsPerSecond = result.stepsPerSecond * static_cast<double>(result.numBalls);
+        result.pairTestsPerSecond = result.phase == "check" && phase.second > 0.0 ? static_cast<double>(seconds.pairTests) / phase.second : -1.0;
+
+        addResult(result, results);
+    }
+
+    return true;
+}
+
+static bool runEndToEnd(const std::string& workloadName, const std::string& solverName, std::size_t numBalls,
+                        unsigned int numThreads, double timeBudget, bool autoTune, std::vector<BenchResult>& results)
+{
+    Workload workload = makeWorkload(workloadName, numBalls);
+    workload.preset.solver = solverName;
+    workload.preset.numThreads = numThreads;
+    workload.preset.autoTuneGrid = autoTune;
+
+    std::unique_ptr<Solver> solver = createWorkloadSolver(workload);
+
+    if (!solver)
+        return false;
+
+    const float dt = workload.preset.dt;
+
+    for (unsigned int step = 0; step < WARMUP_STEPS; step++)
+        solver->update(dt);
+
+    std::size_t numSteps  = 0;
+    std::size_t pairTests = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+
+    while (numSteps < 2 || seconds < timeBudget)
+    {
+        solver->update(dt);
+        numSteps++;
+
+        pairTests += solver->getStats().pairTests;
+
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (!allFinite(*solver, workloadName))
+        return false;
+
+    BenchResult result;
+    result.kind = "run";
+    result.workload = workloadName;
+    result.solver = solverName;
+    result.phase = "step";
+    result.numBalls = solver->getParticles().size();
+    result.numThreads = numThreads;
+    result.numSteps = numSteps;
+    result.seconds = seconds;
+    result.stepsPerSecond = static_cast<double>(numSteps) / seconds;
+    result.ballStepsPerSecond = result.stepsPerSecond * static_cast<double>(result.numBalls);
+    result.pairTestsPerSecond = pairTests > 0 ? static_cast<double>(pairTests) / seconds : -1.0;
+
+    addResult(result, results);
+    return true;
+}
+
+static bool writeJson(const std::string& path, const std::vector<BenchResult>& results, const Json::Value& config)
+{
+    Json::Value root;
+    root["machine"]["hardwareThreads"] = std::thread::hardware_concurrency();
+    root["machine"]["topology"] = detectTopology().describe();
+    root["config"] = config;
+    root["results"] = Json::Value(Json::arrayValue);
+
+    for (const BenchResult& result : results)
+    {
+        Json::Value entry;
+        entry["kind"] = result.kind;
+        entry["workload"] = result.workload;
+        entry["solver"] = result.solver;
+        entry["phase"] = result.phase;
+        entry["balls"] = Json::UInt64(result.numBalls);
+        entry["threads"] = result.numThreads;
+        entry["steps"] = Json::UInt64(result.numSteps);
+        entry["seconds"] = result.seconds;
+        entry["stepsPerSecond"] = result.stepsPerSecond;
+        entry["ballStepsPerSecond"] = result.ballStepsPerSecond;
+        entry["pairTestsPerSecond"] = result.pairTestsPerSecond >= 0.0 ? Json::Value(result.pairTestsPerSecond) : Json::Value();
+        entry["efficiency"] = result.efficiency;
+        root["results"].append(entry);
+    }
+
+    std::ofstream file(path);
+
+    if (!file.is_open())
+    {
+        std::cout << "Error: could not write to \"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    file << Json::writeString(builder, root) << std::endl;
+    return true;
+}
+
+static bool writeCsv(const std::string& path, const std::vector<BenchResult>& results)
+{
+    std::ofstream file(path);
+
+    if (!file.is_open())
+    {
+        std::cout << "Error: could not write to \"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    file << "kind,workload,solver,phase,balls,threads,steps,seconds,stepsPerSecond,ballStepsPerSecond,pairTestsPerSecond,efficiency\n";
+    file << std::setprecision(9);
+
+    for (const BenchResult& result : results)
+    {
+        file << result.kind << "," << result.workload << "," << result.solver << "," << result.phase << ","
+             << result.numBalls << "," << result.numThreads << "," << result.numSteps << ","
+             << result.seconds << "," << result.stepsPerSecond << "," << result.ballStepsPerSecond << ",";
+
+        if (result.pairTestsPerSecond >= 0.0)
+            file << result.pairTestsPerSecond;
+
+        file << "," << result.efficiency << "\n";
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    // Defaults
+    std::vector<std::string> workloads = { "dilute", "dense", "clustered", "polydisperse", "anisotropic" };
+    std::vector<std::string> solvers   = { "SpatialHash" };
+    std::vector<std::size_t> sizes     = { 1000, 10000, 100000, 1000000, 10000000 };
+    std::vector<unsigned int> threads;
+    std::size_t microBalls = 100000;
+    double timeBudget = 1.0;
+    bool runMicro = true;
+    bool runRuns = true;
+    bool autoTune = false;
+    std::string jsonPath = "bench.json";
+    std::string csvPath = "bench.csv";
+
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int count = 1; count < hardwareThreads; count *= 2)
+        threads.push_back(count);
+    threads.push_back(hardwareThreads);
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if ((arg == "--sizes" || arg == "--threads" || arg == "--seconds" || arg == "--micro-balls") && i + 1 < argc)
+        {
+            try
+            {
+                if (arg == "--sizes")
+                {
+                    sizes.clear();
+                    for (const std::string& item : splitList(argv[++i]))
+                        sizes.push_back(static_cast<std::size_t>(std::stod(item))); // Accepts e.g. 1e6
+                }
+                else if (arg == "--threads")
+                {
+                    threads.clear();
+                    for (const std::string& item : splitList(argv[++i]))
+                        threads.push_back(static_cast<unsigned int>(std::stoul(item)));
+                }
+                else if (arg == "--seconds")
+                    timeBudget = std::stod(argv[++i]);
+                else
+                    microBalls = static_cast<std::size_t>(std::stod(argv[++i]));
+            }
+            catch (const std::exception&)
+            {
+                std::cout << "Error: invalid value for " << arg << std::endl;
+                return -1;
+            }
+        }
+        else if (arg == "--workloads" && i + 1 < argc)
+            workloads = splitList(argv[++i]);
+        else if (arg == "--solvers" && i + 1 < argc)
+            solvers = splitList(argv[++i]);
+        else if (arg == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (arg == "--csv" && i + 1 < argc)
+            csvPath = argv[++i];
+        else if (arg == "--no-micro")
+            runMicro = false;
+        else if (arg == "--no-runs")
+            runRuns = false;
+        else if (arg == "--autotune")
+            autoTune = true;
+        else
+        {
+            std::cout << "Error: unrecognised argument \"" << arg << "\"" << std::endl;
+            std::cout << USAGE << std::endl;
+            return -1;
+        }
+    }
+
+    for (const std::string& workload : workloads)
+    {
+        if (!isWorkload(workload))
+        {
+            std::cout << "Error: unknown workload \"" << workload << "\"" << std::endl;
+            return -1;
+        }
+    }
+
+    if (std::find(sizes.begin(), sizes.end(), 0) != sizes.end() || std::find(threads.begin(), threads.end(), 0u) != threads.end() || microBalls == 0)
+    {
+        std::cout << "Error: ball and thread counts must be positive" << std::endl;
+        return -1;
+    }
+
+    std::sort(threads.begin(), threads.end());
+    threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+    std::cout << "Topology: " << detectTopology().describe() << std::endl;
+    std::cout << "  kind  workload      solver         phase          balls threads     steps/s   ball-steps/s   pair tests/s  efficiency" << std::endl;
+
+    std::vector<BenchResult> results;
+
+    if (runMicro)
+    {
+        for (const std::string& workload : workloads)
+            for (unsigned int numThreads : threads)
+                if (!runMicrobenchmarks(workload, microBalls, numThreads, timeBudget, results))
+                    return -1;
+    }
+
+    if (runRuns)
+    {
+        for (const std::string& workload : workloads)
+        {
+            for (const std::string& solver : solvers)
+            {
+                if (workload == "clustered" && solver != "SpatialHash")
+                {
+                    std::cout << "  Skipping clustered workload for " << solver << " (only SpatialHash accepts generated positions)" << std::endl;
+                    continue;
+                }
+
+                for (std::size_t numBalls : sizes)
+                    for (unsigned int numThreads : threads)
+                        if (!runEndToEnd(workload, solver, numBalls, numThreads, timeBudget, autoTune, results))
+                            return -1;
+            }
+        }
+    }
+
+    // Record the settings alongside the results
+    Json::Value config;
+    for (const std::string& workload : workloads)
+        config["workloads"].append(workload);
+    for (const std::string& solver : solvers)
+        config["solvers"].append(solver);
+    for (std::size_t size : sizes)
+        config["sizes"].append(Json::UInt64(size));
+    for (unsigned int numThreads : threads)
+        config["threads"].append(numThreads);
+    config["microBalls"] = Json::UInt64(microBalls);
+    config["secondsPerBenchmark"] = timeBudget;
+    config["autoTuneGrid"] = autoTune;
+
+    bool written = writeJson(jsonPath, results, config);
+    written = writeCsv(csvPath, results) && written;
+
+    if (!written)
+        return -1;
+
+    std::cout << "Wrote " << results.size() << " results to " << jsonPath << " and " << csvPath << std::endl;
+
+    return 0;
+}
@@ -5,12 +5,13 @@
 #include <GLFW/glfw3.h>
 
 #include "Renderer.hpp"
+#include "Profiler.hpp"
 
-Renderer::Renderer(const Solver& solver, Preset preset, unsigned int xResolution, unsigned int yResolution)
-	: m_ballTypes(solver.getBallTypes()), 
-      m_balls(solver.getBalls()), 
-      m_world(solver.getWorld()),
-      m_window(solver, xResolution, yResolution),
+Renderer::Renderer(const ParticleSource& source, Preset preset, unsigned int xResolution, unsigned int yResolution)
+	: m_ballTypes(source.getBallTypes()), 
+      m_particles(source.getParticles()), 
+      m_world(source.getWorld()),
+      m_window(source, xResolution, yResolution),
       m_shader("shaders/shader.vs", preset.antialiasing ? "shaders/shaderAA.fs" : "shaders/shaderNoAA.fs"),
       m_texCoordsVBO(0),
       m_offsetsVBO(0)
@@ -116,13 +117,14 @@ void Renderer::setVertexAttributes(std::size_t ballTypeIndex)
     glBindVertexArray(m_VAOs[i]);
 
     // Create vertex buffer object for ball positions
+    // (all x-coordinates of the BallType, followed by all y-coordinates)
     glGenBuffers(1, &m_positionVBOs[i]);
     glBindBuffer(GL_ARRAY_BUFFER, m_positionVBOs[i]);
     glBufferData(
-        GL_ARRAY_BUFFER,                     // Target
-        m_ballTypes[i].count * sizeof(Ball), // Size (in bytes)
-        nullptr,                             // Data
-        GL_DYNAMIC_DRAW                      // Usage
+        GL_ARRAY_BUFFER,                          // Target
+        2 * m_ballTypes[i].count * sizeof(float), // Size (in bytes)
+        nullptr,                                  // Data
+        GL_DYNAMIC_DRAW                           // Usage
     );
     
     // Texture coordinates attribute (maps to a_texCoord in shader.vs)
@@ -153,18 +155,30 @@ void Renderer::setVertexAttributes(std::size_t ballTypeIndex)
     glVertexAttribDivisor(1, 0); 
     
 
-    // Center attribute (maps to a_center in shader.vs)
+    // Center x-coordinate attribute (maps to a_centerX in shader.vs)
     glEnableVertexAttribArray(2);
     glBindBuffer(GL_ARRAY_BUFFER, m_positionVBOs[i]);
     glVertexAttribPointer(
         2,                              // Index
-        2,                              // Size
+        1,                              // Size
         GL_FLOAT,                       // Type
         GL_FALSE,                       // Normalized
-        sizeof(Ball),                   // Stride
-        (void*)offsetof(Ball, position) // Offset
+        sizeof(float),                  // Stride
+        0                               // Offset
     );
     glVertexAttribDivisor(2, 1);
+
+    // Center y-coordinate attribute (maps to a_centerY in shader.vs)
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(
+        3,                                                // Index
+        1,                                                // Size
+        GL_FLOAT,                                         // Type
+        GL_FALSE,                                         // Normalized
+        sizeof(float),                                    // Stride
+        (void*)(m_ballTypes[i].count * sizeof(float))     // Offset
+    );
+    glVertexAttribDivisor(3, 1);
 }
 
 void Renderer::draw()
@@ -173,15 +187,20 @@ void Renderer::draw()
  * BallType to the screen in a single instanced draw call.
  */
 {
+    PROFILE_SCOPE("Renderer::draw");
+
     glClear(GL_COLOR_BUFFER_BIT);
 
-    std::size_t startIndex = 0; // Keep track of the starting index of the i-th BallType in m_balls
+    std::size_t startIndex = 0; // Keep track of the starting index of the i-th BallType in m_particles
 
     // Draw balls to screen
     for (std::size_t i = 0; i < m_ballTypes.size(); i++)
     {
         if (m_ballTypes[i].render == false)
+        {
+            startIndex += m_ballTypes[i].count;
             continue;
+        }
 
         // Draw 9 translated copies when wrapTexture==true, 1 copy when wrapTexture==false
         unsigned int numCopies = m_ballTypes[i].wrapTexture ? 9 : 1;
@@ -192,15 +211,25 @@ void Renderer::draw()
         // Draw to screen
         glBindVertexArray(m_VAOs[i]);
         glBindBuffer(GL_ARRAY_BUFFER, m_positionVBOs[i]);
-        glBufferSubData(
-            GL_ARRAY_BUFFER,                     // Target
-            offsetof(Ball, position),            // Offset (in bytes)
-            m_ballTypes[i].count * sizeof(Ball), // Size (in bytes)
-            m_balls.data() + startIndex          // Data
-        );
+        {
+            PROFILE_SCOPE("uploadPositions");
+
+            glBufferSubData(
+                GL_ARRAY_BUFFER,                      // Target
+                0,                                    // Offset (in bytes)
+                m_ballTypes[i].count * sizeof(float), // Size (in bytes)
+                m_particles.x.data() + startIndex     // Data
+            );
+            glBufferSubData(
+                GL_ARRAY_BUFFER,                      // Target
+                m_ballTypes[i].count * sizeof(float), // Offset (in bytes)
+                m_ballTypes[i].count * sizeof(float), // Size (in bytes)
+                m_particles.y.data() + startIndex     // Data
+            );
+        }
         glDrawArraysInstanced(GL_TRIANGLES, 0, VERTICES_PER_QUAD * numCopies,  m_ballTypes[i].count);
 
-        // Update start index in m_balls
+        // Update start index in m_particles
         startIndex += m_ballTypes[i].count;
     }
 
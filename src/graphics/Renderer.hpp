@@ -3,13 +3,17 @@
 /**
  * Renderer class for creating and managing an OpenGL context, 
  * and drawing the simulation to the screen. 
+ *
+ * Draws the particles of a ParticleSource: a live Solver, or
+ * a TrajectoryPlayer replaying a recorded run.
  */
 
 #include <vector>
 #include <array>
+#include <string>
 
 #include "Preset.hpp"
-#include "Solver.hpp"
+#include "ParticleSource.hpp"
 #include "Shader.hpp"
 #include "Window.hpp"
 #include "World.hpp"
@@ -17,18 +21,21 @@
 class Renderer
 {
 public:
-	Renderer(const Solver& solver, Preset preset, unsigned int xResolution, unsigned int yResolution);
+	Renderer(const ParticleSource& source, Preset preset, unsigned int xResolution, unsigned int yResolution);
 
 	void draw();                                    // Draw simulation to window
 	bool windowOpen() { return m_window.isOpen(); } // Check window is still open
 
+	void             setTitle(const std::string& title) { m_window.setTitle(title); }
+	std::vector<int> takeKeyPresses() { return m_window.takeKeyPresses(); } // GLFW key codes pressed since the last call
+
 private:
 	// Window object
 	Window m_window;
 
-	// References to ball and world data in Solver object
+	// References to ball and world data in the ParticleSource
 	const std::vector<BallType>& m_ballTypes;
-	const std::vector<Ball>&     m_balls;
+	const Particles&             m_particles;
 	const World&                 m_world;
 
 	// Vectors of IDs for OpenGL objects
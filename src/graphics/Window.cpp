@@ -2,9 +2,11 @@
 
 #include <iostream>
 
-Window::Window(const Solver& solver, unsigned int xResolution, unsigned int yResolution)
+#include "Profiler.hpp"
+
+Window::Window(const ParticleSource& source, unsigned int xResolution, unsigned int yResolution)
     : m_window(nullptr),
-      m_world(solver.getWorld())
+      m_world(source.getWorld())
 {
     // Set up GLFW window context
     if (!glfwInit())
@@ -55,6 +57,18 @@ Window::Window(const Solver& solver, unsigned int xResolution, unsigned int yRes
             myWindow->framebufferSizeCallback(window, width, height);
         }
     );  
+
+    // Record key presses, to be handled by the caller
+    glfwSetKeyCallback(
+        m_window,
+        [](GLFWwindow* window, int key, int, int action, int)
+        {
+            Window* myWindow = (Window*)glfwGetWindowUserPointer(window);
+
+            if (action == GLFW_PRESS || action == GLFW_REPEAT)
+                myWindow->m_keyPresses.push_back(key);
+        }
+    );
 }
 
 Window::~Window()
@@ -69,11 +83,28 @@ bool Window::isOpen()
 
 void Window::update()
 {
-    glfwSwapBuffers(m_window);
+    {
+        PROFILE_SCOPE("swapBuffers"); // Includes waiting for vsync and for the GPU to catch up
+        glfwSwapBuffers(m_window);
+    }
 
+    PROFILE_SCOPE("pollEvents");
     glfwPollEvents();
 }
 
+void Window::setTitle(const std::string& title)
+{
+    glfwSetWindowTitle(m_window, title.c_str());
+}
+
+std::vector<int> Window::takeKeyPresses()
+{
+    std::vector<int> keyPresses;
+    keyPresses.swap(m_keyPresses);
+
+    return keyPresses;
+}
+
 void Window::framebufferSizeCallback(GLFWwindow* window, int width, int height)
 /**
  * Screen resizing callback. Maintains the world's
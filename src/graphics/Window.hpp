@@ -7,24 +7,30 @@
  * Also initialises GLFW and GLAD on construction.
  */
 
+#include <string>
+#include <vector>
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#include "Solver.hpp"
+#include "ParticleSource.hpp"
 
 class Window
 {
 private:
 	GLFWwindow* m_window;
 	const World& m_world;
+	std::vector<int> m_keyPresses; // GLFW key codes pressed (or repeated) since last taken
 
 	// Screen resizing callback
 	void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 
 public:
-	Window(const Solver& solver, unsigned int xResolution, unsigned int yResolution);
+	Window(const ParticleSource& source, unsigned int xResolution, unsigned int yResolution);
 	~Window();
 
 	bool isOpen();
 	void update();
+	void setTitle(const std::string& title);
+	std::vector<int> takeKeyPresses(); // Keys pressed since the last call, oldest first
 };
\ No newline at end of file
@@ -2,7 +2,8 @@
 
 layout(location = 0) in vec2 a_texCoord; // One of (-1,-1), (-1,1), (1,-1), (1,1)
 layout(location = 1) in vec2 a_offset;   // Translate of particle copy in world space
-layout(location = 2) in vec2 a_center;   // Location of particle's centre in world space
+layout(location = 2) in float a_centerX; // Location of particle's centre in world space
+layout(location = 3) in float a_centerY;
 
 uniform float u_radius;                  // Radius of particle
 uniform vec4  u_worldToScreenTransform;
@@ -11,6 +12,7 @@ out vec2 v_texCoord;                     // For passing a_texCoord to the fragme
 
 void main()
 {
-	gl_Position = u_worldToScreenTransform * vec4(a_offset + a_center + u_radius * a_texCoord, 0.0, 1.0);
+	vec2 center = vec2(a_centerX, a_centerY);
+	gl_Position = u_worldToScreenTransform * vec4(a_offset + center + u_radius * a_texCoord, 0.0, 1.0);
 	v_texCoord = a_texCoord;
 }
\ No newline at end of file
@@ -0,0 +1,578 @@
+/**
+ ************** TORUS PARTICLE SIMULATOR (HEADLESS) **************
+ *
+ * Runs a preset without opening a window, stepping the solver
+ * as fast as possible and reporting its throughput. Intended
+ * for benchmarking and for machines without a display.
+ *
+ * Usage:
+ *     ./TorusParticlesHeadless [preset.json] [--steps N | --time T] [--threads P] [--stats K] [--seed S]
+ *                              [--ranks R [--transport shm|socket] [--scaling strong|weak]]
+ *                              [--profile] [--trace FILE [--trace-frames FIRST:COUNT]]
+ *                              [--restart FILE] [--checkpoint FILE [--checkpoint-every K]]
+ *                              [--trajectory FILE [--trajectory-every K] [--tracers N] [--trajectory-bits B]]
+ *
+ * --steps N      Run for N steps (default 1000)
+ * --time T       Run until T seconds of simulated time have passed
+ * --threads P    Number of solver threads (overrides the preset, and
+ *                defaults to 1 per rank in distributed runs)
+ * --stats K      Log the solver's work counters (pair tests, overlaps,
+ *                cell occupancy...) every K steps (overrides the preset)
+ * --seed S       Seed for the initial balls (overrides the preset)
+ * --ranks R      Split the world into R strips, each simulated by its
+ *                own process with a DomainSolver
+ * --transport K  How the ranks exchange balls: "shm" (shared memory,
+ *                the default) or "socket" (Unix-domain sockets)
+ * --scaling S    Run with 1 to R ranks and report the scaling: "strong"
+ *                keeps the preset, while "weak" scales it with the 
+ *                number of ranks, so each rank's strip holds the same
+ *                balls as the whole world of the original preset
+ * --profile      Time each phase of every step, on every thread, and
+ *                print percentiles of the times over the last 256 steps
+ * --trace FILE   Profile, and write steps FIRST to FIRST + COUNT - 1
+ *                (0:100 by default) to FILE as a Chrome trace, which
+ *                chrome://tracing or https://ui.perfetto.dev can open
+ * --restart F    Continue the run saved in checkpoint F: its balls,
+ *                world and timestep replace the preset's, which still
+ *                chooses the solver and its settings
+ * --checkpoint F Save the state to checkpoint F at the end of the run,
+ *                and with --checkpoint-every K, every K steps as well,
+ *                written in the background while the run carries on
+ * --trajectory F Record the balls' positions to trajectory file F every
+ *                K steps (10 by default), compressed in the background:
+ *                --tracers N records only N balls spread over the IDs,
+ *                and --trajectory-bits B (16 by default, at most 24)
+ *                sets the precision kept across the world
+ *
+ * When run without a preset, preset1.json is loaded by default.
+ * Distributed runs are only available on POSIX systems, and
+ * profiling only in builds with TORUSPARTICLES_ENABLE_PROFILING.
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+#include "createSolver.hpp"
+#include "SpatialHashSolver.hpp"
+#include "EventDrivenSolver.hpp"
+#include "loadPreset.hpp"
+#include "Topology.hpp"
+#include "Profiler.hpp"
+#include "Checkpoint.hpp"
+#include "Trajectory.hpp"
+
+#ifdef TORUSPARTICLES_DISTRIBUTED
+#include "runDistributed.hpp"
+#endif
+
+static const char* USAGE = 
+    "Usage: TorusParticlesHeadless [preset.json] [--steps N | --time T] [--threads P] [--stats K] [--seed S]\n"
+    "                              [--ranks R [--transport shm|socket] [--scaling strong|weak]]\n"
+    "                              [--profile] [--trace FILE [--trace-frames FIRST:COUNT]]\n"
+    "                              [--restart FILE] [--checkpoint FILE [--checkpoint-every K]]\n"
+    "                              [--trajectory FILE [--trajectory-every K] [--tracers N] [--trajectory-bits B]]";
+
+#ifdef TORUSPARTICLES_DISTRIBUTED
+static Preset weakScaledPreset(Preset preset, int numRanks)
+/**
+ * Scale a preset for a weak scaling run with numRanks ranks.
+ * Every world has an area of 4, so rather than widening the
+ * world, the balls are shrunk: counts (and total momenta) are
+ * multiplied by numRanks and radii divided by its square root,
+ * while the aspect ratio is multiplied by numRanks. Measured
+ * in radii, the world is then numRanks times wider and just as
+ * tall, so each rank's strip matches the original world. The
+ * timestep is shrunk with the radii, so balls move the same
+ * distance per step relative to their size.
+ */
+{
+    float shrink = 1.0f / std::sqrt(static_cast<float>(numRanks));
+
+    preset.worldAspectRatio *= static_cast<float>(numRanks);
+    preset.dt *= shrink;
+
+    for (BallType& ballType : preset.ballTypes)
+    {
+        ballType.count *= static_cast<std::size_t>(numRanks);
+        ballType.radius *= shrink;
+        ballType.totalMomentum = ballType.totalMomentum * static_cast<float>(numRanks);
+    }
+
+    return preset;
+}
+
+static int runDistributedMode(const Preset& preset, const std::string& presetPath, std::size_t numSteps, 
+                              int numRanks, const std::string& transport, const std::string& scaling)
+/**
+ * Run the preset split between processes, either once with
+ * numRanks ranks, or with every count of ranks up to numRanks
+ * as a scaling report.
+ */
+{
+    std::size_t numBalls = 0;
+    for (const BallType& ballType : preset.ballTypes)
+        numBalls += ballType.count;
+
+    std::cout << "Running \"" << presetPath << "\" distributed over " << transport << ": "
+              << numBalls << " balls, " << numSteps << " steps of dt = " << preset.dt 
+              << ", " << preset.numThreads << " threads per rank" << std::endl;
+
+    if (scaling.empty())
+    {
+        DistributedResult result = runDistributed(preset, numRanks, transport, numSteps, preset.dt);
+
+        if (!result.success)
+            return -4;
+
+        double stepsPerSecond = result.seconds > 0.0 ? static_cast<double>(numSteps) / result.seconds : 0.0;
+
+        std::size_t numOwned = 0;
+        double momentumX = 0.0, momentumY = 0.0, kineticEnergy = 0.0;
+
+        std::cout << "Wall time:        " << result.seconds << " s" << std::endl;
+        std::cout << "Steps/sec:        " << stepsPerSecond << std::endl;
+        std::cout << "Ball-steps/sec:   " << stepsPerSecond * static_cast<double>(numBalls) << std::endl;
+
+        for (const DomainStats& rank : result.ranks)
+        {
+            double steps = static_cast<double>(std::max<std::size_t>(1, rank.numSteps));
+
+            std::cout << "  Rank " << rank.rank << ": " << rank.numOwned << " balls, "
+                      << static_cast<double>(rank.numGhosts) / steps << " ghosts/step, "
+                      << static_cast<double>(rank.numMigrations) / steps << " migrations/step, "
+                      << static_cast<double>(rank.bytesSent) / steps / 1024.0 << " KiB sent/step, "
+                      << rank.exchangeSeconds << " s exchanging, " << rank.solveSeconds << " s solving" << std::endl;
+
+            numOwned += rank.numOwned;
+            momentumX += rank.momentumX;
+            momentumY += rank.momentumY;
+            kineticEnergy += rank.kineticEnergy;
+        }
+
+        std::cout << "Totals:           " << numOwned << " balls, momentum (" << momentumX << ", " << momentumY 
+                  << "), kinetic energy " << kineticEnergy << std::endl;
+
+        return 0;
+    }
+
+    std::cout << (scaling == "weak" ? "Weak" : "Strong") << " scaling:" << std::endl;
+    std::cout << "  ranks       balls   steps/s   speedup  efficiency  ghosts/step  migrations/step  exchange %" << std::endl;
+
+    // Speedup compares ball-steps per second with the single rank run, and exchange
+    // time includes waiting for slower neighbours, so it also reflects load imbalance
+
+    double baseRate = 0.0; // Ball-steps per second with one rank
+
+    for (int ranks = 1; ranks <= numRanks; ranks++)
+    {
+        Preset scaled = scaling == "weak" ? weakScaledPreset(preset, ranks) : preset;
+
+        std::cout.flush();
+        DistributedResult result = runDistributed(scaled, ranks, transport, numSteps, scaled.dt);
+
+        if (!result.success)
+            return -4;
+
+        std::size_t balls = 0;
+        double ghosts = 0.0, migrations = 0.0, exchangeSeconds = 0.0, rankSeconds = 0.0;
+
+        for (const DomainStats& rank : result.ranks)
+        {
+            double steps = static_cast<double>(std::max<std::size_t>(1, rank.numSteps));
+
+            balls += rank.numOwned;
+            ghosts += static_cast<double>(rank.numGhosts) / steps;
+            migrations += static_cast<double>(rank.numMigrations) / steps;
+            exchangeSeconds += rank.exchangeSeconds;
+            rankSeconds += result.seconds;
+        }
+
+        double stepsPerSecond = result.seconds > 0.0 ? static_cast<double>(numSteps) / result.seconds : 0.0;
+        double rate = stepsPerSecond * static_cast<double>(balls);
+
+        if (ranks == 1)
+            baseRate = rate;
+
+        double speedup = baseRate > 0.0 ? rate / baseRate : 0.0;
+
+        std::cout << std::fixed
+                  << "  " << std::setw(5) << ranks << std::setw(12) << balls
+                  << std::setprecision(1) << std::setw(10) << stepsPerSecond
+                  << std::setprecision(2) << std::setw(10) << speedup << std::setw(12) << speedup / ranks
+                  << std::setprecision(0) << std::setw(13) << ghosts
+                  << std::setprecision(1) << std::setw(17) << migrations
+                  << std::setw(12) << (rankSeconds > 0.0 ? 100.0 * exchangeSeconds / rankSeconds : 0.0)
+                  << std::defaultfloat << std::endl;
+    }
+
+    return 0;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    // Parse command line arguments
+    std::string presetPath = "preset1.json";
+    std::size_t numSteps = 1000;
+    float simulatedTime = 0.0f; // If positive, overrides numSteps
+    int numThreads = -1;        // If non-negative, overrides the preset
+    int numRanks = 0;           // If positive, runs distributed over this many processes
+    int statsInterval = -1;     // If non-negative, overrides the preset
+    std::uint64_t seed = 0;
+    bool seedGiven = false;     // If so, seed overrides the preset
+    std::string transport = "shm";
+    std::string scaling;        // "strong" or "weak" for a scaling report, empty for a single run
+    bool profile = false;
+    std::string tracePath;
+    std::size_t traceFirst = 0;
+    std::size_t traceCount = 100;
+    std::string restartPath;
+    std::string checkpointPath;
+    std::size_t checkpointInterval = 0; // Steps between checkpoints (0 only saves at the end)
+    std::string trajectoryPath;
+    std::size_t trajectoryInterval = 10;
+    std::size_t numTracers = 0;         // 0 records every ball
+    unsigned int trajectoryBits = 16;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if ((arg == "--steps" || arg == "--time" || arg == "--threads" || arg == "--ranks" || arg == "--stats" || arg == "--checkpoint-every"
+             || arg == "--trajectory-every" || arg == "--tracers" || arg == "--trajectory-bits" || arg == "--seed") && i + 1 < argc)
+        {
+            try
+            {
+                if (arg == "--steps")
+                    numSteps = std::stoull(argv[++i]);
+                else if (arg == "--time")
+                    simulatedTime = std::stof(argv[++i]);
+                else if (arg == "--threads")
+                    numThreads = std::stoi(argv[++i]);
+                else if (arg == "--stats")
+                    statsInterval = std::stoi(argv[++i]);
+                else if (arg == "--checkpoint-every")
+                    checkpointInterval = std::stoull(argv[++i]);
+                else if (arg == "--trajectory-every")
+                    trajectoryInterval = std::stoull(argv[++i]);
+                else if (arg == "--tracers")
+                    numTracers = std::stoull(argv[++i]);
+                else if (arg == "--trajectory-bits")
+                    trajectoryBits = static_cast<unsigned int>(std::stoul(argv[++i]));
+                else if (arg == "--seed")
+                {
+                    seed = std::stoull(argv[++i]);
+                    seedGiven = true;
+                }
+                else
+                    numRanks = std::stoi(argv[++i]);
+            }
+            catch (const std::exception&)
+            {
+                std::cout << "Error: invalid value for " << arg << std::endl;
+                return -1;
+            }
+        }
+        else if (arg == "--transport" && i + 1 < argc)
+            transport = argv[++i];
+        else if (arg == "--scaling" && i + 1 < argc)
+            scaling = argv[++i];
+        else if (arg == "--profile")
+            profile = true;
+        else if (arg == "--restart" && i + 1 < argc)
+            restartPath = argv[++i];
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            checkpointPath = argv[++i];
+        else if (arg == "--trajectory" && i + 1 < argc)
+            trajectoryPath = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (arg == "--trace-frames" && i + 1 < argc)
+        {
+            if (!Profiler::parseFrameRange(argv[++i], traceFirst, traceCount))
+            {
+                std::cout << "Error: invalid value for --trace-frames (expected FIRST:COUNT, with COUNT > 0)" << std::endl;
+                return -1;
+            }
+        }
+        else if (arg.rfind("--", 0) != 0)
+            presetPath = arg;
+        else
+        {
+            std::cout << "Error: unrecognised argument \"" << arg << "\"" << std::endl;
+            std::cout << USAGE << std::endl;
+            return -1;
+        }
+    }
+
+    if (!scaling.empty() && scaling != "strong" && scaling != "weak")
+    {
+        std::cout << "Error: invalid value for --scaling (expected \"strong\" or \"weak\")" << std::endl;
+        return -1;
+    }
+
+    if (!scaling.empty() && numRanks <= 0)
+    {
+        std::cout << "Error: --scaling needs the largest number of ranks to run with (--ranks R)" << std::endl;
+        return -1;
+    }
+
+    if (!tracePath.empty())
+        profile = true;
+
+#ifndef TORUSPARTICLES_PROFILING
+    if (profile)
+    {
+        std::cout << "Error: profiling is not available in this build (see TORUSPARTICLES_ENABLE_PROFILING)" << std::endl;
+        return -1;
+    }
+#endif
+
+    if (profile && numRanks > 0)
+    {
+        std::cout << "Error: --profile and --trace are not supported in distributed runs" << std::endl;
+        return -1;
+    }
+
+    if ((!restartPath.empty() || !checkpointPath.empty()) && numRanks > 0)
+    {
+        std::cout << "Error: --restart and --checkpoint are not supported in distributed runs" << std::endl;
+        return -1;
+    }
+
+    if (checkpointInterval > 0 && checkpointPath.empty())
+    {
+        std::cout << "Error: --checkpoint-every needs a checkpoint file (--checkpoint FILE)" << std::endl;
+        return -1;
+    }
+
+    if (!trajectoryPath.empty() && numRanks > 0)
+    {
+        std::cout << "Error: --trajectory is not supported in distributed runs" << std::endl;
+        return -1;
+    }
+
+    if (trajectoryInterval == 0 || trajectoryBits < 1 || trajectoryBits > 24)
+    {
+        std::cout << "Error: invalid value for " << (trajectoryInterval == 0 ? "--trajectory-every" : "--trajectory-bits") << std::endl;
+        return -1;
+    }
+
+    // Load preset
+    Preset preset = loadPreset(presetPath);
+
+    if (!preset.loadSuccessful)
+    {
+        std::cout << "Error: failed to load preset" << std::endl;
+        std::cout << "Terminating program..." << std::endl;
+        return -2;
+    }
+
+    if (numThreads >= 0)
+        preset.numThreads = static_cast<unsigned int>(numThreads);
+
+    if (statsInterval >= 0)
+        preset.statsInterval = static_cast<unsigned int>(statsInterval);
+
+    if (seedGiven)
+        preset.seed = seed;
+
+    // Load checkpoint, whose state replaces the preset's
+    Checkpoint checkpoint;
+
+    if (!restartPath.empty())
+    {
+        auto loadStart = std::chrono::steady_clock::now();
+
+        if (!loadCheckpoint(restartPath, checkpoint))
+        {
+            std::cout << "Terminating program..." << std::endl;
+            return -2;
+        }
+
+        std::cout << "Loaded checkpoint \"" << restartPath << "\" (step " << checkpoint.step << ", "
+                  << checkpoint.particles.size() << " balls) in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() << " s" << std::endl;
+
+        preset.ballTypes        = checkpoint.ballTypes;
+        preset.worldAspectRatio = checkpoint.world.xWidth / checkpoint.world.yWidth;
+        preset.dt               = checkpoint.dt;
+    }
+
+    float dt = preset.dt;
+
+    if (simulatedTime > 0.0f)
+        numSteps = static_cast<std::size_t>(std::ceil(simulatedTime / dt));
+
+    std::cout << "Topology:         " << detectTopology().describe() << ", huge pages " << preset.hugePages << std::endl;
+
+    if (numRanks > 0)
+    {
+#ifdef TORUSPARTICLES_DISTRIBUTED
+        // Ranks are the unit of parallelism, so each is single-threaded unless asked otherwise
+        if (numThreads < 0)
+            preset.numThreads = 1;
+
+        return runDistributedMode(preset, presetPath, numSteps, numRanks, transport, scaling);
+#else
+        std::cout << "Error: distributed runs are not supported on this platform" << std::endl;
+        return -1;
+#endif
+    }
+
+    // Initialise simulation
+    auto createStart = std::chrono::steady_clock::now();
+
+    std::unique_ptr<Solver> solver = restartPath.empty() ? createSolver(preset)
+                                                         : createSolver(preset, checkpoint.world, std::move(checkpoint.particles));
+
+    if (!solver)
+    {
+        std::cout << "Terminating program..." << std::endl;
+        return -3;
+    }
+
+    if (!restartPath.empty())
+        std::cout << "Restarted solver in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - createStart).count() << " s" << std::endl;
+
+    std::cout << "Running \"" << presetPath << "\" with " << preset.solver << " solver: " 
+              << solver->getParticles().size() << " balls, "
+              << numSteps << " steps of dt = " << dt << std::endl;
+
+    if (profile)
+    {
+        Profiler::setThreadName("Main");
+        Profiler::traceFrames(tracePath, traceFirst, traceCount);
+        Profiler::setEnabled(true);
+    }
+
+    // Steps are counted from the start of the original run
+    const std::uint64_t firstStep = checkpoint.step;
+    CheckpointWriter checkpointWriter;
+
+    std::unique_ptr<TrajectoryWriter> trajectoryWriter;
+    double recordSeconds = 0.0; // Time the step loop spent handing frames to the trajectory writer
+
+    if (!trajectoryPath.empty())
+    {
+        trajectoryWriter = std::make_unique<TrajectoryWriter>(trajectoryPath, *solver, dt, trajectoryInterval, numTracers, trajectoryBits);
+
+        if (!trajectoryWriter->isOpen())
+        {
+            std::cout << "Terminating program..." << std::endl;
+            return -2;
+        }
+
+        trajectoryWriter->record(*solver, firstStep);
+    }
+
+    // Simulation loop
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t step = 0; step < numSteps; step++)
+    {
+        solver->update(dt);
+        Profiler::nextFrame();
+
+        if (checkpointInterval > 0 && (step + 1) % checkpointInterval == 0 && step + 1 < numSteps)
+            checkpointWriter.save(checkpointPath, *solver, dt, firstStep + step + 1);
+
+        if (trajectoryWriter)
+        {
+            auto recordStart = std::chrono::steady_clock::now();
+            trajectoryWriter->record(*solver, firstStep + step + 1);
+            recordSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count();
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    if (trajectoryWriter)
+    {
+        trajectoryWriter->close();
+
+        double numBallFrames = static_cast<double>(trajectoryWriter->getNumWritten() * trajectoryWriter->getNumParticles());
+        double bitsPerBall = numBallFrames > 0.0 ? 8.0 * static_cast<double>(trajectoryWriter->getNumBytes()) / numBallFrames : 0.0;
+
+        std::cout << "Trajectory:       " << trajectoryWriter->getNumWritten() << " frames written to \"" << trajectoryPath << "\" ("
+                  << static_cast<double>(trajectoryWriter->getNumBytes()) / (1024.0 * 1024.0) << " MiB, "
+                  << bitsPerBall << " bits/ball/frame), " << trajectoryWriter->getNumDropped()
+                  << " dropped while the writer was busy, " << recordSeconds * 1e3 << " ms spent queueing" << std::endl;
+    }
+
+    if (!checkpointPath.empty())
+    {
+        checkpointWriter.save(checkpointPath, *solver, dt, firstStep + numSteps);
+        checkpointWriter.wait();
+
+        std::cout << "Checkpoints:      " << checkpointWriter.getNumWritten() << " written to \"" << checkpointPath
+                  << "\" (last at step " << firstStep + numSteps << "), " << checkpointWriter.getNumReplaced()
+                  << " skipped while the disk was busy" << std::endl;
+    }
+
+    // Report throughput
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double stepsPerSecond = seconds > 0.0 ? static_cast<double>(numSteps) / seconds : 0.0;
+
+    std::cout << "Simulated time:   " << static_cast<double>(numSteps) * dt << " s" << std::endl;
+    std::cout << "Wall time:        " << seconds << " s" << std::endl;
+    std::cout << "Steps/sec:        " << stepsPerSecond << std::endl;
+    std::cout << "Ball-steps/sec:   " << stepsPerSecond * static_cast<double>(solver->getParticles().size()) << std::endl;
+    std::cout << "Last step:        " << solver->getStats().describe() << std::endl;
+
+    // Report solver-specific statistics
+    if (const EventDrivenSolver* eventSolver = dynamic_cast<const EventDrivenSolver*>(solver.get()))
+    {
+        double numEvents = static_cast<double>(eventSolver->getNumCollisions() + eventSolver->getNumCellCrossings());
+
+        std::cout << "Collisions:       " << eventSolver->getNumCollisions() << std::endl;
+        std::cout << "Cell crossings:   " << eventSolver->getNumCellCrossings() << std::endl;
+        std::cout << "Events/sec:       " << (seconds > 0.0 ? numEvents / seconds : 0.0) << std::endl;
+    }
+
+    if (const SpatialHashSolver* hashSolver = dynamic_cast<const SpatialHashSolver*>(solver.get()))
+    {
+        GridStats gridStats = hashSolver->getGridStats();
+
+        std::cout << "Grid cell scale:  " << gridStats.cellScale << " (" << gridStats.numRegrids << " changes, "
+                  << gridStats.regridReason << ")" << std::endl;
+
+        for (std::size_t i = 0; i < gridStats.levels.size(); i++)
+        {
+            const GridLevelStats& level = gridStats.levels[i];
+
+            std::cout << "  Level " << i << ": " << level.numRows << "x" << level.numCols << " cells, "
+                      << level.numBalls << " balls, " << level.meanOccupancy << " entries/cell, "
+                      << level.meanPairTests << " pair tests/step" << std::endl;
+        }
+
+        std::cout << "Grid maintenance: " << gridStats.meanCellCrossings << " cell crossings/step, "
+                  << gridStats.numFullRebuilds << " full rebuilds" << std::endl;
+        std::cout << "Pair buffers:     " << gridStats.meanDetectedPairs << " pairs/step, " << gridStats.meanResolvedPairs
+                  << " resolved/step in " << gridStats.meanResolveRounds << " rounds, largest buffer " << gridStats.maxPairBuffer
+                  << " pairs, " << gridStats.pairBufferBytes / 1024.0 << " KiB" << std::endl;
+
+        if (gridStats.neighbourListSteps > 0)
+        {
+            std::cout << "Neighbour lists:  " << gridStats.neighbourListBuilds << " builds in " << gridStats.neighbourListSteps
+                      << " steps (every " << static_cast<double>(gridStats.neighbourListSteps) / std::max<std::size_t>(1, gridStats.neighbourListBuilds)
+                      << " steps), " << gridStats.neighbourPairs << " pairs, "
+                      << gridStats.neighbourListBytes / 1024.0 << " KiB" << std::endl;
+        }
+    }
+
+    if (profile)
+    {
+        Profiler::printPhaseStats();
+
+        if (!tracePath.empty() && traceFirst + traceCount > numSteps)
+            std::cout << "Warning: the run ended before step " << traceFirst + traceCount - 1
+                      << ", so no trace was written" << std::endl;
+    }
+
+    return 0;
+}
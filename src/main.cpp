@@ -12,30 +12,187 @@
  * To load a preset file, simply drag and drop it onto the
  * executable (Windows) or add the filename as an argument to
  * the program (Linux).
+ *
+ * Adding --profile prints how long each phase of a frame took
+ * (percentiles over the last 256 frames) when the window is
+ * closed, and --trace FILE [--trace-frames FIRST:COUNT] writes
+ * frames FIRST to FIRST + COUNT - 1 (0:100 by default) to FILE
+ * as a Chrome trace, for chrome://tracing or ui.perfetto.dev.
+ *
+ * Adding --trajectory FILE [--trajectory-every K] records the
+ * balls' positions every K frames (every frame by default) to
+ * a compressed trajectory file while the simulation runs, and
+ * --replay FILE plays a recorded trajectory back instead of
+ * simulating, using the preset only for rendering settings.
+ * While replaying:
+ *     Space              pause or play
+ *     Left/Right         step back/forward one frame (pausing)
+ *     Page Up/Page Down  skip back/forward a tenth of the run
+ *     Home/End           go to the first/last frame
+ *     Up/Down            double/halve the playback speed
+ *     R                  reverse the direction of playback
  */
 
 #include <iostream>
+#include <string>
+#include <chrono>
+#include <sstream>
 
 #include "Renderer.hpp"
-#include "SpatialHashSolver.hpp"
+#include "createSolver.hpp"
 #include "loadPreset.hpp"
+#include "Profiler.hpp"
+#include "Trajectory.hpp"
+#include "TrajectoryPlayer.hpp"
+
+static void handleReplayKeys(TrajectoryPlayer& player, const std::vector<int>& keys)
+{
+    const std::size_t lastFrame = player.getNumFrames() - 1;
+    const std::size_t skip      = std::max<std::size_t>(1, player.getNumFrames() / 10);
+
+    for (int key : keys)
+    {
+        std::size_t frame = player.getFrame();
+
+        switch (key)
+        {
+        case GLFW_KEY_SPACE:
+            // Playing from an end starts again from the other
+            if (player.isPaused() && frame == (player.getSpeed() >= 0.0f ? lastFrame : 0))
+                player.seek(player.getSpeed() >= 0.0f ? 0 : lastFrame);
+            player.setPaused(!player.isPaused());
+            break;
+        case GLFW_KEY_RIGHT:
+            player.setPaused(true);
+            player.seek(frame + 1);
+            break;
+        case GLFW_KEY_LEFT:
+            player.setPaused(true);
+            player.seek(frame > 0 ? frame - 1 : 0);
+            break;
+        case GLFW_KEY_PAGE_DOWN:
+            player.seek(frame + skip);
+            break;
+        case GLFW_KEY_PAGE_UP:
+            player.seek(frame > skip ? frame - skip : 0);
+            break;
+        case GLFW_KEY_HOME:
+            player.seek(0);
+            break;
+        case GLFW_KEY_END:
+            player.seek(lastFrame);
+            break;
+        case GLFW_KEY_UP:
+            player.setSpeed(player.getSpeed() * 2.0f);
+            break;
+        case GLFW_KEY_DOWN:
+            player.setSpeed(player.getSpeed() * 0.5f);
+            break;
+        case GLFW_KEY_R:
+            player.setSpeed(-player.getSpeed());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void advanceReplay(TrajectoryPlayer& player, Renderer& renderer, double seconds, std::string& title)
+/**
+ * Handle the keys pressed, then move playback on by the time
+ * the last frame took, so the replay keeps pace with simulated
+ * time (times the speed) however fast frames are drawn; any
+ * recorded frames falling between two drawn frames are skipped.
+ */
+{
+    handleReplayKeys(player, renderer.takeKeyPresses());
+    player.advance(seconds);
+
+    std::ostringstream newTitle;
+    newTitle << "TorusParticles - step " << player.getStep() << " (frame " << player.getFrame() + 1
+             << " of " << player.getNumFrames() << "), speed " << player.getSpeed() << "x"
+             << (player.isPaused() ? ", paused" : "");
+
+    if (newTitle.str() != title)
+    {
+        title = newTitle.str();
+        renderer.setTitle(title);
+    }
+}
 
 int main(int argc, char* argv[])
 {
-	// Load preset
-    Preset preset;
+    // Parse command line arguments
+    std::string presetPath = "preset1.json";
+    bool presetGiven = false;
+    bool profile = false;
+    std::string tracePath;
+    std::size_t traceFirst = 0;
+    std::size_t traceCount = 100;
+    std::string trajectoryPath;
+    std::size_t trajectoryInterval = 1;
+    std::string replayPath;
+    bool validArguments = true;
 
-    if (argc == 1)
-        preset = loadPreset("preset1.json");
-    else if (argc == 2)
-        preset = loadPreset(argv[1]);
-    else
+    for (int i = 1; i < argc && validArguments; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--profile")
+            profile = true;
+        else if (arg == "--trace" && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (arg == "--trace-frames" && i + 1 < argc)
+            validArguments = Profiler::parseFrameRange(argv[++i], traceFirst, traceCount);
+        else if (arg == "--trajectory" && i + 1 < argc)
+            trajectoryPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--trajectory-every" && i + 1 < argc)
+        {
+            try
+            {
+                trajectoryInterval = std::stoull(argv[++i]);
+                validArguments = trajectoryInterval > 0;
+            }
+            catch (const std::exception&)
+            {
+                validArguments = false;
+            }
+        }
+        else if (arg.rfind("--", 0) != 0 && !presetGiven)
+        {
+            presetPath = arg;
+            presetGiven = true;
+        }
+        else
+            validArguments = false;
+    }
+
+    if (!trajectoryPath.empty() && !replayPath.empty())
+        validArguments = false;
+
+    if (!validArguments)
+    {
+        std::cout << "Error: program accepts at most one preset, plus [--profile] [--trace FILE [--trace-frames FIRST:COUNT]]"
+                  << " [--trajectory FILE [--trajectory-every K] | --replay FILE]" << std::endl;
+        std::cout << "Terminating program..." << std::endl;
+        std::cin.get();
+        return -1;
+    }
+
+#ifndef TORUSPARTICLES_PROFILING
+    if (profile || !tracePath.empty())
     {
-        std::cout << "Error: program accepts at most one argument" << std::endl;
+        std::cout << "Error: profiling is not available in this build (see TORUSPARTICLES_ENABLE_PROFILING)" << std::endl;
         std::cout << "Terminating program..." << std::endl;
         std::cin.get();
         return -1;
     }
+#endif
+
+	// Load preset
+    Preset preset = loadPreset(presetPath);
 
     if (!preset.loadSuccessful)
     {
@@ -47,21 +204,108 @@ int main(int argc, char* argv[])
 
     float dt = preset.dt;
 
-    // Initialise simulation
-    SpatialHashSolver solver(preset);
+    // Initialise simulation, or open the trajectory to replay
+    std::unique_ptr<Solver> solver;
+    std::unique_ptr<TrajectoryPlayer> player;
+
+    if (replayPath.empty())
+    {
+        solver = createSolver(preset);
+
+        if (!solver)
+        {
+            std::cout << "Terminating program..." << std::endl;
+            std::cin.get();
+            return -3;
+        }
+    }
+    else
+    {
+        auto openStart = std::chrono::steady_clock::now();
+        player = std::make_unique<TrajectoryPlayer>(replayPath);
+
+        if (!player->isOpen())
+        {
+            std::cout << "Terminating program..." << std::endl;
+            std::cin.get();
+            return -2;
+        }
+
+        std::cout << "Opened \"" << replayPath << "\" (" << player->getNumFrames() << " frames of "
+                  << player->getParticles().size() << " balls) in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - openStart).count() << " s" << std::endl;
+        std::cout << "Space: pause/play, Left/Right: step, Page Up/Down: skip, Home/End: first/last frame, "
+                  << "Up/Down: double/halve speed, R: reverse" << std::endl;
+    }
 
     // Initialise renderer
     unsigned int xResolution = 1280;
     unsigned int yResolution = 720;
-    Renderer renderer(solver, preset, xResolution, yResolution);
+    const ParticleSource& source = solver ? static_cast<const ParticleSource&>(*solver) : *player;
+    Renderer renderer(source, preset, xResolution, yResolution);
+
+    if (profile || !tracePath.empty())
+    {
+        Profiler::setThreadName("Main");
+        Profiler::traceFrames(tracePath, traceFirst, traceCount);
+        Profiler::setEnabled(true);
+    }
+
+    std::unique_ptr<TrajectoryWriter> trajectoryWriter;
+    std::uint64_t step = 0;
+
+    if (!trajectoryPath.empty())
+    {
+        trajectoryWriter = std::make_unique<TrajectoryWriter>(trajectoryPath, *solver, dt, trajectoryInterval);
+
+        if (!trajectoryWriter->isOpen())
+        {
+            std::cout << "Terminating program..." << std::endl;
+            std::cin.get();
+            return -2;
+        }
+
+        trajectoryWriter->record(*solver, step);
+    }
+
+    std::string title;
+    auto lastFrame = std::chrono::steady_clock::now();
 
 	// Simulation loop
     while (renderer.windowOpen())
     {
-        solver.update(dt);
+        if (solver)
+        {
+            solver->update(dt);
+
+            if (trajectoryWriter)
+                trajectoryWriter->record(*solver, ++step);
+        }
+        else
+        {
+            auto now = std::chrono::steady_clock::now();
+            advanceReplay(*player, renderer, std::chrono::duration<double>(now - lastFrame).count(), title);
+            lastFrame = now;
+        }
 
         renderer.draw();
+
+        Profiler::nextFrame();
     }
 
+    if (Profiler::isEnabled())
+        Profiler::printPhaseStats();
+
+    if (trajectoryWriter)
+    {
+        trajectoryWriter->close();
+
+        std::cout << "Recorded " << trajectoryWriter->getNumWritten() << " frames to \"" << trajectoryPath << "\" ("
+                  << trajectoryWriter->getNumDropped() << " dropped while the writer was busy)" << std::endl;
+    }
+
+    if (player)
+        std::cout << "Showed " << player->getNumShown() << " frames, decoding " << player->getNumDecoded() << std::endl;
+
     return 0;
 }
\ No newline at end of file
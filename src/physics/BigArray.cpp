@@ -0,0 +1,144 @@
+#include "BigArray.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define TORUSPARTICLES_HAVE_MMAP
+#endif
+
+enum HugePageMode
+{
+	HUGE_PAGES_OFF,
+	HUGE_PAGES_THP,
+	HUGE_PAGES_HUGETLB
+};
+
+static std::atomic<int>  s_hugePageMode(HUGE_PAGES_OFF);
+static std::atomic<bool> s_warnedHugetlb(false);
+
+bool setHugePageMode(const std::string& mode)
+{
+	if (mode == "off")
+		s_hugePageMode = HUGE_PAGES_OFF;
+	else if (mode == "thp")
+		s_hugePageMode = HUGE_PAGES_THP;
+	else if (mode == "hugetlb")
+		s_hugePageMode = HUGE_PAGES_HUGETLB;
+	else
+	{
+		std::cout << "Error: unknown huge page mode \"" << mode << "\" (expected \"off\", \"thp\" or \"hugetlb\")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string getHugePageMode()
+{
+	switch (s_hugePageMode.load())
+	{
+	case HUGE_PAGES_THP:     return "thp";
+	case HUGE_PAGES_HUGETLB: return "hugetlb";
+	default:                 return "off";
+	}
+}
+
+#ifdef TORUSPARTICLES_HAVE_MMAP
+
+static std::size_t mappedBytes(std::size_t numBytes)
+/**
+ * Length of the mapping holding an array of numBytes bytes:
+ * whole huge pages for large arrays, whole pages otherwise.
+ * This depends only on the size, so the mapping can be
+ * unmapped whatever the huge page mode was when it was made.
+ */
+{
+	const std::size_t pageBytes = numBytes >= HUGE_PAGE_BYTES ? HUGE_PAGE_BYTES : 4096;
+	return (numBytes + pageBytes - 1) / pageBytes * pageBytes;
+}
+
+static void* mapHugePageAligned(std::size_t length)
+/**
+ * Map length bytes starting on a huge page boundary, by
+ * mapping an extra huge page and trimming either end, so
+ * that every 2 MiB of the array can become a huge page.
+ */
+{
+	void* region = mmap(nullptr, length + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (region == MAP_FAILED)
+		return nullptr;
+
+	std::uintptr_t start   = reinterpret_cast<std::uintptr_t>(region);
+	std::uintptr_t aligned = (start + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+
+	if (aligned > start)
+		munmap(region, aligned - start);
+	munmap(reinterpret_cast<void*>(aligned + length), start + HUGE_PAGE_BYTES - aligned);
+
+	return reinterpret_cast<void*>(aligned);
+}
+
+void* allocateBigArray(std::size_t numBytes)
+{
+	const std::size_t length = mappedBytes(numBytes);
+
+	if (length < HUGE_PAGE_BYTES)
+	{
+		void* region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (region == MAP_FAILED)
+			throw std::bad_alloc();
+
+		return region;
+	}
+
+	const int mode = s_hugePageMode.load();
+
+#ifdef MAP_HUGETLB
+	if (mode == HUGE_PAGES_HUGETLB)
+	{
+		void* region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (region != MAP_FAILED)
+			return region;
+
+		if (!s_warnedHugetlb.exchange(true))
+			std::cout << "Warning: no reserved huge pages available (see vm.nr_hugepages), using transparent huge pages" << std::endl;
+	}
+#endif
+
+	void* region = mapHugePageAligned(length);
+
+	if (region == nullptr)
+		throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+	if (mode != HUGE_PAGES_OFF)
+		madvise(region, length, MADV_HUGEPAGE);
+#endif
+
+	return region;
+}
+
+void freeBigArray(void* array, std::size_t numBytes)
+{
+	munmap(array, mappedBytes(numBytes));
+}
+
+#else
+
+void* allocateBigArray(std::size_t numBytes)
+{
+	return ::operator new(numBytes);
+}
+
+void freeBigArray(void* array, std::size_t)
+{
+	::operator delete(array);
+}
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Storage for the large arrays of the solvers (particle data
+ * and grids), as a std::vector with its own allocator.
+ *
+ * Arrays of BIG_ARRAY_MIN_BYTES or more are mapped straight
+ * from the operating system, rather than from the heap, so
+ * that their pages are fresh. Resizing leaves new elements
+ * uninitialised, so a page is only backed by memory when it
+ * is first written to, and on machines with several NUMA
+ * nodes the kernel places it on the node of the thread that
+ * writes it. Solvers can then place each thread's share of
+ * an array next to that thread by having the thread write
+ * it first (see SpatialHashSolver). Code resizing a BigArray
+ * must write every new element before reading it.
+ *
+ * Arrays of HUGE_PAGE_BYTES or more are aligned and rounded
+ * up to a whole number of 2 MiB huge pages, and the huge page
+ * mode (see setHugePageMode()) chooses how they are backed:
+ *
+ *   - "off":     by ordinary pages.
+ *   - "thp":     by transparent huge pages, which the kernel
+ *                assembles when it can (madvise(MADV_HUGEPAGE)).
+ *   - "hugetlb": by pages from the pool reserved by the
+ *                administrator (vm.nr_hugepages), falling back
+ *                to transparent huge pages if the pool is empty.
+ *
+ * Huge pages cut the TLB misses of the scattered reads made
+ * while checking cells. The mode is process wide, and only
+ * applies to arrays allocated after it is set. On platforms
+ * without mmap(), every array comes from the heap.
+ */
+
+bool        setHugePageMode(const std::string& mode); // Returns false (keeping the current mode) if mode is unknown
+std::string getHugePageMode();
+
+void* allocateBigArray(std::size_t numBytes);
+void  freeBigArray(void* array, std::size_t numBytes);
+
+const std::size_t BIG_ARRAY_MIN_BYTES = std::size_t(1) << 18;
+const std::size_t HUGE_PAGE_BYTES     = std::size_t(1) << 21;
+
+template <typename T>
+struct BigArrayAllocator
+{
+	using value_type = T;
+
+	BigArrayAllocator() = default;
+
+	template <typename U>
+	BigArrayAllocator(const BigArrayAllocator<U>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		if (n * sizeof(T) < BIG_ARRAY_MIN_BYTES)
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+
+		return static_cast<T*>(allocateBigArray(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		if (n * sizeof(T) < BIG_ARRAY_MIN_BYTES)
+			::operator delete(p);
+		else
+			freeBigArray(p, n * sizeof(T));
+	}
+
+	// Default-initialise rather than value-initialise, leaving new elements (and their pages) untouched
+	template <typename U>
+	void construct(U* p)
+	{
+		::new (static_cast<void*>(p)) U;
+	}
+
+	template <typename U, typename... Args>
+	void construct(U* p, Args&&... args)
+	{
+		::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const BigArrayAllocator<T>&, const BigArrayAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const BigArrayAllocator<T>&, const BigArrayAllocator<U>&) { return false; }
+
+template <typename T>
+using BigArray = std::vector<T, BigArrayAllocator<T>>;
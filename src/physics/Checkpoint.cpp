@@ -0,0 +1,526 @@
+#include "Checkpoint.hpp"
+
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TORUSPARTICLES_HAVE_MMAP
+#endif
+
+static_assert(sizeof(CheckpointHeader) == 152, "CheckpointHeader must have no implicit padding");
+static_assert(sizeof(CheckpointBallType) == 48, "CheckpointBallType must have no implicit padding");
+
+static const char          CHECKPOINT_MAGIC[8]   = { 'T', 'O', 'R', 'U', 'S', 'C', 'K', 'P' };
+static const std::uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+static const std::uint64_t CHECKPOINT_ALIGNMENT  = 4096;
+
+static std::uint64_t alignOffset(std::uint64_t offset)
+{
+	return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+static const void* arrayData(const Particles& particles, CheckpointArray array)
+{
+	switch (array)
+	{
+	case CHECKPOINT_X:         return particles.x.data();
+	case CHECKPOINT_Y:         return particles.y.data();
+	case CHECKPOINT_VX:        return particles.vx.data();
+	case CHECKPOINT_VY:        return particles.vy.data();
+	case CHECKPOINT_RADIUS:    return particles.radius.data();
+	case CHECKPOINT_INV_MASS:  return particles.invMass.data();
+	case CHECKPOINT_TYPEINDEX: return particles.typeindex.data();
+	case CHECKPOINT_ID:        return particles.id.data();
+	default:                   return nullptr;
+	}
+}
+
+CheckpointBallType toCheckpointBallType(const BallType& ballType)
+{
+	CheckpointBallType record;
+	std::memset(&record, 0, sizeof(record));
+
+	record.radius           = ballType.radius;
+	record.mass             = ballType.mass;
+	record.count            = ballType.count;
+	record.totalMomentum[0] = ballType.totalMomentum.x;
+	record.totalMomentum[1] = ballType.totalMomentum.y;
+	record.wrapTexture      = ballType.wrapTexture ? 1 : 0;
+	record.render           = ballType.render ? 1 : 0;
+
+	for (std::size_t c = 0; c < 4; c++)
+		record.rgba[c] = ballType.rgba[c];
+
+	return record;
+}
+
+BallType fromCheckpointBallType(const CheckpointBallType& record)
+{
+	BallType ballType;
+	ballType.radius        = record.radius;
+	ballType.mass          = record.mass;
+	ballType.count         = static_cast<std::size_t>(record.count);
+	ballType.totalMomentum = { record.totalMomentum[0], record.totalMomentum[1] };
+	ballType.wrapTexture   = record.wrapTexture != 0;
+	ballType.render        = record.render != 0;
+
+	for (std::size_t c = 0; c < 4; c++)
+		ballType.rgba[c] = record.rgba[c];
+
+	return ballType;
+}
+
+static void buildImage(const Solver& solver, float dt, std::uint64_t step, BigArray<char>& image)
+/**
+ * Lay out a checkpoint of the solver's current state in
+ * memory, exactly as it is to be written to the file.
+ */
+{
+	const Particles&             particles = solver.getParticles();
+	const std::vector<BallType>& ballTypes = solver.getBallTypes();
+	const World&                 world     = solver.getWorld();
+
+	CheckpointHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+
+	header.version        = CHECKPOINT_VERSION;
+	header.byteOrder      = CHECKPOINT_BYTE_ORDER;
+	header.headerBytes    = sizeof(CheckpointHeader);
+	header.ballTypeBytes  = sizeof(CheckpointBallType);
+	header.step           = step;
+	header.numParticles   = particles.size();
+	header.numBallTypes   = ballTypes.size();
+	header.dt             = dt;
+	header.worldBounds[0] = world.xMin;
+	header.worldBounds[1] = world.xMax;
+	header.worldBounds[2] = world.yMin;
+	header.worldBounds[3] = world.yMax;
+
+	// Every array holds 4-byte values
+	const std::uint64_t arrayBytes = header.numParticles * 4;
+
+	header.ballTypesOffset = sizeof(CheckpointHeader);
+	std::uint64_t offset = header.ballTypesOffset + header.numBallTypes * sizeof(CheckpointBallType);
+
+	for (int array = 0; array < CHECKPOINT_NUM_ARRAYS; array++)
+	{
+		header.arrayOffsets[array] = alignOffset(offset);
+		offset = header.arrayOffsets[array] + arrayBytes;
+	}
+
+	header.fileBytes = offset;
+
+	// Every byte is written below, so the image needn't be cleared
+	image.resize(header.fileBytes);
+	char* data = image.data();
+
+	std::memset(data, 0, header.arrayOffsets[0]);
+	std::memcpy(data, &header, sizeof(header));
+
+	for (std::size_t i = 0; i < ballTypes.size(); i++)
+	{
+		CheckpointBallType record = toCheckpointBallType(ballTypes[i]);
+		std::memcpy(data + header.ballTypesOffset + i * sizeof(CheckpointBallType), &record, sizeof(record));
+	}
+
+	for (int array = 0; array < CHECKPOINT_NUM_ARRAYS; array++)
+	{
+		std::uint64_t start = header.arrayOffsets[array];
+		std::uint64_t end   = array + 1 < CHECKPOINT_NUM_ARRAYS ? header.arrayOffsets[array + 1] : header.fileBytes;
+
+		if (arrayBytes > 0)
+			std::memcpy(data + start, arrayData(particles, static_cast<CheckpointArray>(array)), arrayBytes);
+		std::memset(data + start + arrayBytes, 0, end - start - arrayBytes);
+	}
+}
+
+static bool writeSynced(const std::string& path, const BigArray<char>& image)
+/**
+ * Write a file image, and (on POSIX systems) wait until it
+ * has reached the disk, so a file renamed into place after a
+ * crash is complete rather than empty or partly written.
+ */
+{
+#ifdef TORUSPARTICLES_HAVE_MMAP
+	int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (file < 0)
+		return false;
+
+	const char* data      = image.data();
+	std::size_t remaining = image.size();
+
+	while (remaining > 0)
+	{
+		ssize_t written = ::write(file, data, remaining);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			break;
+
+		data      += written;
+		remaining -= static_cast<std::size_t>(written);
+	}
+
+	bool written = remaining == 0 && ::fsync(file) == 0;
+
+	return ::close(file) == 0 && written;
+#else
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	return file.is_open() && file.write(image.data(), static_cast<std::streamsize>(image.size())) && file.flush();
+#endif
+}
+
+static bool writeImage(const std::string& path, const BigArray<char>& image)
+/**
+ * Write a file image under a temporary name, then move it
+ * into place, replacing any earlier checkpoint.
+ */
+{
+	const std::string tempPath = path + ".tmp";
+
+	if (!writeSynced(tempPath, image))
+	{
+		std::cout << "Error: could not write checkpoint to \"" << tempPath << "\"" << std::endl;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	// rename() replaces the earlier checkpoint atomically on POSIX systems, but
+	// fails on Windows if it exists, so there it is removed first
+	bool moved = std::rename(tempPath.c_str(), path.c_str()) == 0;
+
+#ifdef _WIN32
+	if (!moved)
+	{
+		std::remove(path.c_str());
+		moved = std::rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+#endif
+
+	if (!moved)
+	{
+		std::cout << "Error: could not move checkpoint to \"" << path << "\"" << std::endl;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+#ifdef TORUSPARTICLES_HAVE_MMAP
+	// Make the rename itself durable (not every file system can sync a directory)
+	std::size_t slash = path.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+
+	int directoryFile = ::open(directory.c_str(), O_RDONLY);
+
+	if (directoryFile >= 0)
+	{
+		::fsync(directoryFile);
+		::close(directoryFile);
+	}
+#endif
+
+	return true;
+}
+
+static bool readImage(const char* data, std::size_t numBytes, const std::string& path, Checkpoint& checkpoint)
+/**
+ * Check a checkpoint's header against the file and the
+ * particles against the BallTypes, then copy them out.
+ */
+{
+	auto fail = [&path](const std::string& reason)
+	{
+		std::cout << "Error: \"" << path << "\" is not a valid checkpoint (" << reason << ")" << std::endl;
+		return false;
+	};
+
+	CheckpointHeader header;
+
+	if (numBytes < sizeof(header))
+		return fail("too short");
+
+	std::memcpy(&header, data, sizeof(header));
+
+	if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+		return fail("not a checkpoint file");
+	if (header.byteOrder != CHECKPOINT_BYTE_ORDER)
+		return fail("written on a machine with a different byte order");
+	if (header.version != CHECKPOINT_VERSION)
+		return fail("format version " + std::to_string(header.version) + ", expected " + std::to_string(CHECKPOINT_VERSION));
+	if (header.headerBytes != sizeof(CheckpointHeader) || header.ballTypeBytes != sizeof(CheckpointBallType))
+		return fail("unexpected record sizes");
+	if (header.fileBytes != numBytes)
+		return fail("file is " + std::to_string(numBytes) + " bytes, expected " + std::to_string(header.fileBytes));
+
+	const std::uint64_t numParticles = header.numParticles;
+
+	if (numParticles > numBytes / 4 || numParticles > UINT32_MAX || header.numBallTypes > numBytes / sizeof(CheckpointBallType))
+		return fail("sections overrun the file");
+	if (header.ballTypesOffset > numBytes || header.numBallTypes * sizeof(CheckpointBallType) > numBytes - header.ballTypesOffset)
+		return fail("sections overrun the file");
+
+	for (std::uint64_t offset : header.arrayOffsets)
+	{
+		if (offset > numBytes || numParticles * 4 > numBytes - offset)
+			return fail("sections overrun the file");
+	}
+
+	if (!(header.dt > 0.0f) || !(header.worldBounds[1] > header.worldBounds[0]) || !(header.worldBounds[3] > header.worldBounds[2]))
+		return fail("invalid timestep or world");
+
+	// BallTypes
+	checkpoint.ballTypes.clear();
+	std::uint64_t numCounted = 0;
+
+	for (std::uint64_t i = 0; i < header.numBallTypes; i++)
+	{
+		CheckpointBallType record;
+		std::memcpy(&record, data + header.ballTypesOffset + i * sizeof(CheckpointBallType), sizeof(record));
+
+		numCounted += record.count;
+		checkpoint.ballTypes.push_back(fromCheckpointBallType(record));
+	}
+
+	if (numCounted != numParticles)
+		return fail("BallType counts do not add up to the number of particles");
+
+	// Particle arrays
+	Particles& particles = checkpoint.particles;
+	particles.resize(static_cast<std::size_t>(numParticles));
+
+	const std::size_t arrayBytes = static_cast<std::size_t>(numParticles) * 4;
+	void* arrays[CHECKPOINT_NUM_ARRAYS] = {
+		particles.x.data(), particles.y.data(), particles.vx.data(), particles.vy.data(),
+		particles.radius.data(), particles.invMass.data(), particles.typeindex.data(), particles.id.data()
+	};
+
+	for (int array = 0; array < CHECKPOINT_NUM_ARRAYS; array++)
+	{
+		if (arrayBytes > 0)
+			std::memcpy(arrays[array], data + header.arrayOffsets[array], arrayBytes);
+	}
+
+	// Particles must be grouped by BallType, with IDs numbering them from 0
+	std::vector<std::uint64_t> typeCounts(checkpoint.ballTypes.size(), 0);
+	std::vector<bool>          idSeen(static_cast<std::size_t>(numParticles), false);
+
+	for (std::size_t i = 0; i < particles.size(); i++)
+	{
+		const std::uint32_t type = particles.typeindex[i];
+		const std::uint32_t id   = particles.id[i];
+
+		if (type >= checkpoint.ballTypes.size() || (i > 0 && type < particles.typeindex[i - 1]))
+			return fail("particles are not grouped by BallType");
+		if (id >= numParticles || idSeen[id])
+			return fail("particle IDs are not unique");
+
+		typeCounts[type]++;
+		idSeen[id] = true;
+	}
+
+	for (std::size_t i = 0; i < typeCounts.size(); i++)
+	{
+		if (typeCounts[i] != checkpoint.ballTypes[i].count)
+			return fail("particles do not match the BallType counts");
+	}
+
+	checkpoint.world = World(header.worldBounds[0], header.worldBounds[1], header.worldBounds[2], header.worldBounds[3]);
+	checkpoint.dt    = header.dt;
+	checkpoint.step  = header.step;
+
+	return true;
+}
+
+bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint)
+{
+#ifdef TORUSPARTICLES_HAVE_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+	{
+		std::cout << "Error: could not open checkpoint \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	struct stat status;
+
+	if (fstat(fd, &status) != 0 || status.st_size <= 0)
+	{
+		close(fd);
+		std::cout << "Error: \"" << path << "\" is not a valid checkpoint (empty)" << std::endl;
+		return false;
+	}
+
+	const std::size_t numBytes = static_cast<std::size_t>(status.st_size);
+	void* mapping = mmap(nullptr, numBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cout << "Error: could not map checkpoint \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	// Each array is read through once, front to back
+	madvise(mapping, numBytes, MADV_SEQUENTIAL);
+	madvise(mapping, numBytes, MADV_WILLNEED);
+
+	bool loaded = readImage(static_cast<const char*>(mapping), numBytes, path, checkpoint);
+	munmap(mapping, numBytes);
+
+	return loaded;
+#else
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+	{
+		std::cout << "Error: could not open checkpoint \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	BigArray<char> image(static_cast<std::size_t>(file.tellg()));
+	file.seekg(0);
+
+	if (!file.read(image.data(), static_cast<std::streamsize>(image.size())))
+	{
+		std::cout << "Error: could not read checkpoint \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	return readImage(image.data(), image.size(), path, checkpoint);
+#endif
+}
+
+CheckpointWriter::CheckpointWriter()
+	: m_numWritten(0),
+	  m_numReplaced(0),
+	  m_stop(false),
+	  m_thread(&CheckpointWriter::writerLoop, this)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+
+	m_thread.join();
+}
+
+void CheckpointWriter::save(const std::string& path, const Solver& solver, float dt, std::uint64_t step)
+/**
+ * Claim a snapshot to fill: the one still queued, if there
+ * is one (its state is out of date), or else the one not
+ * being written. The copy is made without holding the lock,
+ * so the writer carries on meanwhile.
+ */
+{
+	Snapshot* snapshot = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (Snapshot& candidate : m_snapshots)
+		{
+			if (candidate.state == SNAPSHOT_QUEUED)
+			{
+				snapshot = &candidate;
+				m_numReplaced++;
+			}
+		}
+
+		for (Snapshot& candidate : m_snapshots)
+		{
+			if (snapshot == nullptr && candidate.state == SNAPSHOT_FREE)
+				snapshot = &candidate;
+		}
+
+		snapshot->state = SNAPSHOT_FILLING;
+	}
+
+	buildImage(solver, dt, step, snapshot->image);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		snapshot->path  = path;
+		snapshot->state = SNAPSHOT_QUEUED;
+	}
+	m_condition.notify_all();
+}
+
+void CheckpointWriter::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_condition.wait(lock,
+		[this]()
+		{
+			return m_snapshots[0].state == SNAPSHOT_FREE && m_snapshots[1].state == SNAPSHOT_FREE;
+		}
+	);
+}
+
+std::size_t CheckpointWriter::getNumWritten() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numWritten;
+}
+
+std::size_t CheckpointWriter::getNumReplaced() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numReplaced;
+}
+
+void CheckpointWriter::writerLoop()
+/**
+ * Write queued snapshots until stopped, then write any
+ * still queued before returning.
+ */
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		Snapshot* snapshot = nullptr;
+
+		m_condition.wait(lock,
+			[this, &snapshot]()
+			{
+				for (Snapshot& candidate : m_snapshots)
+					if (candidate.state == SNAPSHOT_QUEUED)
+						snapshot = &candidate;
+
+				return snapshot != nullptr || m_stop;
+			}
+		);
+
+		if (snapshot == nullptr)
+			return;
+
+		snapshot->state = SNAPSHOT_WRITING;
+		lock.unlock();
+
+		bool written = writeImage(snapshot->path, snapshot->image);
+
+		lock.lock();
+		snapshot->state = SNAPSHOT_FREE;
+		if (written)
+			m_numWritten++;
+
+		m_condition.notify_all();
+	}
+}
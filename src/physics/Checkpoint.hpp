@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "BallType.hpp"
+#include "BigArray.hpp"
+#include "Particles.hpp"
+#include "Solver.hpp"
+#include "World.hpp"
+
+/**
+ * Binary checkpoints of a simulation, from which a run can be
+ * restarted.
+ *
+ * A checkpoint file is a CheckpointHeader, the BallTypes as
+ * CheckpointBallTypes, then each particle array in turn (in
+ * the order of CheckpointArray), every array starting on a
+ * 4 KiB boundary. Values are stored as they are in memory
+ * (little-endian on every supported platform), so restarting
+ * maps the file and copies each array straight into the
+ * Particles with no parsing. The header records the format
+ * version and the size of each record, and files written
+ * with a different layout, byte order or version are
+ * rejected rather than misread.
+ *
+ * A CheckpointWriter writes checkpoints without holding up
+ * the step loop: save() copies the particles into one of two
+ * file images, and a background thread writes the image out
+ * while the simulation carries on. Each file is written
+ * under a temporary name, synced to disk and then renamed
+ * over the previous checkpoint, so a crash at any point
+ * leaves either the previous checkpoint or the new one.
+ */
+
+const std::uint32_t CHECKPOINT_VERSION = 1;
+
+enum CheckpointArray
+{
+	CHECKPOINT_X,
+	CHECKPOINT_Y,
+	CHECKPOINT_VX,
+	CHECKPOINT_VY,
+	CHECKPOINT_RADIUS,
+	CHECKPOINT_INV_MASS,
+	CHECKPOINT_TYPEINDEX,
+	CHECKPOINT_ID,
+	CHECKPOINT_NUM_ARRAYS
+};
+
+struct CheckpointHeader
+{
+	char          magic[8];        // "TORUSCKP"
+	std::uint32_t version;         // CHECKPOINT_VERSION
+	std::uint32_t byteOrder;       // 0x01020304 as written by the machine that wrote the file
+	std::uint32_t headerBytes;     // sizeof(CheckpointHeader)
+	std::uint32_t ballTypeBytes;   // sizeof(CheckpointBallType)
+	std::uint64_t fileBytes;
+	std::uint64_t step;            // Steps taken before the checkpoint
+	std::uint64_t numParticles;
+	std::uint64_t numBallTypes;
+	float         dt;
+	float         worldBounds[4];  // xMin, xMax, yMin, yMax
+	std::uint32_t padding;
+	std::uint64_t ballTypesOffset; // Offsets of each section from the start of the file
+	std::uint64_t arrayOffsets[CHECKPOINT_NUM_ARRAYS];
+};
+
+struct CheckpointBallType
+{
+	float         radius;
+	float         mass;
+	std::uint64_t count;
+	float         rgba[4];
+	float         totalMomentum[2];
+	std::uint8_t  wrapTexture;
+	std::uint8_t  render;
+	std::uint8_t  padding[6];
+};
+
+// Conversions between BallTypes and their records in files
+CheckpointBallType toCheckpointBallType(const BallType& ballType);
+BallType           fromCheckpointBallType(const CheckpointBallType& record);
+
+// The state a run is restarted from
+struct Checkpoint
+{
+	std::vector<BallType> ballTypes;
+	World                 world = World(1.0f);
+	float                 dt    = 0.0f;
+	std::uint64_t         step  = 0;
+	Particles             particles; // Grouped by BallType
+};
+
+// Load a checkpoint, printing an error and returning false if the file can't be read or is invalid
+bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint);
+
+class CheckpointWriter
+{
+public:
+	CheckpointWriter();
+	~CheckpointWriter(); // Finishes any writes still pending
+
+	CheckpointWriter(const CheckpointWriter&) = delete;
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	// Snapshot a solver's current state, to be written to path in the background.
+	// If a snapshot is still waiting to be written, it is replaced by this one
+	void save(const std::string& path, const Solver& solver, float dt, std::uint64_t step);
+	void wait(); // Wait until every snapshot taken has been written
+
+	std::size_t getNumWritten()  const; // Checkpoints written successfully
+	std::size_t getNumReplaced() const; // Snapshots replaced before they could be written
+
+private:
+	enum SnapshotState
+	{
+		SNAPSHOT_FREE,
+		SNAPSHOT_FILLING,
+		SNAPSHOT_QUEUED,
+		SNAPSHOT_WRITING
+	};
+
+	struct Snapshot
+	{
+		BigArray<char> image; // Contents of the file
+		std::string    path;
+		SnapshotState  state = SNAPSHOT_FREE;
+	};
+
+	Snapshot                m_snapshots[2]; // At most one is being written and one queued
+	std::size_t             m_numWritten;
+	std::size_t             m_numReplaced;
+	bool                    m_stop;
+	mutable std::mutex      m_mutex;
+	std::condition_variable m_condition;
+	std::thread             m_thread; // Declared last, so it starts once the rest is initialised
+
+	void writerLoop();
+};
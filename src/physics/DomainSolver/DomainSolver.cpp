@@ -0,0 +1,598 @@
+#include "DomainSolver.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "Profiler.hpp"
+
+DomainSolver::DomainSolver(Preset preset, const Particles& allParticles, Transport& transport)
+	: Solver(preset, World(preset.worldAspectRatio), ownedParticles(allParticles, World(preset.worldAspectRatio), transport.getRank(), transport.getNumRanks())),
+	  m_transport(transport),
+	  m_left((transport.getRank() + transport.getNumRanks() - 1) % transport.getNumRanks()),
+	  m_right((transport.getRank() + 1) % transport.getNumRanks()),
+	  m_stripWidth(m_world.xWidth / static_cast<float>(transport.getNumRanks())),
+	  m_stripLower(m_world.xMin + m_stripWidth * static_cast<float>(transport.getRank())),
+	  m_stripUpper(m_world.xMin + m_stripWidth * static_cast<float>(transport.getRank() + 1)),
+	  m_halo(haloWidth(preset.ballTypes)),
+	  m_failed(false),
+	  m_numSteps(0),
+	  m_numGhosts(0),
+	  m_numMigrations(0),
+	  m_bytesSent(0),
+	  m_exchangeSeconds(0.0),
+	  m_solveSeconds(0.0)
+{
+	// Balls arriving from other ranks keep their IDs
+	m_slotOfId.resize(allParticles.size());
+
+	// The local solver's balls change every step, so its grid is fixed and rebuilt in full each step
+	Preset localPreset = preset;
+	localPreset.autoTuneGrid    = false;
+	localPreset.reorderInterval = 0;
+	localPreset.neighbourSkin   = 0.0f;
+	localPreset.incrementalGrid = false;
+	localPreset.pinThreads      = false; // Every rank would pin its threads to the same CPUs
+
+	m_local = std::make_unique<SpatialHashSolver>(localPreset, localWorld(preset, transport.getRank(), transport.getNumRanks()), m_particles);
+}
+
+Particles DomainSolver::createParticles(const Preset& preset)
+{
+	return randomParticles(preset.ballTypes, World(preset.worldAspectRatio), preset.seed, preset.numThreads);
+}
+
+int DomainSolver::maxRanks(const Preset& preset)
+{
+	float halo = haloWidth(preset.ballTypes);
+
+	if (halo <= 0.0f)
+		return 1;
+
+	return std::max(1, static_cast<int>(World(preset.worldAspectRatio).xWidth / (2.0f * halo)));
+}
+
+float DomainSolver::haloWidth(const std::vector<BallType>& ballTypes)
+{
+	// Balls overlap at most a diameter of the largest ball apart
+	float maxRadius = 0.0f;
+	for (const BallType& ballType : ballTypes)
+		maxRadius = std::max(maxRadius, ballType.radius);
+
+	return 2.0f * maxRadius;
+}
+
+Particles DomainSolver::ownedParticles(const Particles& allParticles, const World& world, int rank, int numRanks)
+{
+	const float stripWidth = world.xWidth / static_cast<float>(numRanks);
+
+	Particles owned;
+
+	for (std::size_t i = 0; i < allParticles.size(); i++)
+	{
+		int owner = std::clamp(static_cast<int>(std::floor((allParticles.x[i] - world.xMin) / stripWidth)), 0, numRanks - 1);
+
+		if (owner != rank)
+			continue;
+
+		// Particles are grouped by BallType, so the owned subset stays grouped
+		owned.x.push_back(allParticles.x[i]);
+		owned.y.push_back(allParticles.y[i]);
+		owned.vx.push_back(allParticles.vx[i]);
+		owned.vy.push_back(allParticles.vy[i]);
+		owned.radius.push_back(allParticles.radius[i]);
+		owned.invMass.push_back(allParticles.invMass[i]);
+		owned.typeindex.push_back(allParticles.typeindex[i]);
+		owned.id.push_back(allParticles.id[i]);
+	}
+
+	return owned;
+}
+
+World DomainSolver::localWorld(const Preset& preset, int rank, int numRanks)
+/**
+ * The strip with a halo on either side. Ghosts lie within a
+ * halo to the right of the strip, so they are always more
+ * than a halo from the owned balls across the local world's
+ * edge, and are never mistaken for overlapping them.
+ */
+{
+	World world(preset.worldAspectRatio);
+
+	if (numRanks == 1)
+		return world;
+
+	float stripWidth = world.xWidth / static_cast<float>(numRanks);
+	float stripLower = world.xMin + stripWidth * static_cast<float>(rank);
+	float halo       = haloWidth(preset.ballTypes);
+
+	return World(stripLower - halo, stripLower + stripWidth + halo, world.yMin, world.yMax);
+}
+
+DomainStats DomainSolver::getDomainStats() const
+{
+	DomainStats stats;
+
+	stats.rank            = m_transport.getRank();
+	stats.numOwned        = m_particles.size();
+	stats.numSteps        = m_numSteps;
+	stats.numGhosts       = m_numGhosts;
+	stats.numMigrations   = m_numMigrations;
+	stats.bytesSent       = m_bytesSent;
+	stats.exchangeSeconds = m_exchangeSeconds;
+	stats.solveSeconds    = m_solveSeconds;
+	stats.momentumX       = 0.0;
+	stats.momentumY       = 0.0;
+	stats.kineticEnergy   = 0.0;
+
+	for (std::size_t i = 0; i < m_particles.size(); i++)
+	{
+		double mass = 1.0 / static_cast<double>(m_particles.invMass[i]);
+		double vx   = static_cast<double>(m_particles.vx[i]);
+		double vy   = static_cast<double>(m_particles.vy[i]);
+
+		stats.momentumX     += mass * vx;
+		stats.momentumY     += mass * vy;
+		stats.kineticEnergy += 0.5 * mass * (vx * vx + vy * vy);
+	}
+
+	return stats;
+}
+
+void DomainSolver::solve()
+/**
+ * Pairs are resolved in two phases. First each rank resolves
+ * the pairs among the balls near its right edge, its own and
+ * the ghosts, and returns the changes to the ghosts. Then it
+ * resolves the rest of the pairs in its strip, now that every
+ * ball near its edges is up to date. Each ball is only changed
+ * by one rank in each phase, so the pairs are resolved one
+ * after another, as on a single process, just in a different
+ * order.
+ */
+{
+	if (m_failed)
+		return;
+
+	const bool distributed = m_transport.getNumRanks() > 1;
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (distributed && !exchangeBalls())
+	{
+		m_failed = true;
+		return;
+	}
+
+	auto exchanged = std::chrono::steady_clock::now();
+
+	detectPairs();
+	resolveLocalPairs(m_edgePairs);
+
+	auto edgesResolved = std::chrono::steady_clock::now();
+
+	if (distributed && !returnGhostChanges())
+	{
+		m_failed = true;
+		return;
+	}
+
+	auto returned = std::chrono::steady_clock::now();
+
+	resolveLocalPairs(m_stripPairs);
+	copyOwned();
+
+	auto resolved = std::chrono::steady_clock::now();
+
+	m_exchangeSeconds += std::chrono::duration<double>(exchanged - start).count()
+	                   + std::chrono::duration<double>(returned - edgesResolved).count();
+	m_solveSeconds    += std::chrono::duration<double>(edgesResolved - exchanged).count()
+	                   + std::chrono::duration<double>(resolved - returned).count();
+	m_numSteps++;
+}
+
+bool DomainSolver::exchangeBalls()
+/**
+ * Sort the owned balls into those staying, those migrating
+ * and those to send left as ghosts, exchange them with both
+ * neighbours, and take in the balls received. Migrants
+ * leaving to the right are also kept as ghosts, since this
+ * rank still resolves their pairs near the edge, and the
+ * neighbour receiving them will not send them back until the
+ * next step.
+ */
+{
+	PROFILE_SCOPE("exchangeBalls");
+
+	const int rank     = m_transport.getRank();
+	const int numRanks = m_transport.getNumRanks();
+
+	m_owned.clear();
+	m_ghosts.clear();
+	m_haloBalls.clear();
+
+	for (int side = 0; side < 2; side++)
+		m_migrants[side].clear();
+
+	for (std::size_t i = 0; i < m_particles.size(); i++)
+	{
+		BallRecord ball = record(i);
+		int owner = ownerOf(ball.x);
+
+		if (owner == rank)
+		{
+			m_owned.push_back(ball);
+
+			if (ball.x < m_stripLower + m_halo)
+				m_haloBalls.push_back(ball);
+
+			continue;
+		}
+
+		// Head for the owner the short way round the ring of strips
+		int stepsRight = (owner - rank + numRanks) % numRanks;
+		int side = 2 * stepsRight <= numRanks ? 1 : 0;
+
+		m_migrants[side].push_back(ball);
+		m_numMigrations++;
+
+		float x = nearestImage(ball.x);
+		if (x >= m_stripUpper && x < m_stripUpper + m_halo)
+		{
+			ball.x = x;
+			m_ghosts.push_back(ball);
+		}
+	}
+
+	packMessage(m_migrants[0], m_haloBalls, m_messages[0]);
+	packMessage(m_migrants[1], {}, m_messages[1]);
+	m_bytesSent += m_messages[0].size() + m_messages[1].size();
+
+	// Send left while receiving from the right, then the reverse. With two ranks, both
+	// neighbours are the same rank, and its messages arrive in the order they were sent
+	if (!m_transport.sendReceive(m_left, m_messages[0], m_right, m_received[1]))
+		return false;
+
+	if (!m_transport.sendReceive(m_right, m_messages[1], m_left, m_received[0]))
+		return false;
+
+	std::size_t numGhostsBefore = m_ghosts.size();
+
+	for (int side = 0; side < 2; side++)
+	{
+		if (!unpackMessage(m_received[side], m_owned, m_ghosts))
+		{
+			std::cout << "Error: rank " << rank << " received a malformed message" << std::endl;
+			return false;
+		}
+	}
+
+	for (std::size_t i = numGhostsBefore; i < m_ghosts.size(); i++)
+		m_ghosts[i].x = nearestImage(m_ghosts[i].x);
+
+	m_numGhosts += m_ghosts.size() - numGhostsBefore;
+
+	setOwned(m_owned);
+
+	return true;
+}
+
+void DomainSolver::detectPairs()
+/**
+ * Collate the owned balls in this rank's strip and the ghosts
+ * by BallType into the local solver, find the overlapping
+ * pairs, and sort them into the two phases by the zones of 
+ * their balls. Pairs of two balls within a halo of the left 
+ * edge are dropped, since the left neighbour resolves them 
+ * with its edge pairs. Owned balls in transit to another
+ * strip are left out.
+ */
+{
+	PROFILE_SCOPE("detectPairs");
+
+	const int  rank        = m_transport.getRank();
+	const bool distributed = m_transport.getNumRanks() > 1;
+
+	Particles& local = m_localParticles;
+	local.resize(0);
+	m_localSlot.clear();
+	m_localId.clear();
+	m_localZone.clear();
+
+	auto append = [&](const BallRecord& ball, std::uint32_t slot, Zone zone)
+	{
+		local.x.push_back(ball.x);
+		local.y.push_back(ball.y);
+		local.vx.push_back(ball.vx);
+		local.vy.push_back(ball.vy);
+		local.radius.push_back(m_ballTypes[ball.typeindex].radius);
+		local.invMass.push_back(1.0f / m_ballTypes[ball.typeindex].mass);
+		local.typeindex.push_back(ball.typeindex);
+		local.id.push_back(static_cast<std::uint32_t>(m_localId.size()));
+		m_localId.push_back(ball.id);
+		m_localSlot.push_back(slot);
+		m_localZone.push_back(zone);
+	};
+
+	// Owned balls are grouped by BallType, so only the ghosts need sorting
+	std::stable_sort(m_ghosts.begin(), m_ghosts.end(),
+		[](const BallRecord& a, const BallRecord& b) { return a.typeindex < b.typeindex; });
+
+	std::size_t i = 0, ghost = 0;
+
+	for (std::uint32_t type = 0; type < m_ballTypes.size(); type++)
+	{
+		for (; i < m_particles.size() && m_particles.typeindex[i] == type; i++)
+		{
+			const float x = m_particles.x[i];
+
+			if (!distributed)
+				append(record(i), static_cast<std::uint32_t>(i), INTERIOR);
+			else if (ownerOf(x) == rank)
+				append(record(i), static_cast<std::uint32_t>(i), x < m_stripLower + m_halo ? LEFT_EDGE : x >= m_stripUpper - m_halo ? RIGHT_EDGE : INTERIOR);
+		}
+
+		for (; ghost < m_ghosts.size() && m_ghosts[ghost].typeindex == type; ghost++)
+			append(m_ghosts[ghost], NOT_OWNED, GHOST);
+	}
+
+	SpatialHashSolver& solver = *m_local;
+
+	solver.setParticles(local);
+	solver.findPairs(m_foundPairs);
+
+	const BigArray<std::uint32_t>& localIds = solver.getParticles().id;
+
+	m_edgePairs.clear();
+	m_stripPairs.clear();
+
+	for (const CollisionPair& pair : m_foundPairs)
+	{
+		Zone zone1 = m_localZone[localIds[pair.i1]];
+		Zone zone2 = m_localZone[localIds[pair.i2]];
+
+		bool nearRightEdge = (zone1 == RIGHT_EDGE || zone1 == GHOST) && (zone2 == RIGHT_EDGE || zone2 == GHOST);
+		bool bothOwned     = zone1 != GHOST && zone2 != GHOST;
+		bool nearLeftEdge  = zone1 == LEFT_EDGE && zone2 == LEFT_EDGE;
+
+		if (nearRightEdge)
+			m_edgePairs.push_back(pair);
+		else if (bothOwned && !nearLeftEdge)
+			m_stripPairs.push_back(pair);
+	}
+
+	// Only count the pairs this rank resolves, so the counts of the ranks add up
+	m_stats.pairTests          = solver.getStats().pairTests;
+	m_stats.overlapsFound      = m_edgePairs.size() + m_stripPairs.size();
+	m_stats.collisionsResolved = 0;
+	m_stats.wrappedPairs       = 0;
+	m_stats.occupancy          = solver.getStats().occupancy;
+	m_stats.maxCellBalls       = solver.getStats().maxCellBalls;
+}
+
+void DomainSolver::resolveLocalPairs(const std::vector<CollisionPair>& pairs)
+{
+	SpatialHashSolver& solver = *m_local;
+
+	solver.resolveSelectedPairs(pairs);
+
+	m_stats.collisionsResolved += solver.getStats().collisionsResolved;
+	m_stats.wrappedPairs       += solver.getStats().wrappedPairs;
+}
+
+bool DomainSolver::returnGhostChanges()
+/**
+ * Every ghost belongs to the neighbour on the right (or has
+ * just migrated there), so the changes made to the ghosts are
+ * sent right, while the left neighbour's changes to the balls
+ * near the left edge are received and added on, in the local
+ * solver, ready for the second phase.
+ */
+{
+	PROFILE_SCOPE("returnGhostChanges");
+
+	const Particles& solved = m_local->getParticles();
+	const Particles& local  = m_localParticles;
+
+	m_ghostChanges.clear();
+
+	for (std::size_t j = 0; j < solved.size(); j++)
+	{
+		std::uint32_t localId = solved.id[j];
+
+		if (m_localZone[localId] != GHOST)
+			continue;
+
+		BallChange change = {
+			m_localId[localId],
+			solved.x[j]  - local.x[localId],
+			solved.y[j]  - local.y[localId],
+			solved.vx[j] - local.vx[localId],
+			solved.vy[j] - local.vy[localId]
+		};
+
+		if (change.dx != 0.0f || change.dy != 0.0f || change.dvx != 0.0f || change.dvy != 0.0f)
+			m_ghostChanges.push_back(change);
+	}
+
+	packChanges(m_ghostChanges, m_messages[1]);
+	m_bytesSent += m_messages[1].size();
+
+	if (!m_transport.sendReceive(m_right, m_messages[1], m_left, m_received[0]))
+		return false;
+
+	if (!unpackChanges(m_received[0], m_ghostChanges))
+	{
+		std::cout << "Error: rank " << m_transport.getRank() << " received a malformed message" << std::endl;
+		return false;
+	}
+
+	// Find the local ID of each owned ball from its slot
+	m_localOfSlot.assign(m_particles.size(), NOT_OWNED);
+	for (std::size_t localId = 0; localId < m_localSlot.size(); localId++)
+		if (m_localSlot[localId] != NOT_OWNED)
+			m_localOfSlot[m_localSlot[localId]] = static_cast<std::uint32_t>(localId);
+
+	for (const BallChange& change : m_ghostChanges)
+	{
+		std::size_t slot = m_slotOfId[change.id];
+
+		if (slot >= m_particles.size() || m_particles.id[slot] != change.id || m_localOfSlot[slot] == NOT_OWNED)
+			continue;
+
+		m_local->addToParticle(m_local->getSlot(m_localOfSlot[slot]), change.dx, change.dy, change.dvx, change.dvy);
+	}
+
+	return true;
+}
+
+void DomainSolver::copyOwned()
+{
+	PROFILE_SCOPE("copyOwned");
+
+	const Particles& solved = m_local->getParticles();
+
+	for (std::size_t j = 0; j < solved.size(); j++)
+	{
+		std::uint32_t slot = m_localSlot[solved.id[j]];
+
+		if (slot == NOT_OWNED)
+			continue;
+
+		m_particles.x[slot]  = solved.x[j];
+		m_particles.y[slot]  = solved.y[j];
+		m_particles.vx[slot] = solved.vx[j];
+		m_particles.vy[slot] = solved.vy[j];
+	}
+}
+
+void DomainSolver::setOwned(const std::vector<BallRecord>& owned)
+{
+	for (BallType& ballType : m_ballTypes)
+		ballType.count = 0;
+
+	for (const BallRecord& ball : owned)
+		m_ballTypes[ball.typeindex].count++;
+
+	// Counting sort by BallType, keeping the order within each type
+	std::vector<std::size_t> typeStart(m_ballTypes.size() + 1, 0);
+	for (std::size_t i = 0; i < m_ballTypes.size(); i++)
+		typeStart[i + 1] = typeStart[i] + m_ballTypes[i].count;
+
+	m_particles.resize(owned.size());
+
+	for (const BallRecord& ball : owned)
+	{
+		std::size_t i = typeStart[ball.typeindex]++;
+
+		m_particles.x[i]         = ball.x;
+		m_particles.y[i]         = ball.y;
+		m_particles.vx[i]        = ball.vx;
+		m_particles.vy[i]        = ball.vy;
+		m_particles.radius[i]    = m_ballTypes[ball.typeindex].radius;
+		m_particles.invMass[i]   = 1.0f / m_ballTypes[ball.typeindex].mass;
+		m_particles.typeindex[i] = ball.typeindex;
+		m_particles.id[i]        = ball.id;
+
+		m_slotOfId[ball.id] = static_cast<std::uint32_t>(i);
+	}
+}
+
+DomainSolver::BallRecord DomainSolver::record(std::size_t i) const
+{
+	return { m_particles.x[i], m_particles.y[i], m_particles.vx[i], m_particles.vy[i], m_particles.typeindex[i], m_particles.id[i] };
+}
+
+int DomainSolver::ownerOf(float x) const
+{
+	return std::clamp(static_cast<int>(std::floor((x - m_world.xMin) / m_stripWidth)), 0, m_transport.getNumRanks() - 1);
+}
+
+float DomainSolver::nearestImage(float x) const
+{
+	float stripMid = 0.5f * (m_stripLower + m_stripUpper);
+
+	return x - m_world.xWidth * std::round((x - stripMid) / m_world.xWidth);
+}
+
+void DomainSolver::packMessage(const std::vector<BallRecord>& migrants, const std::vector<BallRecord>& halo, std::vector<std::uint8_t>& message)
+/**
+ * A message holds the number of migrants and ghosts, then
+ * the migrants' records, then the ghosts'.
+ */
+{
+	const std::uint32_t counts[2] = { static_cast<std::uint32_t>(migrants.size()), static_cast<std::uint32_t>(halo.size()) };
+
+	message.resize(sizeof(counts) + (migrants.size() + halo.size()) * sizeof(BallRecord));
+
+	std::uint8_t* out = message.data();
+	std::memcpy(out, counts, sizeof(counts));
+	out += sizeof(counts);
+
+	if (!migrants.empty())
+		std::memcpy(out, migrants.data(), migrants.size() * sizeof(BallRecord));
+	out += migrants.size() * sizeof(BallRecord);
+
+	if (!halo.empty())
+		std::memcpy(out, halo.data(), halo.size() * sizeof(BallRecord));
+}
+
+bool DomainSolver::unpackMessage(const std::vector<std::uint8_t>& message, std::vector<BallRecord>& migrants, std::vector<BallRecord>& ghosts)
+{
+	std::uint32_t counts[2];
+
+	if (message.size() < sizeof(counts))
+		return false;
+
+	std::memcpy(counts, message.data(), sizeof(counts));
+
+	if (message.size() != sizeof(counts) + (static_cast<std::size_t>(counts[0]) + counts[1]) * sizeof(BallRecord))
+		return false;
+
+	const std::uint8_t* in = message.data() + sizeof(counts);
+
+	std::size_t numMigrants = migrants.size();
+	migrants.resize(numMigrants + counts[0]);
+	if (counts[0] > 0)
+		std::memcpy(migrants.data() + numMigrants, in, counts[0] * sizeof(BallRecord));
+	in += counts[0] * sizeof(BallRecord);
+
+	std::size_t numGhosts = ghosts.size();
+	ghosts.resize(numGhosts + counts[1]);
+	if (counts[1] > 0)
+		std::memcpy(ghosts.data() + numGhosts, in, counts[1] * sizeof(BallRecord));
+
+	return true;
+}
+
+void DomainSolver::packChanges(const std::vector<BallChange>& changes, std::vector<std::uint8_t>& message)
+{
+	const std::uint32_t count = static_cast<std::uint32_t>(changes.size());
+
+	message.resize(sizeof(count) + changes.size() * sizeof(BallChange));
+	std::memcpy(message.data(), &count, sizeof(count));
+
+	if (!changes.empty())
+		std::memcpy(message.data() + sizeof(count), changes.data(), changes.size() * sizeof(BallChange));
+}
+
+bool DomainSolver::unpackChanges(const std::vector<std::uint8_t>& message, std::vector<BallChange>& changes)
+{
+	std::uint32_t count;
+
+	if (message.size() < sizeof(count))
+		return false;
+
+	std::memcpy(&count, message.data(), sizeof(count));
+
+	if (message.size() != sizeof(count) + static_cast<std::size_t>(count) * sizeof(BallChange))
+		return false;
+
+	changes.resize(count);
+	if (count > 0)
+		std::memcpy(changes.data(), message.data() + sizeof(count), count * sizeof(BallChange));
+
+	return true;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "Solver.hpp"
+#include "SpatialHashSolver.hpp"
+#include "Transport.hpp"
+#include "DomainStats.hpp"
+
+
+/**
+ * A derived class of Solver simulating one domain of a world
+ * split between several processes (ranks), which exchange
+ * balls through a Transport.
+ *
+ * The world is split along x into strips of equal width, one
+ * per rank, with rank r owning the balls whose centres lie
+ * in strip r. Each step, before resolving collisions:
+ *
+ *   - Owned balls that have left the strip are migrated to
+ *     the neighbouring rank in the direction of their new
+ *     strip (a ball that jumped more than one strip is
+ *     passed on again on later steps, and sits out the steps
+ *     it spends in transit).
+ *   - Owned balls within a halo width (the largest diameter)
+ *     of the left edge of the strip are sent to the left
+ *     neighbour as ghosts, copies that its balls may collide
+ *     with.
+ *
+ * Migrants and ghosts go to each neighbour in a single
+ * message, and both neighbours are exchanged with using a
+ * paired send and receive, so every rank talks to its two
+ * neighbours at once without deadlocking. The strips of the
+ * first and last ranks meet across the edge of the world,
+ * where the torus wraps around: positions are always kept
+ * in the global world, and each received ball is translated
+ * to the image nearest the receiving strip.
+ *
+ * Collisions are then resolved by a SpatialHashSolver holding
+ * the owned balls and the ghosts from the right, in a local
+ * world covering the strip with a halo either side (so that 
+ * ghosts never meet the far side of the strip across the
+ * local world's own wrap-around). Each pair is resolved by
+ * exactly one rank, in one of two phases:
+ *
+ *   1. Pairs among the balls within a halo of the right edge
+ *      of the strip, on either side, are resolved by the rank
+ *      on the left of the edge. The changes made to the ghosts
+ *      are then sent back to their owner (like the reverse
+ *      communication of forces in molecular dynamics codes).
+ *   2. The rest of the pairs within the strip are resolved,
+ *      starting from the updated balls.
+ *
+ * No ball is changed by two ranks in the same phase, so the
+ * pairs are resolved one after another, as on one process,
+ * and momentum and energy are conserved across the edges.
+ *
+ * Owned balls are moved through the global world with the
+ * base Solver's updatePositions().
+ *
+ * The strips must be at least two halo widths wide (see
+ * maxRanks()), and all ranks must be constructed from the
+ * same preset and particles. getSlot() only finds the
+ * particles this rank owns.
+ */
+
+class DomainSolver : public Solver
+{
+public:
+	DomainSolver(Preset preset, const Particles& allParticles, Transport& transport);
+
+	DomainStats getDomainStats() const;
+	bool        hasFailed() const { return m_failed; } // Whether the transport has failed (steps then do nothing)
+
+	static Particles createParticles(const Preset& preset); // Random particles filling the whole world, to split between ranks
+	static int       maxRanks(const Preset& preset);        // Most strips the world can be split into
+
+private:
+	// A ball as sent between ranks, with its position in the global world
+	struct BallRecord
+	{
+		float         x;
+		float         y;
+		float         vx;
+		float         vy;
+		std::uint32_t typeindex;
+		std::uint32_t id;
+	};
+
+	// A change made to a ghost, to add on to the ball by its owner
+	struct BallChange
+	{
+		std::uint32_t id;
+		float         dx;
+		float         dy;
+		float         dvx;
+		float         dvy;
+	};
+
+	// Where a ball lies in the local world, deciding which phase resolves its pairs (see solve())
+	enum Zone : std::uint8_t
+	{
+		LEFT_EDGE,  // Owned, within a halo of the left edge of the strip
+		INTERIOR,
+		RIGHT_EDGE, // Owned, within a halo of the right edge of the strip
+		GHOST
+	};
+
+	static constexpr std::uint32_t NOT_OWNED = ~std::uint32_t(0);
+
+	Transport& m_transport;
+	int        m_left;        // Rank owning the strip to the left (wrapping around)
+	int        m_right;       // Rank owning the strip to the right
+	float      m_stripWidth;
+	float      m_stripLower;  // Left edge of this rank's strip
+	float      m_stripUpper;  // Right edge of this rank's strip
+	float      m_halo;        // Width of the halos either side of the strip
+	bool       m_failed;
+
+	std::unique_ptr<SpatialHashSolver> m_local; // Resolves collisions among the owned and ghost balls
+	std::vector<std::uint32_t>         m_localSlot; // Slot in m_particles of each local ball (by local ID), or NOT_OWNED for ghosts
+	std::vector<std::uint32_t>         m_localId;   // ID of each local ball in the whole world (by local ID)
+	std::vector<Zone>                  m_localZone; // Zone of each local ball (by local ID)
+	std::vector<std::uint32_t>         m_localOfSlot; // Local ID of each ball in m_particles, or NOT_OWNED if left out
+	std::vector<CollisionPair>         m_foundPairs;  // Every pair the local solver found
+	std::vector<CollisionPair>         m_edgePairs;   // Pairs resolved in the first phase
+	std::vector<CollisionPair>         m_stripPairs;  // Pairs resolved in the second phase
+
+	// Working data, kept between steps to reuse allocations
+	std::vector<BallRecord>   m_owned;
+	std::vector<BallRecord>   m_ghosts;      // Ghost balls, translated next to this rank's strip
+	std::vector<BallRecord>   m_migrants[2]; // Balls leaving for the left and right neighbours
+	std::vector<BallRecord>   m_haloBalls;   // Ghosts for the left neighbour
+	std::vector<BallChange>   m_ghostChanges;
+	std::vector<std::uint8_t> m_messages[2]; // Outgoing messages for the left and right neighbours
+	std::vector<std::uint8_t> m_received[2]; // Incoming messages from the left and right neighbours
+	Particles                 m_localParticles;
+
+	// Statistics
+	std::size_t m_numSteps;
+	std::size_t m_numGhosts;
+	std::size_t m_numMigrations;
+	std::size_t m_bytesSent;
+	double      m_exchangeSeconds;
+	double      m_solveSeconds;
+
+	void solve() override;
+
+	// These return false if the transport failed
+	bool exchangeBalls();      // Migrate balls and send ghosts to the neighbours
+	bool returnGhostChanges(); // Send the changes to the ghosts back to their owner, and apply the changes received
+
+	void detectPairs(); // Find the overlapping pairs among the owned and ghost balls
+	void resolveLocalPairs(const std::vector<CollisionPair>& pairs);
+	void copyOwned();   // Copy the owned balls' results from the local solver
+
+	void setOwned(const std::vector<BallRecord>& owned); // Replace m_particles, grouped by BallType
+	BallRecord record(std::size_t i) const;
+
+	int   ownerOf(float x) const;   // Rank owning the strip containing x
+	float nearestImage(float x) const; // Image of x nearest this rank's strip
+
+	static void packMessage(const std::vector<BallRecord>& migrants, const std::vector<BallRecord>& halo, std::vector<std::uint8_t>& message);
+	static bool unpackMessage(const std::vector<std::uint8_t>& message, std::vector<BallRecord>& migrants, std::vector<BallRecord>& ghosts);
+	static void packChanges(const std::vector<BallChange>& changes, std::vector<std::uint8_t>& message);
+	static bool unpackChanges(const std::vector<std::uint8_t>& message, std::vector<BallChange>& changes);
+
+	static float haloWidth(const std::vector<BallType>& ballTypes);
+	static Particles ownedParticles(const Particles& allParticles, const World& world, int rank, int numRanks); // Balls whose centres lie in a rank's strip
+	static World localWorld(const Preset& preset, int rank, int numRanks);
+};
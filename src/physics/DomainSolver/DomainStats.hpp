@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Statistics describing the work and communication of one
+ * rank of a distributed run (see DomainSolver). The struct
+ * holds no pointers, so it can be passed between processes
+ * as raw bytes.
+ */
+
+struct DomainStats
+{
+	int         rank;
+	std::size_t numOwned;        // Balls owned by the rank, including any passing through
+	std::size_t numSteps;        // Steps taken so far
+	std::size_t numGhosts;       // Ghost balls received from the neighbours, summed over every step
+	std::size_t numMigrations;   // Balls handed over to the neighbours, summed over every step
+	std::size_t bytesSent;       // Message bytes sent, summed over every step
+	double      exchangeSeconds; // Time spent packing, exchanging and unpacking messages
+	double      solveSeconds;    // Time spent collating balls and resolving collisions in the domain
+
+	// Totals over the owned balls, to check conservation across ranks
+	double      momentumX;
+	double      momentumY;
+	double      kineticEnergy;
+};
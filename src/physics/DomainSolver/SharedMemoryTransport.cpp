@@ -0,0 +1,149 @@
+#include "SharedMemoryTransport.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <new>
+
+#include <sys/mman.h>
+
+SharedMemoryTransport::SharedMemoryTransport(int rank, int numRanks, std::shared_ptr<Channel> channels)
+	: Transport(rank, numRanks),
+	  m_channels(std::move(channels))
+{
+}
+
+std::vector<std::unique_ptr<Transport>> SharedMemoryTransport::create(int numRanks)
+{
+	std::vector<std::unique_ptr<Transport>> endpoints;
+
+	std::size_t numChannels = static_cast<std::size_t>(numRanks) * static_cast<std::size_t>(numRanks);
+	std::size_t regionBytes = numChannels * sizeof(Channel);
+
+	// Pages are only backed once touched, so channels between ranks that never talk cost nothing
+	void* region = mmap(nullptr, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (region == MAP_FAILED)
+	{
+		std::cout << "Error: could not map " << regionBytes << " bytes of shared memory" << std::endl;
+		return endpoints;
+	}
+
+	std::shared_ptr<Channel> channels(
+		static_cast<Channel*>(region),
+		[regionBytes](Channel* mapping) { munmap(mapping, regionBytes); }
+	);
+
+	for (std::size_t i = 0; i < numChannels; i++)
+	{
+		new (&channels.get()[i].written) std::atomic<std::uint64_t>(0);
+		new (&channels.get()[i].read)    std::atomic<std::uint64_t>(0);
+	}
+
+	for (int rank = 0; rank < numRanks; rank++)
+		endpoints.push_back(std::unique_ptr<Transport>(new SharedMemoryTransport(rank, numRanks, channels)));
+
+	return endpoints;
+}
+
+SharedMemoryTransport::Channel& SharedMemoryTransport::channel(int from, int to)
+{
+	return m_channels.get()[static_cast<std::size_t>(from) * static_cast<std::size_t>(m_numRanks) + static_cast<std::size_t>(to)];
+}
+
+bool SharedMemoryTransport::sendReceive(int dest, const std::vector<std::uint8_t>& message, int source, std::vector<std::uint8_t>& received)
+/**
+ * Alternate between writing as much of the outgoing message
+ * as fits and reading as much of the incoming message as has
+ * arrived, yielding whenever neither side makes progress.
+ * Each message is preceded by its length.
+ */
+{
+	Channel& out = channel(m_rank, dest);
+	Channel& in  = channel(source, m_rank);
+
+	const std::uint64_t length = message.size();
+	std::uint64_t       incomingLength = 0;
+
+	// Outgoing and incoming bytes, as the length followed by the message
+	const std::uint8_t* sendParts[2] = { reinterpret_cast<const std::uint8_t*>(&length), message.data() };
+	std::uint8_t*       recvParts[2] = { reinterpret_cast<std::uint8_t*>(&incomingLength), nullptr };
+	std::size_t         sendSizes[2] = { sizeof(length), message.size() };
+	std::size_t         recvSizes[2] = { sizeof(incomingLength), 0 };
+
+	std::size_t sendPart = 0, sendDone = 0; // Part being sent, and bytes of it sent so far
+	std::size_t recvPart = 0, recvDone = 0;
+
+	// Skip empty parts, moving on to receiving the message once its length has arrived
+	auto advance = [&]()
+	{
+		while (sendPart < 2 && sendDone == sendSizes[sendPart])
+		{
+			sendPart++;
+			sendDone = 0;
+		}
+
+		while (recvPart < 2 && recvDone == recvSizes[recvPart])
+		{
+			if (recvPart == 0)
+			{
+				received.resize(static_cast<std::size_t>(incomingLength));
+				recvParts[1] = received.data();
+				recvSizes[1] = received.size();
+			}
+
+			recvPart++;
+			recvDone = 0;
+		}
+	};
+
+	advance();
+
+	while (sendPart < 2 || recvPart < 2)
+	{
+		bool progress = false;
+
+		if (sendPart < 2)
+		{
+			std::uint64_t written = out.written.load(std::memory_order_relaxed);
+			std::uint64_t space   = CHANNEL_CAPACITY - (written - out.read.load(std::memory_order_acquire));
+			std::size_t   offset  = static_cast<std::size_t>(written % CHANNEL_CAPACITY);
+
+			// Copy up to the end of the ring, the free space or the part, whichever comes first
+			std::size_t count = std::min({ static_cast<std::size_t>(space), CHANNEL_CAPACITY - offset, sendSizes[sendPart] - sendDone });
+
+			if (count > 0)
+			{
+				std::memcpy(out.data + offset, sendParts[sendPart] + sendDone, count);
+				out.written.store(written + count, std::memory_order_release);
+				sendDone += count;
+				progress = true;
+			}
+		}
+
+		if (recvPart < 2)
+		{
+			std::uint64_t read      = in.read.load(std::memory_order_relaxed);
+			std::uint64_t available = in.written.load(std::memory_order_acquire) - read;
+			std::size_t   offset    = static_cast<std::size_t>(read % CHANNEL_CAPACITY);
+
+			std::size_t count = std::min({ static_cast<std::size_t>(available), CHANNEL_CAPACITY - offset, recvSizes[recvPart] - recvDone });
+
+			if (count > 0)
+			{
+				std::memcpy(recvParts[recvPart] + recvDone, in.data + offset, count);
+				in.read.store(read + count, std::memory_order_release);
+				recvDone += count;
+				progress = true;
+			}
+		}
+
+		advance();
+
+		if (!progress)
+			std::this_thread::yield();
+	}
+
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Transport.hpp"
+
+/**
+ * A derived class of Transport passing messages through a
+ * shared memory region, mapped before the ranks are forked.
+ *
+ * The region holds one channel for each ordered pair of
+ * ranks: a single-producer single-consumer ring buffer of
+ * CHANNEL_CAPACITY bytes, with the total bytes written and
+ * read kept in lock-free atomics (which work across processes
+ * sharing the mapping). Each message is written as its length
+ * followed by its bytes, streaming through the ring in pieces
+ * if it is larger. Waiting ranks spin, yielding the core, and
+ * messages are copied straight between the processes' memory
+ * rather than through the kernel.
+ */
+
+class SharedMemoryTransport : public Transport
+{
+public:
+	bool sendReceive(int dest, const std::vector<std::uint8_t>& message, int source, std::vector<std::uint8_t>& received) override;
+
+	// Map a region shared by numRanks ranks, returning every rank's endpoint (empty on failure)
+	static std::vector<std::unique_ptr<Transport>> create(int numRanks);
+
+private:
+	static const std::size_t CHANNEL_CAPACITY = std::size_t(1) << 18;
+
+	struct Channel
+	{
+		alignas(64) std::atomic<std::uint64_t> written; // Bytes written in total, advanced by the sender
+		alignas(64) std::atomic<std::uint64_t> read;    // Bytes read in total, advanced by the receiver
+		alignas(64) std::uint8_t               data[CHANNEL_CAPACITY];
+	};
+
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Channels need lock-free atomics to work across processes");
+
+	SharedMemoryTransport(int rank, int numRanks, std::shared_ptr<Channel> channels);
+
+	Channel& channel(int from, int to);
+
+	std::shared_ptr<Channel> m_channels; // Shared mapping, unmapped with the last endpoint in each process
+};
@@ -0,0 +1,178 @@
+#include "SocketTransport.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+SocketTransport::SocketTransport(int rank, int numRanks)
+	: Transport(rank, numRanks),
+	  m_sendSockets(numRanks, -1),
+	  m_recvSockets(numRanks, -1)
+{
+}
+
+SocketTransport::~SocketTransport()
+{
+	for (int rank = 0; rank < m_numRanks; rank++)
+	{
+		if (m_sendSockets[rank] >= 0)
+			close(m_sendSockets[rank]);
+
+		if (m_recvSockets[rank] >= 0 && m_recvSockets[rank] != m_sendSockets[rank])
+			close(m_recvSockets[rank]);
+	}
+}
+
+std::vector<std::unique_ptr<Transport>> SocketTransport::create(int numRanks)
+{
+	std::vector<std::unique_ptr<SocketTransport>> created;
+
+	for (int rank = 0; rank < numRanks; rank++)
+		created.push_back(std::unique_ptr<SocketTransport>(new SocketTransport(rank, numRanks)));
+
+	std::vector<std::unique_ptr<Transport>> endpoints;
+
+	for (int i = 0; i < numRanks; i++)
+	{
+		for (int j = i; j < numRanks; j++)
+		{
+			int sockets[2];
+
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+			{
+				std::cout << "Error: could not create a socket pair (" << std::strerror(errno) << ")" << std::endl;
+				return endpoints;
+			}
+
+			for (int socket : sockets)
+				fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+
+			if (i == j)
+			{
+				// A rank writes messages to itself into one end and reads them from the other
+				created[i]->m_sendSockets[i] = sockets[0];
+				created[i]->m_recvSockets[i] = sockets[1];
+			}
+			else
+			{
+				created[i]->m_sendSockets[j] = created[i]->m_recvSockets[j] = sockets[0];
+				created[j]->m_sendSockets[i] = created[j]->m_recvSockets[i] = sockets[1];
+			}
+		}
+	}
+
+	for (std::unique_ptr<SocketTransport>& endpoint : created)
+		endpoints.push_back(std::move(endpoint));
+
+	return endpoints;
+}
+
+bool SocketTransport::sendReceive(int dest, const std::vector<std::uint8_t>& message, int source, std::vector<std::uint8_t>& received)
+/**
+ * Write and read as much as the sockets accept, waiting in
+ * poll() for whichever side is unfinished when neither can
+ * make progress. Each message is preceded by its length.
+ */
+{
+	const int out = m_sendSockets[dest];
+	const int in  = m_recvSockets[source];
+
+	const std::uint64_t length = message.size();
+	std::uint64_t       incomingLength = 0;
+
+	// Outgoing and incoming bytes, as the length followed by the message
+	const std::uint8_t* sendParts[2] = { reinterpret_cast<const std::uint8_t*>(&length), message.data() };
+	std::uint8_t*       recvParts[2] = { reinterpret_cast<std::uint8_t*>(&incomingLength), nullptr };
+	std::size_t         sendSizes[2] = { sizeof(length), message.size() };
+	std::size_t         recvSizes[2] = { sizeof(incomingLength), 0 };
+
+	std::size_t sendPart = 0, sendDone = 0; // Part being sent, and bytes of it sent so far
+	std::size_t recvPart = 0, recvDone = 0;
+
+	// Skip empty parts, moving on to receiving the message once its length has arrived
+	auto advance = [&]()
+	{
+		while (sendPart < 2 && sendDone == sendSizes[sendPart])
+		{
+			sendPart++;
+			sendDone = 0;
+		}
+
+		while (recvPart < 2 && recvDone == recvSizes[recvPart])
+		{
+			if (recvPart == 0)
+			{
+				received.resize(static_cast<std::size_t>(incomingLength));
+				recvParts[1] = received.data();
+				recvSizes[1] = received.size();
+			}
+
+			recvPart++;
+			recvDone = 0;
+		}
+	};
+
+	advance();
+
+	while (sendPart < 2 || recvPart < 2)
+	{
+		bool progress = false;
+
+		if (sendPart < 2)
+		{
+			// A rank that has exited closes its sockets, which must fail the send rather than raise SIGPIPE
+			ssize_t count = send(out, sendParts[sendPart] + sendDone, sendSizes[sendPart] - sendDone, MSG_NOSIGNAL);
+
+			if (count > 0)
+			{
+				sendDone += static_cast<std::size_t>(count);
+				progress = true;
+			}
+			else if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				std::cout << "Error: rank " << m_rank << " could not send to rank " << dest << " (" << std::strerror(errno) << ")" << std::endl;
+				return false;
+			}
+		}
+
+		if (recvPart < 2)
+		{
+			ssize_t count = recv(in, recvParts[recvPart] + recvDone, recvSizes[recvPart] - recvDone, 0);
+
+			if (count > 0)
+			{
+				recvDone += static_cast<std::size_t>(count);
+				progress = true;
+			}
+			else if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			{
+				std::cout << "Error: rank " << m_rank << " could not receive from rank " << source
+				          << " (" << (count == 0 ? "connection closed" : std::strerror(errno)) << ")" << std::endl;
+				return false;
+			}
+		}
+
+		advance();
+
+		if (!progress)
+		{
+			pollfd waits[2];
+			nfds_t numWaits = 0;
+
+			if (sendPart < 2)
+				waits[numWaits++] = { out, POLLOUT, 0 };
+
+			if (recvPart < 2)
+				waits[numWaits++] = { in, POLLIN, 0 };
+
+			poll(waits, numWaits, -1);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Transport.hpp"
+
+/**
+ * A derived class of Transport passing messages through
+ * Unix-domain stream sockets, connected before the ranks
+ * are forked.
+ *
+ * Every pair of ranks is connected by a socketpair (and each
+ * rank to itself by one more), set non-blocking. Each message
+ * is written as its length followed by its bytes, and
+ * sendReceive() polls both sockets, writing and reading
+ * whatever the kernel buffers allow until both are done.
+ */
+
+class SocketTransport : public Transport
+{
+public:
+	~SocketTransport();
+
+	bool sendReceive(int dest, const std::vector<std::uint8_t>& message, int source, std::vector<std::uint8_t>& received) override;
+
+	// Connect numRanks ranks, returning every rank's endpoint (empty on failure)
+	static std::vector<std::unique_ptr<Transport>> create(int numRanks);
+
+private:
+	SocketTransport(int rank, int numRanks);
+
+	std::vector<int> m_sendSockets; // Socket to write messages for each rank to
+	std::vector<int> m_recvSockets; // Socket to read messages from each rank from (the same, except for this rank)
+};
@@ -0,0 +1,18 @@
+#include "Transport.hpp"
+
+#include <iostream>
+
+#include "SharedMemoryTransport.hpp"
+#include "SocketTransport.hpp"
+
+std::vector<std::unique_ptr<Transport>> createTransports(const std::string& kind, int numRanks)
+{
+	if (kind == "shm")
+		return SharedMemoryTransport::create(numRanks);
+
+	if (kind == "socket")
+		return SocketTransport::create(numRanks);
+
+	std::cout << "Error: unknown transport \"" << kind << "\" (expected \"shm\" or \"socket\")" << std::endl;
+	return {};
+}
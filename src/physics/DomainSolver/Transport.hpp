@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+/**
+ * An abstract Transport class for passing messages between
+ * the processes (ranks) of a distributed run. Each process
+ * holds the endpoint for its own rank.
+ *
+ * Messages are arbitrary byte strings, delivered in order
+ * between each pair of ranks. The only operation is a paired
+ * send and receive, which progresses both directions at once,
+ * so that every rank of a ring can send to its neighbour
+ * before receiving without deadlocking, however large the
+ * messages. This maps directly onto MPI_Sendrecv, so an MPI
+ * transport can be added alongside the others.
+ *
+ * List of derived classes:
+ *     SharedMemoryTransport
+ *     SocketTransport
+ *
+ * Use createTransports() to set up the endpoints of every
+ * rank before forking the processes.
+ */
+
+class Transport
+{
+public:
+	virtual ~Transport() = default;
+
+	int getRank()     const { return m_rank; }
+	int getNumRanks() const { return m_numRanks; }
+
+	// Send message to rank dest while receiving the next message from rank source into
+	// received. Returns false (after printing an error) if the transport failed
+	virtual bool sendReceive(int dest, const std::vector<std::uint8_t>& message, int source, std::vector<std::uint8_t>& received) = 0;
+
+protected:
+	Transport(int rank, int numRanks) : m_rank(rank), m_numRanks(numRanks) {}
+
+	int m_rank;
+	int m_numRanks;
+};
+
+/**
+ * Create the endpoints of every rank of a distributed run,
+ * using the transport named kind: "shm" (SharedMemoryTransport)
+ * or "socket" (SocketTransport). Must be called before forking,
+ * after which each process keeps its own rank's endpoint and
+ * destroys the rest.
+ *
+ * If the name is not recognised or the transport can't be set
+ * up, an error message is printed and an empty vector is
+ * returned.
+ */
+
+std::vector<std::unique_ptr<Transport>> createTransports(const std::string& kind, int numRanks);
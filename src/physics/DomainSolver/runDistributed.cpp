@@ -0,0 +1,216 @@
+#include "runDistributed.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "DomainSolver.hpp"
+#include "Transport.hpp"
+
+// What each rank writes back to the launching process
+struct RankReport
+{
+	DomainStats stats;
+	double      seconds;
+};
+
+static bool writeAll(int fd, const void* data, std::size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+
+	while (size > 0)
+	{
+		ssize_t count = write(fd, bytes, size);
+
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+
+		bytes += count;
+		size  -= static_cast<std::size_t>(count);
+	}
+
+	return true;
+}
+
+static bool readAll(int fd, void* data, std::size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+
+	while (size > 0)
+	{
+		ssize_t count = read(fd, bytes, size);
+
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+
+		bytes += count;
+		size  -= static_cast<std::size_t>(count);
+	}
+
+	return true;
+}
+
+static int runRank(const Preset& preset, const Particles& particles, Transport& transport, std::size_t numSteps, float dt, int reportPipe)
+/**
+ * The body of each rank's process, returning its exit code.
+ */
+{
+	DomainSolver solver(preset, particles, transport);
+
+	// Wait for every rank to be constructed: after numRanks - 1 rounds
+	// of passing to the right, every rank has heard from every other
+	std::vector<std::uint8_t> empty, received;
+
+	for (int round = 1; round < transport.getNumRanks(); round++)
+	{
+		int right = (transport.getRank() + 1) % transport.getNumRanks();
+		int left  = (transport.getRank() + transport.getNumRanks() - 1) % transport.getNumRanks();
+
+		if (!transport.sendReceive(right, empty, left, received))
+			return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (std::size_t step = 0; step < numSteps && !solver.hasFailed(); step++)
+		solver.update(dt);
+
+	auto end = std::chrono::steady_clock::now();
+
+	if (solver.hasFailed())
+		return 1;
+
+	RankReport report;
+	report.stats   = solver.getDomainStats();
+	report.seconds = std::chrono::duration<double>(end - start).count();
+
+	return writeAll(reportPipe, &report, sizeof(report)) ? 0 : 1;
+}
+
+DistributedResult runDistributed(const Preset& preset, int numRanks, const std::string& kind, std::size_t numSteps, float dt)
+{
+	DistributedResult result;
+
+	if (numRanks < 1 || numRanks > DomainSolver::maxRanks(preset))
+	{
+		std::cout << "Error: the world can be split between 1 and " << DomainSolver::maxRanks(preset) 
+		          << " ranks, not " << numRanks << std::endl;
+		return result;
+	}
+
+	setHugePageMode(preset.hugePages);
+
+	Particles particles = DomainSolver::createParticles(preset);
+
+	std::vector<std::unique_ptr<Transport>> transports = createTransports(kind, numRanks);
+
+	if (transports.empty())
+		return result;
+
+	// Children inherit unflushed output, which would otherwise be printed twice
+	std::cout.flush();
+
+	std::vector<pid_t> children;
+	std::vector<int>   reportPipes;
+
+	for (int rank = 0; rank < numRanks; rank++)
+	{
+		int pipeEnds[2];
+
+		if (pipe(pipeEnds) != 0)
+		{
+			std::cout << "Error: could not create a pipe for rank " << rank << std::endl;
+			break;
+		}
+
+		pid_t pid = fork();
+
+		if (pid < 0)
+		{
+			std::cout << "Error: could not start rank " << rank << std::endl;
+			close(pipeEnds[0]);
+			close(pipeEnds[1]);
+			break;
+		}
+
+		if (pid == 0)
+		{
+			close(pipeEnds[0]);
+			for (int pipeEnd : reportPipes)
+				close(pipeEnd);
+
+			// Keep only this rank's endpoint, so the others' sockets close when their ranks exit
+			for (int other = 0; other < numRanks; other++)
+				if (other != rank)
+					transports[other].reset();
+
+			int code = runRank(preset, particles, *transports[rank], numSteps, dt, pipeEnds[1]);
+
+			std::cout.flush();
+			std::_Exit(code);
+		}
+
+		close(pipeEnds[1]);
+		children.push_back(pid);
+		reportPipes.push_back(pipeEnds[0]);
+	}
+
+	transports.clear();
+
+	bool success = static_cast<int>(children.size()) == numRanks;
+
+	// Ranks wait on each other, so once one fails the rest are stopped
+	if (!success)
+		for (pid_t child : children)
+			kill(child, SIGKILL);
+
+	for (std::size_t remaining = children.size(); remaining > 0; remaining--)
+	{
+		int status = 0;
+		pid_t pid = waitpid(-1, &status, 0);
+
+		if (pid < 0)
+			break;
+
+		if (success && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+		{
+			std::cout << "Error: a rank of the distributed run failed, stopping the others" << std::endl;
+			success = false;
+
+			for (pid_t child : children)
+				if (child != pid)
+					kill(child, SIGKILL);
+		}
+	}
+
+	for (int pipeEnd : reportPipes)
+	{
+		RankReport report;
+
+		if (success && readAll(pipeEnd, &report, sizeof(report)))
+		{
+			result.ranks.push_back(report.stats);
+			result.seconds = std::max(result.seconds, report.seconds);
+		}
+		else
+			success = false;
+
+		close(pipeEnd);
+	}
+
+	result.success = success;
+
+	return result;
+}
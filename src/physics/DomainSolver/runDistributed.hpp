@@ -0,0 +1,34 @@
+#pragma once
+
+/**
+ * A function to run a preset split between numRanks processes
+ * on this machine, each simulating one strip of the world with
+ * a DomainSolver, connected by the transport named kind (see
+ * createTransports()).
+ *
+ * The particles are generated once, before forking, so every
+ * rank starts from the same state. Each rank then takes numSteps
+ * steps of dt, timed from a barrier after construction, and 
+ * sends its statistics back through a pipe. Only the calling
+ * process creates the ranks, and it should not be running other
+ * threads when it does.
+ *
+ * If any rank fails (or the transport can't be set up), an 
+ * error message is printed, the other ranks are stopped, and 
+ * the result's success flag is false.
+ */
+
+#include <vector>
+#include <string>
+
+#include "Preset.hpp"
+#include "DomainStats.hpp"
+
+struct DistributedResult
+{
+	bool                     success = false;
+	double                   seconds = 0.0; // Wall time of the slowest rank
+	std::vector<DomainStats> ranks;
+};
+
+DistributedResult runDistributed(const Preset& preset, int numRanks, const std::string& kind, std::size_t numSteps, float dt);
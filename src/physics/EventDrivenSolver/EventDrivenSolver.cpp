@@ -0,0 +1,568 @@
+#include "EventDrivenSolver.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+EventDrivenSolver::EventDrivenSolver(Preset preset)
+	: EventDrivenSolver(preset, World(preset.worldAspectRatio), randomParticles(preset.ballTypes, World(preset.worldAspectRatio), preset.seed, preset.numThreads))
+{
+}
+
+EventDrivenSolver::EventDrivenSolver(Preset preset, const World& world, Particles particles)
+	: Solver(preset, world, std::move(particles)),
+	  m_time(0.0),
+	  m_targetTime(0.0),
+	  m_numCollisions(0),
+	  m_numCellCrossings(0)
+{
+	const std::size_t numBalls = m_particles.size();
+
+	m_x.assign(m_particles.x.begin(), m_particles.x.end());
+	m_y.assign(m_particles.y.begin(), m_particles.y.end());
+	m_vx.assign(m_particles.vx.begin(), m_particles.vx.end());
+	m_vy.assign(m_particles.vy.begin(), m_particles.vy.end());
+	m_localTime.assign(numBalls, 0.0);
+	m_collisionCount.assign(numBalls, 0);
+	m_wrapX.assign(numBalls, 0);
+	m_wrapY.assign(numBalls, 0);
+
+	buildLevels();
+
+	m_next.resize(numBalls);
+	m_prev.resize(numBalls);
+	m_row.resize(numBalls);
+	m_col.resize(numBalls);
+
+	for (std::size_t i = 0; i < numBalls; i++)
+	{
+		const Level& level = levelOf(i);
+
+		double row = std::floor((m_y[i] - m_world.yMin) / level.cellHeight);
+		double col = std::floor((m_x[i] - m_world.xMin) / level.cellWidth);
+
+		m_row[i] = static_cast<std::uint32_t>(std::min(std::max(row, 0.0), static_cast<double>(level.numRows - 1)));
+		m_col[i] = static_cast<std::uint32_t>(std::min(std::max(col, 0.0), static_cast<double>(level.numCols - 1)));
+
+		insertIntoCell(i);
+	}
+
+	// Start with every ball in the heap and no events, so the heap is in order
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	m_events.assign(numBalls, Event{ infinity, infinity, 0, 0, 0, 0, false });
+	m_heap.resize(numBalls);
+	m_heapPos.resize(numBalls);
+
+	for (std::size_t i = 0; i < numBalls; i++)
+	{
+		m_heap[i]    = { infinity, static_cast<std::uint32_t>(i) };
+		m_heapPos[i] = static_cast<std::uint32_t>(i);
+	}
+
+	for (std::size_t i = 0; i < numBalls; i++)
+		predictEvents(i, 0.0);
+}
+
+void EventDrivenSolver::buildLevels()
+/**
+ * Group BallTypes into levels of similar radius, starting a
+ * new level whenever a radius exceeds twice the smallest
+ * radius on the current one, and size each level's cells.
+ */
+{
+	std::vector<std::size_t> order(m_ballTypes.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(),
+		[this](std::size_t a, std::size_t b){ return m_ballTypes[a].radius < m_ballTypes[b].radius; });
+
+	m_levelOfType.assign(m_ballTypes.size(), 0);
+	double levelMinRadius = 0.0;
+
+	for (std::size_t typeIndex : order)
+	{
+		const BallType& ballType = m_ballTypes[typeIndex];
+
+		if (ballType.count == 0)
+			continue;
+
+		if (m_levels.empty() || ballType.radius > 2.0 * levelMinRadius)
+		{
+			m_levels.push_back(Level{});
+			levelMinRadius = ballType.radius;
+		}
+
+		m_levels.back().maxRadius = ballType.radius;
+		m_levelOfType[typeIndex]  = m_levels.size() - 1;
+	}
+
+	if (m_levels.empty())
+		m_levels.push_back(Level{});
+
+	// Cells must be at least as wide as the level's largest ball, so that touching
+	// balls of the level always lie in neighbouring cells. Beyond that, aim for about
+	// two cells per ball in the world: smaller cells mean more cell crossings, but
+	// fewer balls to test on each event. Coarse levels with few balls keep small
+	// cells, so that their balls' predictions only look at the finer levels nearby
+	const float spacing = 0.7f * std::sqrt(m_world.xWidth * m_world.yWidth / static_cast<float>(std::max<std::size_t>(1, m_particles.size())));
+
+	std::size_t cellOffset = 0;
+
+	for (Level& level : m_levels)
+	{
+		float cellSize = std::max(2.0f * static_cast<float>(level.maxRadius), spacing);
+
+		level.numRows = std::max<std::size_t>(1, static_cast<std::size_t>(m_world.yWidth / cellSize));
+		level.numCols = std::max<std::size_t>(1, static_cast<std::size_t>(m_world.xWidth / cellSize));
+
+		level.cellWidth  = static_cast<double>(m_world.xWidth) / static_cast<double>(level.numCols);
+		level.cellHeight = static_cast<double>(m_world.yWidth) / static_cast<double>(level.numRows);
+
+		level.cellOffset = cellOffset;
+		cellOffset += level.numRows * level.numCols;
+	}
+
+	m_cellHead.assign(cellOffset, -1);
+}
+
+void EventDrivenSolver::update(float dt)
+{
+	m_targetTime = m_time + static_cast<double>(dt);
+
+	solve();
+
+	// Bring every ball up to the target time and publish the new state
+	for (std::size_t i = 0; i < m_particles.size(); i++)
+	{
+		advance(i, m_targetTime);
+
+		m_particles.x[i]  = static_cast<float>(m_x[i]);
+		m_particles.y[i]  = static_cast<float>(m_y[i]);
+		m_particles.vx[i] = static_cast<float>(m_vx[i]);
+		m_particles.vy[i] = static_cast<float>(m_vy[i]);
+	}
+
+	m_time = m_targetTime;
+
+	countStep();
+}
+
+void EventDrivenSolver::solve()
+/**
+ * Process events in time order up to m_targetTime.
+ */
+{
+	const std::size_t collisionsBefore = m_numCollisions;
+	m_stats.wrappedPairs = 0;
+
+	while (!m_heap.empty() && m_heap.front().time <= m_targetTime)
+	{
+		const std::size_t i = m_heap.front().i;
+		const Event& event  = m_events[i];
+
+		if (event.crossingTime <= event.collisionTime)
+			processCellCrossing(i);
+		else if (m_collisionCount[event.partner] == event.partnerCount)
+			processCollision(i);
+		else
+		{
+			// The other ball has collided since: look for the next collision afresh
+			advance(i, event.collisionTime);
+			predictEvents(i, event.collisionTime);
+		}
+	}
+
+	m_stats.collisionsResolved = m_numCollisions - collisionsBefore;
+}
+
+void EventDrivenSolver::advance(std::size_t i, double time)
+{
+	double elapsed = time - m_localTime[i];
+
+	m_x[i] += m_vx[i] * elapsed;
+	m_y[i] += m_vy[i] * elapsed;
+	m_localTime[i] = time;
+}
+
+void EventDrivenSolver::predictEvents(std::size_t i, double time)
+/**
+ * Predict collisions between ball i and the balls of each
+ * level in the cells within reach of its own cell, and when
+ * ball i leaves its cell.
+ */
+{
+	const Level& own = levelOf(i);
+
+	m_events[i].collisionTime = std::numeric_limits<double>::infinity();
+
+	for (const Level& level : m_levels)
+	{
+		CellRange cells = cellsWithinReach(own, static_cast<int>(m_row[i]), static_cast<int>(m_col[i]), level);
+		predictCollisions(i, time, level, cells.rowLow, cells.rowHigh, cells.colLow, cells.colHigh);
+	}
+
+	predictCrossing(i, time);
+	updateHeap(i);
+}
+
+void EventDrivenSolver::predictCrossing(std::size_t i, double time)
+/**
+ * Predict when ball i, which is at time, reaches the side of
+ * its cell.
+ */
+{
+	const Level& own = levelOf(i);
+	const double infinity = std::numeric_limits<double>::infinity();
+	double timeX = infinity;
+	double timeY = infinity;
+
+	if (m_vx[i] > 0.0)
+		timeX = (m_world.xMin + (m_col[i] + 1) * own.cellWidth - m_x[i]) / m_vx[i];
+	else if (m_vx[i] < 0.0)
+		timeX = (m_world.xMin + m_col[i] * own.cellWidth - m_x[i]) / m_vx[i];
+
+	if (m_vy[i] > 0.0)
+		timeY = (m_world.yMin + (m_row[i] + 1) * own.cellHeight - m_y[i]) / m_vy[i];
+	else if (m_vy[i] < 0.0)
+		timeY = (m_world.yMin + m_row[i] * own.cellHeight - m_y[i]) / m_vy[i];
+
+	Event& event = m_events[i];
+	event.crossX = timeX <= timeY;
+	event.crossingTime = (timeX == infinity && timeY == infinity) ? infinity : time + std::max(0.0, std::min(timeX, timeY));
+}
+
+EventDrivenSolver::CellRange EventDrivenSolver::cellsWithinReach(const Level& own, int row, int col, const Level& level) const
+/**
+ * On own level, these are the neighbouring cells, as the
+ * cells are at least as wide as the reach. The row and column
+ * may lie outside the grid (as does the cell a ball has just
+ * left by wrapping, seen from its new cell), in which case
+ * the cells are those of the cell inside the grid, translated
+ * by whole grids, so a cell is given the same cells whichever
+ * frame it is seen from.
+ */
+{
+	const int numRows = static_cast<int>(own.numRows);
+	const int numCols = static_cast<int>(own.numCols);
+	const int shiftY  = (row < 0) ? -((numRows - 1 - row) / numRows) : row / numRows;
+	const int shiftX  = (col < 0) ? -((numCols - 1 - col) / numCols) : col / numCols;
+
+	const double reach      = own.maxRadius + level.maxRadius;
+	const double cellLeft   = (col - shiftX * numCols) * own.cellWidth; // From the world's lower boundaries
+	const double cellBottom = (row - shiftY * numRows) * own.cellHeight;
+
+	const int levelShiftY = shiftY * static_cast<int>(level.numRows);
+	const int levelShiftX = shiftX * static_cast<int>(level.numCols);
+
+	CellRange cells;
+	cells.rowLow  = static_cast<int>(std::floor((cellBottom - reach) / level.cellHeight)) + levelShiftY;
+	cells.rowHigh = static_cast<int>(std::ceil((cellBottom + own.cellHeight + reach) / level.cellHeight)) - 1 + levelShiftY;
+	cells.colLow  = static_cast<int>(std::floor((cellLeft - reach) / level.cellWidth)) + levelShiftX;
+	cells.colHigh = static_cast<int>(std::ceil((cellLeft + own.cellWidth + reach) / level.cellWidth)) - 1 + levelShiftX;
+
+	return cells;
+}
+
+void EventDrivenSolver::predictCollisions(std::size_t i, double time, const Level& level, int rowLow, int rowHigh, int colLow, int colHigh)
+/**
+ * Predict collisions between ball i, which is at time, and
+ * the balls in the given cells of level. Cells across the
+ * world boundary are visited with the balls in them
+ * translated by world widths or heights, so small grids
+ * (fewer than three cells across) visit several images of
+ * the same cell, as they should.
+ */
+{
+	const int numRows = static_cast<int>(level.numRows);
+	const int numCols = static_cast<int>(level.numCols);
+
+	for (int rowRaw = rowLow; rowRaw <= rowHigh; rowRaw++)
+	{
+		int shiftY = (rowRaw < 0) ? -((numRows - 1 - rowRaw) / numRows) : rowRaw / numRows;
+		int row    = rowRaw - shiftY * numRows;
+
+		for (int colRaw = colLow; colRaw <= colHigh; colRaw++)
+		{
+			int shiftX = (colRaw < 0) ? -((numCols - 1 - colRaw) / numCols) : colRaw / numCols;
+			int col    = colRaw - shiftX * numCols;
+
+			for (std::int32_t j = m_cellHead[level.cellOffset + row * level.numCols + col]; j != -1; j = m_next[j])
+			{
+				if (static_cast<std::size_t>(j) != i)
+					predictCollision(i, j, time, shiftX, shiftY);
+			}
+		}
+	}
+}
+
+void EventDrivenSolver::predictCollision(std::size_t i, std::size_t j, double time, int shiftX, int shiftY)
+/**
+ * Ball i is at time, and ball j is translated by (shiftX, shiftY)
+ * world sizes. Solves |dr + dv t| = r_i + r_j for the earliest
+ * t >= 0, for approaching balls only, and makes the collision
+ * the pending one of either ball it comes before. Ball i's
+ * place in the heap is left to the caller.
+ */
+{
+	double elapsedJ = time - m_localTime[j];
+
+	double dx  = m_x[i] - (m_x[j] + m_vx[j] * elapsedJ + shiftX * static_cast<double>(m_world.xWidth));
+	double dy  = m_y[i] - (m_y[j] + m_vy[j] * elapsedJ + shiftY * static_cast<double>(m_world.yWidth));
+	double dvx = m_vx[i] - m_vx[j];
+	double dvy = m_vy[i] - m_vy[j];
+
+	double b = dx * dvx + dy * dvy;
+
+	if (b >= 0.0) // Receding
+		return;
+
+	double radiusSum = static_cast<double>(m_particles.radius[i]) + static_cast<double>(m_particles.radius[j]);
+	double c = dx * dx + dy * dy - radiusSum * radiusSum;
+
+	// Balls overlapping by more than rounding error can account for pass through each other
+	if (c < -OVERLAP_TOLERANCE * radiusSum * radiusSum)
+		return;
+
+	double a = dvx * dvx + dvy * dvy;
+	double discriminant = b * b - a * c;
+
+	if (discriminant < 0.0) // Miss
+		return;
+
+	// Earliest root, in a form that avoids cancellation. Balls already
+	// touching (up to rounding) collide immediately
+	double collisionTime = time + ((c <= 0.0) ? 0.0 : c / (-b + std::sqrt(discriminant)));
+
+	// Translation less the wrap counts, which stays the same as either ball wraps
+	std::int32_t storedShiftX = shiftX + m_wrapX[i] - m_wrapX[j];
+	std::int32_t storedShiftY = shiftY + m_wrapY[i] - m_wrapY[j];
+
+	Event& eventI = m_events[i];
+
+	if (collisionTime < eventI.collisionTime)
+	{
+		eventI.collisionTime = collisionTime;
+		eventI.partner       = static_cast<std::uint32_t>(j);
+		eventI.partnerCount  = m_collisionCount[j];
+		eventI.shiftX        = storedShiftX;
+		eventI.shiftY        = storedShiftY;
+	}
+
+	Event& eventJ = m_events[j];
+
+	if (collisionTime < eventJ.collisionTime)
+	{
+		eventJ.collisionTime = collisionTime;
+		eventJ.partner       = static_cast<std::uint32_t>(i);
+		eventJ.partnerCount  = m_collisionCount[i];
+		eventJ.shiftX        = -storedShiftX;
+		eventJ.shiftY        = -storedShiftY;
+
+		updateHeap(j);
+	}
+}
+
+void EventDrivenSolver::processCollision(std::size_t i)
+/**
+ * Exchange momentum along the line of centres, as in
+ * Solver::resolveCollision() but without dislodging.
+ */
+{
+	const Event& event  = m_events[i];
+	const std::size_t j = event.partner;
+	const double time   = event.collisionTime;
+
+	advance(i, time);
+	advance(j, time);
+
+	int shiftX = event.shiftX + m_wrapX[j] - m_wrapX[i];
+	int shiftY = event.shiftY + m_wrapY[j] - m_wrapY[i];
+
+	double dx  = m_x[i] - (m_x[j] + shiftX * static_cast<double>(m_world.xWidth));
+	double dy  = m_y[i] - (m_y[j] + shiftY * static_cast<double>(m_world.yWidth));
+	double dvx = m_vx[i] - m_vx[j];
+	double dvy = m_vy[i] - m_vy[j];
+
+	double invMass1 = m_particles.invMass[i];
+	double invMass2 = m_particles.invMass[j];
+
+	// Equivalent to 2*m2/(m1+m2) and 2*m1/(m1+m2) respectively
+	double impulse = (dvx * dx + dvy * dy) / (dx * dx + dy * dy);
+	double collisionCoefficient1 = -(2.0 * invMass1 / (invMass1 + invMass2)) * impulse;
+	double collisionCoefficient2 =  (2.0 * invMass2 / (invMass1 + invMass2)) * impulse;
+
+	m_vx[i] += dx * collisionCoefficient1;
+	m_vy[i] += dy * collisionCoefficient1;
+	m_vx[j] += dx * collisionCoefficient2;
+	m_vy[j] += dy * collisionCoefficient2;
+
+	m_collisionCount[i]++;
+	m_collisionCount[j]++;
+	m_numCollisions++;
+	m_stats.wrappedPairs += shiftX != 0 || shiftY != 0;
+
+	predictEvents(i, time);
+	predictEvents(j, time);
+}
+
+void EventDrivenSolver::processCellCrossing(std::size_t i)
+/**
+ * Move the ball into the neighbouring cell, wrapping its
+ * position across the world boundary when leaving the grid.
+ * The ball's velocity is unchanged, so its pending collision
+ * still stands if the other ball has not collided since, and
+ * only the balls in cells newly within reach need pairing
+ * with it. Otherwise its events are predicted afresh.
+ */
+{
+	const Level& own  = levelOf(i);
+	const double time = m_events[i].crossingTime;
+	const bool crossX = m_events[i].crossX;
+
+	advance(i, time);
+	removeFromCell(i);
+
+	// The cell left, in the frame of the new cell (outside the grid after wrapping)
+	int oldRow = static_cast<int>(m_row[i]);
+	int oldCol = static_cast<int>(m_col[i]);
+
+	if (crossX)
+	{
+		if (m_vx[i] > 0.0 && ++m_col[i] == own.numCols)
+		{
+			m_col[i] = 0;
+			m_x[i] -= m_world.xWidth;
+			m_wrapX[i]++;
+		}
+		else if (m_vx[i] < 0.0 && m_col[i]-- == 0)
+		{
+			m_col[i] = static_cast<std::uint32_t>(own.numCols - 1);
+			m_x[i] += m_world.xWidth;
+			m_wrapX[i]--;
+		}
+
+		oldCol = static_cast<int>(m_col[i]) + ((m_vx[i] > 0.0) ? -1 : 1);
+	}
+	else
+	{
+		if (m_vy[i] > 0.0 && ++m_row[i] == own.numRows)
+		{
+			m_row[i] = 0;
+			m_y[i] -= m_world.yWidth;
+			m_wrapY[i]++;
+		}
+		else if (m_vy[i] < 0.0 && m_row[i]-- == 0)
+		{
+			m_row[i] = static_cast<std::uint32_t>(own.numRows - 1);
+			m_y[i] += m_world.yWidth;
+			m_wrapY[i]--;
+		}
+
+		oldRow = static_cast<int>(m_row[i]) + ((m_vy[i] > 0.0) ? -1 : 1);
+	}
+
+	insertIntoCell(i);
+	m_numCellCrossings++;
+
+	const Event& event = m_events[i];
+
+	if (event.collisionTime != std::numeric_limits<double>::infinity() && m_collisionCount[event.partner] != event.partnerCount)
+	{
+		predictEvents(i, time);
+		return;
+	}
+
+	const int row = static_cast<int>(m_row[i]);
+	const int col = static_cast<int>(m_col[i]);
+
+	for (const Level& level : m_levels)
+	{
+		CellRange before = cellsWithinReach(own, oldRow, oldCol, level);
+		CellRange after  = cellsWithinReach(own, row, col, level);
+
+		// The cells within reach move along one axis, uncovering cells on at most one side
+		if (crossX)
+		{
+			predictCollisions(i, time, level, after.rowLow, after.rowHigh, after.colLow, std::min(after.colHigh, before.colLow - 1));
+			predictCollisions(i, time, level, after.rowLow, after.rowHigh, std::max(after.colLow, before.colHigh + 1), after.colHigh);
+		}
+		else
+		{
+			predictCollisions(i, time, level, after.rowLow, std::min(after.rowHigh, before.rowLow - 1), after.colLow, after.colHigh);
+			predictCollisions(i, time, level, std::max(after.rowLow, before.rowHigh + 1), after.rowHigh, after.colLow, after.colHigh);
+		}
+	}
+
+	predictCrossing(i, time);
+	updateHeap(i);
+}
+void EventDrivenSolver::insertIntoCell(std::size_t i)
+{
+	const Level& level = levelOf(i);
+	std::int32_t& head = m_cellHead[level.cellOffset + m_row[i] * level.numCols + m_col[i]];
+
+	m_prev[i] = -1;
+	m_next[i] = head;
+
+	if (head != -1)
+		m_prev[head] = static_cast<std::int32_t>(i);
+
+	head = static_cast<std::int32_t>(i);
+}
+
+void EventDrivenSolver::removeFromCell(std::size_t i)
+{
+	const Level& level = levelOf(i);
+
+	if (m_prev[i] != -1)
+		m_next[m_prev[i]] = m_next[i];
+	else
+		m_cellHead[level.cellOffset + m_row[i] * level.numCols + m_col[i]] = m_next[i];
+
+	if (m_next[i] != -1)
+		m_prev[m_next[i]] = m_prev[i];
+}
+
+void EventDrivenSolver::updateHeap(std::size_t i)
+/**
+ * Sift ball i up or down the heap to the place of its
+ * event's new time.
+ */
+{
+	const Event& event = m_events[i];
+	HeapEntry entry = { std::min(event.collisionTime, event.crossingTime), static_cast<std::uint32_t>(i) };
+
+	const std::size_t size = m_heap.size();
+	std::size_t pos = m_heapPos[i];
+
+	while (pos > 0 && m_heap[(pos - 1) / 2].time > entry.time)
+	{
+		std::size_t parent = (pos - 1) / 2;
+		m_heap[pos] = m_heap[parent];
+		m_heapPos[m_heap[pos].i] = static_cast<std::uint32_t>(pos);
+		pos = parent;
+	}
+
+	while (true)
+	{
+		std::size_t child = 2 * pos + 1;
+
+		if (child >= size)
+			break;
+
+		if (child + 1 < size && m_heap[child + 1].time < m_heap[child].time)
+			child++;
+
+		if (m_heap[child].time >= entry.time)
+			break;
+
+		m_heap[pos] = m_heap[child];
+		m_heapPos[m_heap[pos].i] = static_cast<std::uint32_t>(pos);
+		pos = child;
+	}
+
+	m_heap[pos] = entry;
+	m_heapPos[i] = static_cast<std::uint32_t>(pos);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Solver.hpp"
+
+
+/**
+ * A derived class of Solver implementing event-driven
+ * molecular dynamics for hard disks.
+ *
+ * Rather than stepping every ball forward by dt and then
+ * looking for overlaps, the solver predicts the exact time
+ * of each collision and jumps from one event to the next,
+ * so no collision is missed however fast the balls move,
+ * and no work is spent on steps where nothing happens.
+ * Collisions are perfectly elastic and balls are not
+ * dislodged, so kinetic energy is conserved up to rounding.
+ *
+ * Each ball holds a single pending event: the earliest of
+ * its earliest predicted collision and its leaving its cell.
+ * The balls are kept in a binary heap ordered by the time of
+ * that event, with each ball's position in the heap recorded
+ * so its entry can be moved when its event changes. The heap
+ * thus always holds one entry per ball, and predictions that
+ * are not the earliest for either of their balls are dropped
+ * as soon as they are made.
+ *
+ * To limit the number of balls each prediction considers,
+ * BallTypes of similar radius are grouped into levels (as in
+ * SpatialHashSolver), and each level divides the world into
+ * a grid of cells at least as wide as its largest ball. A
+ * ball is only paired with the balls of each level whose
+ * cells lie within reach of its own cell: on its own level,
+ * the eight neighbouring cells, and on other levels, the
+ * cells touched by its cell grown by the two levels' largest
+ * radii (wrapping around the torus, with the image of the
+ * neighbour translated to lie next to the ball). Any two
+ * balls that can touch lie in cells within reach of each
+ * other. A collision predicted between two balls replaces
+ * the pending collision of either ball it precedes.
+ *
+ * Collisions are invalidated lazily: each ball counts the
+ * collisions it has taken part in, and a pending collision
+ * records the count of the other ball when predicted. When
+ * a ball's collision comes up and the other ball's count has
+ * since changed, the ball's events are predicted again
+ * instead. When a ball leaves its cell, it moves to the next
+ * cell on its level (wrapping its position across the world
+ * boundary if needed), keeps its pending collision if still
+ * valid, and is only paired with the balls in the strip of
+ * cells newly within reach. Each ball counts how often it
+ * has wrapped across the world boundary, and collisions are
+ * stored with their translation less the two balls' counts,
+ * so they stay valid as either ball wraps.
+ *
+ * Each ball is only advanced to the time of its own events
+ * (its local time), so an event costs the same however many
+ * balls there are. update(dt) processes every event up to
+ * the target time, then advances all balls to it and copies
+ * their state into m_particles.
+ *
+ * Balls that overlap (e.g. from the random initial placement)
+ * pass through each other until they have separated, after
+ * which they collide as normal. Overlapping balls cannot be
+ * pushed apart by elastic collisions alone, and colliding
+ * them instead can trap them in endless collisions at a
+ * single instant.
+ *
+ * Event processing is inherently sequential, so the solver
+ * runs on a single thread and ignores the preset's thread
+ * count.
+ */
+
+class EventDrivenSolver : public Solver
+{
+public:
+	EventDrivenSolver(Preset preset);
+	EventDrivenSolver(Preset preset, const World& world, Particles particles);
+
+	void update(float dt) override; // Advance exactly dt in time
+
+	std::size_t getNumCollisions()    const { return m_numCollisions; }
+	std::size_t getNumCellCrossings() const { return m_numCellCrossings; }
+
+private:
+	struct Event // Pending event of a ball
+	{
+		double        collisionTime; // Earliest predicted collision (infinity if none)
+		double        crossingTime;  // When the ball leaves its cell (infinity if never)
+		std::uint32_t partner;       // Other ball of the collision
+		std::uint32_t partnerCount;  // Collision count of the partner when predicted
+		std::int32_t  shiftX;        // World widths the partner is translated by to lie next to the ball, less the balls' wrap counts
+		std::int32_t  shiftY;        // World heights the partner is translated by to lie next to the ball, less the balls' wrap counts
+		bool          crossX;        // Whether the ball leaves its cell through a vertical side
+	};
+
+	struct HeapEntry
+	{
+		double        time; // Time of the ball's pending event
+		std::uint32_t i;
+	};
+
+	struct CellRange // Raw cell indices, wrapped around the grid when visited
+	{
+		int rowLow;
+		int rowHigh;
+		int colLow;
+		int colHigh;
+	};
+
+	static constexpr double OVERLAP_TOLERANCE = 1e-6; // Relative overlap treated as touching
+
+	struct Level // Cell grid of the BallTypes of similar radius
+	{
+		std::size_t numRows;
+		std::size_t numCols;
+		double      cellWidth;
+		double      cellHeight;
+		double      maxRadius;  // Radius of the largest ball on the level
+		std::size_t cellOffset; // Index of the level's first cell in m_cellHead
+	};
+
+	// Ball state, at each ball's local time
+	std::vector<double>        m_x;
+	std::vector<double>        m_y;
+	std::vector<double>        m_vx;
+	std::vector<double>        m_vy;
+	std::vector<double>        m_localTime;
+	std::vector<std::uint32_t> m_collisionCount;
+	std::vector<std::int32_t>  m_wrapX; // Times each ball has wrapped to the world's left side, less to its right
+	std::vector<std::int32_t>  m_wrapY; // Times each ball has wrapped to the world's bottom, less to its top
+
+	// Cell grids, with the balls in each cell held in a doubly linked list
+	std::vector<Level>         m_levels;      // Ordered from finest to coarsest
+	std::vector<std::size_t>   m_levelOfType; // Level of each BallType
+	std::vector<std::int32_t>  m_cellHead;    // First ball in each cell of every level (-1 if empty)
+	std::vector<std::int32_t>  m_next;        // Next ball in the same cell (-1 if last)
+	std::vector<std::int32_t>  m_prev;        // Previous ball in the same cell (-1 if first)
+	std::vector<std::uint32_t> m_row;         // Cell row of each ball, on its level
+	std::vector<std::uint32_t> m_col;         // Cell column of each ball, on its level
+
+	std::vector<Event>         m_events;  // Pending event of each ball
+	std::vector<HeapEntry>     m_heap;    // Min-heap of the balls on the time of their events
+	std::vector<std::uint32_t> m_heapPos; // Index of each ball in m_heap
+
+	double      m_time;                    // Time the simulation has been advanced to
+	double      m_targetTime;              // Time solve() processes events up to
+	std::size_t m_numCollisions;
+	std::size_t m_numCellCrossings;
+
+	void solve() override;
+
+	void buildLevels();
+	const Level& levelOf(std::size_t i) const { return m_levels[m_levelOfType[m_particles.typeindex[i]]]; }
+
+	void advance(std::size_t i, double time);       // Move ball i forward to time
+	void predictEvents(std::size_t i, double time); // Predict events of ball i, which is at time
+	void predictCrossing(std::size_t i, double time);
+	void predictCollisions(std::size_t i, double time, const Level& level, int rowLow, int rowHigh, int colLow, int colHigh);
+	void predictCollision(std::size_t i, std::size_t j, double time, int shiftX, int shiftY);
+	CellRange cellsWithinReach(const Level& own, int row, int col, const Level& level) const; // Cells of level whose balls can reach own's cell (row, col)
+	void processCollision(std::size_t i);
+	void processCellCrossing(std::size_t i);
+
+	void insertIntoCell(std::size_t i);
+	void removeFromCell(std::size_t i);
+
+	void updateHeap(std::size_t i); // Restore the heap after ball i's event changed
+};
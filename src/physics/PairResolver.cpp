@@ -0,0 +1,123 @@
+#include "PairResolver.hpp"
+
+#include <algorithm>
+
+#include "ParticleKernels.hpp"
+
+std::size_t PairResolver::resolve(const std::vector<const std::vector<CollisionPair>*>& buffers, Particles& particles, ThreadPool& threadPool)
+{
+	const unsigned int numThreads = threadPool.size();
+	std::size_t numPairs = 0;
+
+	for (const std::vector<CollisionPair>* pairs : buffers)
+		numPairs += pairs->size();
+
+	m_numRounds = 0;
+
+	if (numPairs == 0)
+		return 0;
+
+	// Balls are only ever added, and every entry is back to 0 after each call
+	if (m_ballRound.size() < particles.size())
+		m_ballRound.resize(particles.size(), 0);
+
+	// Schedule pairs into rounds
+	m_pairRound.resize(numPairs);
+	std::uint32_t numRounds = 0;
+	std::size_t k = 0;
+
+	for (const std::vector<CollisionPair>* pairs : buffers)
+	{
+		for (const CollisionPair& pair : *pairs)
+		{
+			std::uint32_t round = std::max(m_ballRound[pair.i1], m_ballRound[pair.i2]);
+			m_ballRound[pair.i1] = round + 1;
+			m_ballRound[pair.i2] = round + 1;
+
+			m_pairRound[k++] = round;
+			numRounds = std::max(numRounds, round + 1);
+		}
+	}
+
+	// Counting sort of the pairs by round
+	m_roundStart.assign(numRounds + 1, 0);
+	for (std::uint32_t round : m_pairRound)
+		m_roundStart[round + 1]++;
+	for (std::size_t round = 0; round < numRounds; round++)
+		m_roundStart[round + 1] += m_roundStart[round];
+
+	m_roundFill.assign(m_roundStart.begin(), m_roundStart.end() - 1);
+
+	m_batchI1.resize(numPairs);
+	m_batchI2.resize(numPairs);
+	m_batchShiftX.resize(numPairs);
+	m_batchShiftY.resize(numPairs);
+
+	k = 0;
+
+	for (const std::vector<CollisionPair>* pairs : buffers)
+	{
+		for (const CollisionPair& pair : *pairs)
+		{
+			std::size_t slot = m_roundFill[m_pairRound[k++]]++;
+
+			m_batchI1[slot]     = pair.i1;
+			m_batchI2[slot]     = pair.i2;
+			m_batchShiftX[slot] = pair.shiftX;
+			m_batchShiftY[slot] = pair.shiftY;
+
+			m_ballRound[pair.i1] = 0;
+			m_ballRound[pair.i2] = 0;
+		}
+	}
+
+	// Resolve each round in turn
+	auto resolveRange = [this, &particles](std::size_t indLower, std::size_t indUpper)
+	{
+		return resolveCollisionBatch(
+			particles.x.data(), particles.y.data(), particles.vx.data(), particles.vy.data(),
+			particles.radius.data(), particles.invMass.data(),
+			m_batchI1.data() + indLower, m_batchI2.data() + indLower,
+			m_batchShiftX.data() + indLower, m_batchShiftY.data() + indLower,
+			indUpper - indLower
+		);
+	};
+
+	m_resolvedPairs.resize(numThreads);
+	std::size_t numResolved = 0;
+
+	for (std::size_t round = 0; round < numRounds; round++)
+	{
+		const std::size_t roundLower = m_roundStart[round];
+		const std::size_t roundUpper = m_roundStart[round + 1];
+		const std::size_t roundSize  = roundUpper - roundLower;
+
+		if (numThreads == 1 || roundSize < PARALLEL_ROUND_SIZE)
+		{
+			numResolved += resolveRange(roundLower, roundUpper);
+			continue;
+		}
+
+		threadPool.run(
+			[this, &resolveRange, numThreads, roundLower, roundUpper, roundSize](unsigned int i)
+			{
+				std::size_t indLower = std::min(roundUpper, roundLower + i * (roundSize / numThreads + 1));
+				std::size_t indUpper = std::min(roundUpper, roundLower + (i + 1) * (roundSize / numThreads + 1));
+
+				m_resolvedPairs[i] = resolveRange(indLower, indUpper);
+			}
+		);
+
+		for (std::size_t resolved : m_resolvedPairs)
+			numResolved += resolved;
+	}
+
+	m_numRounds = numRounds;
+	return numResolved;
+}
+
+std::size_t PairResolver::getBufferBytes() const
+{
+	return (m_batchI1.capacity() + m_batchI2.capacity()) * sizeof(std::uint32_t)
+	     + (m_batchShiftX.capacity() + m_batchShiftY.capacity()) * sizeof(float);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Particles.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * A pair of overlapping balls found by a solver, waiting to
+ * be resolved.
+ */
+
+struct CollisionPair
+{
+	std::uint32_t i1;
+	std::uint32_t i2;
+	float         shiftX; // Translation of i1 relative to i2
+	float         shiftY;
+};
+
+/**
+ * Resolves the overlapping pairs a solver's threads have
+ * collected in their own buffers, shared by the solvers that
+ * find pairs before resolving them (SpatialHashSolver and
+ * SweepAndPruneSolver).
+ *
+ * Each pair is scheduled in the round after the last one
+ * using either of its balls, so the pairs of a round are
+ * disjoint, and every ball meets its pairs in the order
+ * they were found (buffer by buffer), as if resolved one at
+ * a time. The pairs are counting-sorted by round, and rounds
+ * are then resolved one after another in vectorised batches
+ * (see resolveCollisionBatch()), rounds of at least
+ * PARALLEL_ROUND_SIZE pairs split across the threads of a
+ * ThreadPool. Pairs are re-tested when resolved, since
+ * earlier rounds may have dislodged their balls.
+ *
+ * The scheduling arrays are kept between calls to reuse their
+ * allocations.
+ */
+
+class PairResolver
+{
+public:
+	// Resolve the pairs of every buffer, returning the number still overlapping when resolved
+	std::size_t resolve(const std::vector<const std::vector<CollisionPair>*>& buffers, Particles& particles, ThreadPool& threadPool);
+
+	std::size_t getNumRounds()   const { return m_numRounds; } // Rounds taken by the last call
+	std::size_t getBufferBytes() const;                        // Memory allocated for the pairs ordered by round
+
+private:
+	std::vector<std::uint32_t> m_ballRound;     // First round each ball is free in while scheduling (0 otherwise)
+	std::vector<std::uint32_t> m_pairRound;
+	std::vector<std::size_t>   m_roundStart;    // Index of the first pair of each round (one extra for the end)
+	std::vector<std::size_t>   m_roundFill;
+	std::vector<std::size_t>   m_resolvedPairs; // Pairs resolved by each thread in the current round
+	std::size_t                m_numRounds = 0;
+
+	// Pairs ordered by round
+	std::vector<std::uint32_t> m_batchI1;
+	std::vector<std::uint32_t> m_batchI2;
+	std::vector<float>         m_batchShiftX;
+	std::vector<float>         m_batchShiftY;
+
+	static const std::size_t PARALLEL_ROUND_SIZE = 4096; // Rounds with fewer pairs are resolved on one thread
+};
@@ -0,0 +1,269 @@
+#include "ParticleKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void integratePositions(
+	float* x, float* y, const float* vx, const float* vy,
+	std::size_t indLower, std::size_t indUpper,
+	float dt, const World& world
+)
+/**
+ * Positions are wrapped without branches: the world width is
+ * added where a coordinate fell below the minimum boundary and
+ * subtracted where it reached the maximum boundary. They are
+ * then clamped into the world, which catches rounding at its
+ * edges, balls that moved over a world width in one step and
+ * non-finite positions (NaN goes to the minimum boundary), so
+ * no ball can ever be binned outside the grid.
+ */
+{
+	std::size_t i = indLower;
+
+	const float xLast = std::nextafter(world.xMax, world.xMin); // Largest coordinates within the world
+	const float yLast = std::nextafter(world.yMax, world.yMin);
+
+#if defined(__AVX2__)
+	const __m256 dt8     = _mm256_set1_ps(dt);
+	const __m256 xMin8   = _mm256_set1_ps(world.xMin);
+	const __m256 xMax8   = _mm256_set1_ps(world.xMax);
+	const __m256 xWidth8 = _mm256_set1_ps(world.xWidth);
+	const __m256 yMin8   = _mm256_set1_ps(world.yMin);
+	const __m256 yMax8   = _mm256_set1_ps(world.yMax);
+	const __m256 yWidth8 = _mm256_set1_ps(world.yWidth);
+	const __m256 xLast8  = _mm256_set1_ps(xLast);
+	const __m256 yLast8  = _mm256_set1_ps(yLast);
+
+	for (; i + 8 <= indUpper; i += 8)
+	{
+		__m256 px = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), dt8));
+		__m256 py = _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), dt8));
+
+		px = _mm256_add_ps(px, _mm256_and_ps(_mm256_cmp_ps(px, xMin8, _CMP_LT_OQ), xWidth8));
+		px = _mm256_sub_ps(px, _mm256_and_ps(_mm256_cmp_ps(px, xMax8, _CMP_GE_OQ), xWidth8));
+		py = _mm256_add_ps(py, _mm256_and_ps(_mm256_cmp_ps(py, yMin8, _CMP_LT_OQ), yWidth8));
+		py = _mm256_sub_ps(py, _mm256_and_ps(_mm256_cmp_ps(py, yMax8, _CMP_GE_OQ), yWidth8));
+
+		// max_ps returns its second operand when either is NaN
+		px = _mm256_min_ps(_mm256_max_ps(px, xMin8), xLast8);
+		py = _mm256_min_ps(_mm256_max_ps(py, yMin8), yLast8);
+
+		_mm256_storeu_ps(x + i, px);
+		_mm256_storeu_ps(y + i, py);
+	}
+#endif
+
+	for (; i < indUpper; i++)
+	{
+		float px = x[i] + vx[i] * dt;
+		float py = y[i] + vy[i] * dt;
+
+		px += (px <  world.xMin) ? world.xWidth : 0.0f;
+		px -= (px >= world.xMax) ? world.xWidth : 0.0f;
+		py += (py <  world.yMin) ? world.yWidth : 0.0f;
+		py -= (py >= world.yMax) ? world.yWidth : 0.0f;
+
+		x[i] = std::min(std::max(world.xMin, px), xLast); // std::max returns its first argument when either is NaN
+		y[i] = std::min(std::max(world.yMin, py), yLast);
+	}
+}
+
+std::uint32_t overlapBatch(
+	float x, float y, float r,
+	const float* xs, const float* ys, const float* rs,
+	std::size_t count
+)
+{
+	std::uint32_t mask = 0;
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256 x8 = _mm256_set1_ps(x);
+	const __m256 y8 = _mm256_set1_ps(y);
+	const __m256 r8 = _mm256_set1_ps(r);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), x8);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), y8);
+		__m256 rr = _mm256_add_ps(_mm256_loadu_ps(rs + i), r8);
+
+		__m256 distSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 hit    = _mm256_cmp_ps(distSq, _mm256_mul_ps(rr, rr), _CMP_LE_OQ);
+
+		mask |= static_cast<std::uint32_t>(_mm256_movemask_ps(hit)) << i;
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float dx = xs[i] - x;
+		float dy = ys[i] - y;
+		float rr = rs[i] + r;
+
+		mask |= static_cast<std::uint32_t>(dx * dx + dy * dy <= rr * rr) << i;
+	}
+
+	return mask;
+}
+
+std::size_t resolveCollisionBatch(
+	float* x, float* y, float* vx, float* vy,
+	const float* radius, const float* invMass,
+	const std::uint32_t* i1, const std::uint32_t* i2,
+	const float* shiftX, const float* shiftY,
+	std::size_t count
+)
+/**
+ * The same collision physics as Solver::resolveCollision(). 
+ * With AVX2, the data of eight pairs are gathered into vector
+ * registers, the impulses and dislodgements computed together,
+ * and the results scattered back for the pairs that overlap.
+ * The pairs being disjoint, the scattered writes never clash.
+ *
+ * Balls at (or so near as to square to zero) the same point
+ * have no direction between them, and dividing by their
+ * distance would give NaNs that spread to every ball they
+ * later touch. They are instead taken to lie a small way
+ * apart along x, so they are pushed apart like any others.
+ */
+{
+	std::size_t resolved = 0;
+	std::size_t k = 0;
+
+#if defined(__AVX2__)
+	const __m256 two8      = _mm256_set1_ps(2.0f);
+	const __m256 minDistSq = _mm256_set1_ps(std::numeric_limits<float>::min());
+	const __m256 apart8    = _mm256_set1_ps(COINCIDENT_SEPARATION);
+
+	alignas(32) float newX1[8], newY1[8], newVx1[8], newVy1[8];
+	alignas(32) float newX2[8], newY2[8], newVx2[8], newVy2[8];
+
+	for (; k + 8 <= count; k += 8)
+	{
+		const __m256i idx1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i1 + k));
+		const __m256i idx2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i2 + k));
+
+		__m256 x1  = _mm256_i32gather_ps(x, idx1, 4);
+		__m256 y1  = _mm256_i32gather_ps(y, idx1, 4);
+		__m256 x2  = _mm256_i32gather_ps(x, idx2, 4);
+		__m256 y2  = _mm256_i32gather_ps(y, idx2, 4);
+		__m256 r1  = _mm256_i32gather_ps(radius, idx1, 4);
+		__m256 r2  = _mm256_i32gather_ps(radius, idx2, 4);
+
+		__m256 dx = _mm256_sub_ps(_mm256_add_ps(x1, _mm256_loadu_ps(shiftX + k)), x2);
+		__m256 dy = _mm256_sub_ps(_mm256_add_ps(y1, _mm256_loadu_ps(shiftY + k)), y2);
+		__m256 rr = _mm256_add_ps(r1, r2);
+
+		__m256 distSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 hit    = _mm256_cmp_ps(distSq, _mm256_mul_ps(rr, rr), _CMP_LE_OQ);
+		int    mask   = _mm256_movemask_ps(hit);
+
+		if (mask == 0)
+			continue;
+
+		__m256 coincident = _mm256_cmp_ps(distSq, minDistSq, _CMP_LT_OQ);
+		dx     = _mm256_blendv_ps(dx, _mm256_mul_ps(apart8, rr), coincident);
+		dy     = _mm256_blendv_ps(dy, _mm256_setzero_ps(), coincident);
+		distSq = _mm256_blendv_ps(distSq, _mm256_mul_ps(dx, dx), coincident);
+
+		__m256 vx1 = _mm256_i32gather_ps(vx, idx1, 4);
+		__m256 vy1 = _mm256_i32gather_ps(vy, idx1, 4);
+		__m256 vx2 = _mm256_i32gather_ps(vx, idx2, 4);
+		__m256 vy2 = _mm256_i32gather_ps(vy, idx2, 4);
+		__m256 im1 = _mm256_i32gather_ps(invMass, idx1, 4);
+		__m256 im2 = _mm256_i32gather_ps(invMass, idx2, 4);
+
+		// Update velocities according to collision physics
+		__m256 dvx = _mm256_sub_ps(vx1, vx2);
+		__m256 dvy = _mm256_sub_ps(vy1, vy2);
+		__m256 dot = _mm256_add_ps(_mm256_mul_ps(dvx, dx), _mm256_mul_ps(dvy, dy));
+
+		__m256 coefficient1 = _mm256_mul_ps(
+			_mm256_div_ps(_mm256_mul_ps(two8, im1), _mm256_add_ps(im1, im2)),
+			_mm256_div_ps(dot, distSq)
+		);
+		coefficient1 = _mm256_sub_ps(_mm256_setzero_ps(), coefficient1);
+		__m256 coefficient2 = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(_mm256_div_ps(im2, im1), coefficient1));
+
+		_mm256_store_ps(newVx1, _mm256_add_ps(vx1, _mm256_mul_ps(dx, coefficient1)));
+		_mm256_store_ps(newVy1, _mm256_add_ps(vy1, _mm256_mul_ps(dy, coefficient1)));
+		_mm256_store_ps(newVx2, _mm256_add_ps(vx2, _mm256_mul_ps(dx, coefficient2)));
+		_mm256_store_ps(newVy2, _mm256_add_ps(vy2, _mm256_mul_ps(dy, coefficient2)));
+
+		// Dislodge balls to prevent sticking
+		__m256 dist  = _mm256_sqrt_ps(distSq);
+		__m256 factor1 = _mm256_sub_ps(_mm256_div_ps(r2, dist), _mm256_div_ps(r2, rr));
+		__m256 factor2 = _mm256_sub_ps(_mm256_div_ps(r1, dist), _mm256_div_ps(r1, rr));
+
+		_mm256_store_ps(newX1, _mm256_add_ps(x1, _mm256_mul_ps(dx, factor1)));
+		_mm256_store_ps(newY1, _mm256_add_ps(y1, _mm256_mul_ps(dy, factor1)));
+		_mm256_store_ps(newX2, _mm256_sub_ps(x2, _mm256_mul_ps(dx, factor2)));
+		_mm256_store_ps(newY2, _mm256_sub_ps(y2, _mm256_mul_ps(dy, factor2)));
+
+		for (int lane = 0; lane < 8; lane++)
+		{
+			if ((mask & (1 << lane)) == 0)
+				continue;
+
+			std::uint32_t a = i1[k + lane];
+			std::uint32_t b = i2[k + lane];
+
+			x[a] = newX1[lane];  y[a] = newY1[lane];  vx[a] = newVx1[lane];  vy[a] = newVy1[lane];
+			x[b] = newX2[lane];  y[b] = newY2[lane];  vx[b] = newVx2[lane];  vy[b] = newVy2[lane];
+
+			resolved++;
+		}
+	}
+#endif
+
+	for (; k < count; k++)
+	{
+		const std::uint32_t a = i1[k];
+		const std::uint32_t b = i2[k];
+
+		float dx = x[a] + shiftX[k] - x[b];
+		float dy = y[a] + shiftY[k] - y[b];
+		float rr = radius[a] + radius[b];
+		float distSq = dx * dx + dy * dy;
+
+		if (distSq > rr * rr)
+			continue;
+
+		if (distSq < std::numeric_limits<float>::min())
+		{
+			dx     = COINCIDENT_SEPARATION * rr;
+			dy     = 0.0f;
+			distSq = dx * dx;
+		}
+
+		// Update velocities according to collision physics
+		float dot = (vx[a] - vx[b]) * dx + (vy[a] - vy[b]) * dy;
+		float coefficient1 = -((2.0f * invMass[a]) / (invMass[a] + invMass[b])) * (dot / distSq);
+		float coefficient2 = -(invMass[b] / invMass[a]) * coefficient1;
+
+		vx[a] += dx * coefficient1;
+		vy[a] += dy * coefficient1;
+		vx[b] += dx * coefficient2;
+		vy[b] += dy * coefficient2;
+
+		// Dislodge balls to prevent sticking
+		float dist = std::sqrt(distSq);
+		float factor1 = radius[b] / dist - radius[b] / rr;
+		float factor2 = radius[a] / dist - radius[a] / rr;
+
+		x[a] += dx * factor1;
+		y[a] += dy * factor1;
+		x[b] -= dx * factor2;
+		y[b] -= dy * factor2;
+
+		resolved++;
+	}
+
+	return resolved;
+}
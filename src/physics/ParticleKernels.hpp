@@ -0,0 +1,52 @@
+#pragma once
+
+/**
+ * Vectorised kernels operating on Particles arrays.
+ *
+ * When compiled with AVX2 enabled (see the CMake option
+ * TORUSPARTICLES_ENABLE_AVX2), the kernels process eight
+ * particles at a time using AVX2 intrinsics. Otherwise a
+ * branchless scalar fallback is used, which the compiler is
+ * free to auto-vectorise for whatever instruction set it
+ * targets.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "World.hpp"
+
+// Separation assumed between two balls at the same point, as a
+// fraction of their radii's sum, so they can be pushed apart along x
+const float COINCIDENT_SEPARATION = 1.0e-3f;
+
+// Advance positions in [indLower, indUpper) by velocity * dt,
+// wrapping them back into the world boundaries (and clamping any
+// still outside, e.g. NaNs, so every position lies in the world)
+void integratePositions(
+	float* x, float* y, const float* vx, const float* vy,
+	std::size_t indLower, std::size_t indUpper,
+	float dt, const World& world
+);
+
+// Test a particle at (x, y) with radius r against count candidates
+// stored in contiguous arrays, setting bit i of the returned mask
+// when candidate i overlaps. At most 32 candidates may be tested.
+std::uint32_t overlapBatch(
+	float x, float y, float r,
+	const float* xs, const float* ys, const float* rs,
+	std::size_t count
+);
+
+// Resolve collisions between count pairs of particles, where pair k
+// joins particles i1[k] and i2[k], with i1[k] translated by 
+// (shiftX[k], shiftY[k]). No particle may appear in more than one
+// pair. Pairs that no longer overlap are skipped. Returns the number
+// of pairs resolved.
+std::size_t resolveCollisionBatch(
+	float* x, float* y, float* vx, float* vy,
+	const float* radius, const float* invMass,
+	const std::uint32_t* i1, const std::uint32_t* i2,
+	const float* shiftX, const float* shiftY,
+	std::size_t count
+);
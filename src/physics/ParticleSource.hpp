@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include "BallType.hpp"
+#include "Particles.hpp"
+#include "World.hpp"
+
+/**
+ * Anything that provides particles to draw: a live Solver, or
+ * a TrajectoryPlayer replaying a recorded run. Particles are
+ * grouped by BallType, with each BallType's count giving the
+ * size of its group.
+ *
+ * The Particles object stays in place for the lifetime of the
+ * source, so a Renderer can hold a reference to it. Its arrays
+ * do not: a solver may replace their buffers (e.g. when it
+ * reorders or places its particles, by move-assigning new
+ * arrays), so consumers must read data() afresh each time
+ * rather than keep the pointers.
+ */
+
+class ParticleSource
+{
+public:
+	virtual ~ParticleSource() = default;
+
+	virtual const std::vector<BallType>& getBallTypes() const = 0;
+	virtual const Particles&             getParticles() const = 0;
+	virtual const World&                 getWorld()     const = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+/**
+ * Structure-of-arrays storage for particle data.
+ *
+ * Each quantity is stored in its own contiguous array, so
+ * that loops over all particles stream only the data they
+ * need and can be vectorised. The radius and inverse mass
+ * of each particle are copied from its BallType, saving an
+ * indirection through m_ballTypes in the collision code.
+ *
+ * Particles are stored contiguously by BallType, in the
+ * same order as Solver::m_ballTypes. Within a BallType, 
+ * a solver may reorder particles to improve locality, so
+ * each particle also carries a stable ID, its index at
+ * construction.
+ * 
+ * The arrays are BigArrays, so resize() leaves new elements
+ * uninitialised, to be written by whichever thread should
+ * first touch them.
+ */
+
+#include <cstdint>
+
+#include "Ball.hpp"
+#include "BigArray.hpp"
+
+struct Particles
+{
+	BigArray<float>         x;
+	BigArray<float>         y;
+	BigArray<float>         vx;
+	BigArray<float>         vy;
+	BigArray<float>         radius;
+	BigArray<float>         invMass;
+	BigArray<std::uint32_t> typeindex; // Index of the particle's type in Solver::m_ballTypes
+	BigArray<std::uint32_t> id;        // Stable ID of the particle
+
+	std::size_t size() const { return x.size(); }
+
+	void resize(std::size_t n)
+	{
+		x.resize(n);
+		y.resize(n);
+		vx.resize(n);
+		vy.resize(n);
+		radius.resize(n);
+		invMass.resize(n);
+		typeindex.resize(n);
+		id.resize(n);
+	}
+
+	Ball getBall(std::size_t i) const
+	{
+		Ball ball;
+		ball.position  = { x[i], y[i] };
+		ball.velocity  = { vx[i], vy[i] };
+		ball.typeindex = typeindex[i];
+		return ball;
+	}
+};
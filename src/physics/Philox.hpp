@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/**
+ * The Philox4x32-10 counter-based random number generator
+ * (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+ * 3", SC 2011).
+ *
+ * Rather than stepping a state, Philox scrambles a 128-bit
+ * counter under a 64-bit key, so the numbers for any counter
+ * (e.g. a particle's index) can be generated directly, by any
+ * thread, in any order, and are the same however the work is
+ * split. Each call gives four independent 32-bit values.
+ */
+
+inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+{
+	const std::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57; // Multipliers
+	const std::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85; // Key increments (golden ratio, sqrt(3) - 1)
+
+	for (int round = 0; round < 10; round++)
+	{
+		const std::uint64_t product0 = static_cast<std::uint64_t>(M0) * counter[0];
+		const std::uint64_t product1 = static_cast<std::uint64_t>(M1) * counter[2];
+
+		counter = {
+			static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+			static_cast<std::uint32_t>(product1),
+			static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+			static_cast<std::uint32_t>(product0)
+		};
+
+		key[0] += W0;
+		key[1] += W1;
+	}
+
+	return counter;
+}
+
+// Uniform in [0, 1), from all 32 bits of a value (a double holds them exactly)
+inline double uniformDouble(std::uint32_t value)
+{
+	return static_cast<double>(value) * (1.0 / 4294967296.0);
+}
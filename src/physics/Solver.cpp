@@ -1,118 +1,292 @@
 #include "Solver.hpp"
 
-#include <random>
+#include <array>
+#include <algorithm>
 #include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "ParticleKernels.hpp"
+#include "Profiler.hpp"
+#include "Philox.hpp"
+#include "ThreadPool.hpp"
 
 Solver::Solver(Preset preset)
-	: m_ballTypes(preset.ballTypes), 
-	  m_world(preset.worldAspectRatio)
+	: Solver(preset, World(preset.worldAspectRatio), randomParticles(preset.ballTypes, World(preset.worldAspectRatio), preset.seed, preset.numThreads))
+{
+}
+
+Solver::Solver(Preset preset, const World& world, Particles particles)
+	: m_ballTypes(preset.ballTypes),
+	  m_particles(std::move(particles)),
+	  m_statsInterval(preset.statsInterval),
+	  m_world(world)
 {
-	// Initialise random number generators for ball positions
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_real_distribution<float> x_posDistribution(m_world.xMin, m_world.xMax);
-	std::uniform_real_distribution<float> y_posDistribution(m_world.yMin, m_world.yMax);
-
-	// Randomly populate position and velocity data in m_balls
-	for (std::size_t i = 0; i < m_ballTypes.size(); i++)
+	// BallType counts describe the particles actually held
+	for (BallType& ballType : m_ballTypes)
+		ballType.count = 0;
+
+	std::uint32_t maxID = 0;
+
+	for (std::size_t i = 0; i < m_particles.size(); i++)
 	{
-		BallType& balltype = m_ballTypes[i];
+		m_ballTypes[m_particles.typeindex[i]].count++;
+		maxID = std::max(maxID, m_particles.id[i]);
+	}
+
+	m_slotOfId.resize(m_particles.size() > 0 ? maxID + 1 : 0);
+	for (std::size_t i = 0; i < m_particles.size(); i++)
+		m_slotOfId[m_particles.id[i]] = static_cast<std::uint32_t>(i);
+
+	// Bring the positions given (e.g. from a checkpoint) into the world, as every step does
+	integratePositions(
+		m_particles.x.data(), m_particles.y.data(),
+		m_particles.vx.data(), m_particles.vy.data(),
+		0, m_particles.size(),
+		0.0f, m_world
+	);
+}
+
+Particles Solver::randomParticles(const std::vector<BallType>& ballTypes, const World& world,
+                                  std::uint64_t seed, unsigned int numThreads)
+/**
+ * Each particle's random numbers come from Philox, keyed by
+ * the seed with the particle's index as the counter, so each
+ * thread fills its own share of the arrays (touching it first)
+ * with no shared generator. One call gives a particle its two
+ * coordinates, and two normally distributed velocity
+ * components by the Box-Muller transform.
+ *
+ * The last particle of each BallType then takes up the
+ * difference between the BallType's total momentum and the
+ * velocities drawn. Those are summed in fixed blocks, and the
+ * blocks in order, so the sums do not depend on how the
+ * particles were split between threads either.
+ */
+{
+	const float         VELOCITY_SPREAD = 0.12f;
+	const std::size_t   SUM_BLOCK       = std::size_t(1) << 16; // Particles summed per block
+	const double        TWO_PI          = 6.283185307179586;
+	const std::array<std::uint32_t, 2> key = { static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) };
+
+	std::vector<std::size_t> typeStart(ballTypes.size() + 1, 0); // Index of each BallType's first particle
+	for (std::size_t i = 0; i < ballTypes.size(); i++)
+		typeStart[i + 1] = typeStart[i] + ballTypes[i].count;
+
+	const std::size_t numBalls = typeStart.back();
 
-		float x_meanVelocity = balltype.totalMomentum.x / (balltype.mass * (float)balltype.count);
-		float y_meanVelocity = balltype.totalMomentum.y / (balltype.mass * (float)balltype.count);
+	Particles particles;
+	particles.resize(numBalls);
 
-		std::normal_distribution<float> x_velDistribution(x_meanVelocity, 0.12f);
-		std::normal_distribution<float> y_velDistribution(y_meanVelocity, 0.12f);
+	// Blocks of each BallType to sum velocities over
+	struct SumBlock
+	{
+		std::size_t type, begin, end;
+		double      vx = 0.0, vy = 0.0;
+	};
+
+	std::vector<SumBlock> blocks;
+	for (std::size_t i = 0; i < ballTypes.size(); i++)
+		for (std::size_t begin = typeStart[i]; begin < typeStart[i + 1]; begin += SUM_BLOCK)
+			blocks.push_back({ i, begin, std::min(begin + SUM_BLOCK, typeStart[i + 1]) });
 
-		Vec2<float> runningVelocity(0.0f, 0.0f);
+	// Small systems aren't worth starting threads for
+	ThreadPool threadPool(numBalls >= SUM_BLOCK ? numThreads : 1);
+	const unsigned int threads = threadPool.size();
 
-		for (std::size_t j = 0; j < balltype.count; j++)
+	threadPool.run(
+		[&](unsigned int thread)
 		{
-			float xVel = x_velDistribution(gen);
-			float yVel = y_velDistribution(gen);
-			Vec2<float> vel = { xVel, yVel };
+			const std::size_t begin = numBalls * thread / threads;
+			const std::size_t end   = numBalls * (thread + 1) / threads;
+
+			std::size_t type = std::upper_bound(typeStart.begin(), typeStart.end(), begin) - typeStart.begin() - 1;
+
+			for (std::size_t index = begin; index < end; index++)
+			{
+				while (index >= typeStart[type + 1])
+					type++;
+
+				const BallType& balltype = ballTypes[type];
+
+				const float x_meanVelocity = balltype.totalMomentum.x / (balltype.mass * (float)balltype.count);
+				const float y_meanVelocity = balltype.totalMomentum.y / (balltype.mass * (float)balltype.count);
+
+				const std::array<std::uint32_t, 4> random = philox4x32(
+					{ static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(static_cast<std::uint64_t>(index) >> 32), 0, 0 }, key);
 
-			float xPos = x_posDistribution(gen);
-			float yPos = y_posDistribution(gen);
-			Vec2<float> pos = { xPos, yPos };
+				// Positions, drawn in double so that they are only rounded once, to the nearest float,
+				// and kept below the upper bounds despite that rounding
+				float xPos = std::min(static_cast<float>(world.xMin + uniformDouble(random[0]) * world.xWidth), std::nextafter(world.xMax, world.xMin));
+				float yPos = std::min(static_cast<float>(world.yMin + uniformDouble(random[1]) * world.yWidth), std::nextafter(world.yMax, world.yMin));
 
-			runningVelocity.x += xVel;
-			runningVelocity.y += yVel;
+				// Velocities, taking the logarithm of 1 - u, which unlike u is never 0
+				double radius = std::sqrt(-2.0 * std::log(1.0 - uniformDouble(random[2])));
+				double angle  = TWO_PI * uniformDouble(random[3]);
 
-			Ball ball;
-			ball.position = pos;
-			ball.velocity = vel;
-			ball.typeindex = i;
+				particles.x[index]         = xPos;
+				particles.y[index]         = yPos;
+				particles.vx[index]        = x_meanVelocity + VELOCITY_SPREAD * static_cast<float>(radius * std::cos(angle));
+				particles.vy[index]        = y_meanVelocity + VELOCITY_SPREAD * static_cast<float>(radius * std::sin(angle));
+				particles.radius[index]    = balltype.radius;
+				particles.invMass[index]   = 1.0f / balltype.mass;
+				particles.typeindex[index] = static_cast<std::uint32_t>(type);
+				particles.id[index]        = static_cast<std::uint32_t>(index);
+			}
+		}
+	);
 
-			m_balls.push_back(ball);
+	threadPool.run(
+		[&](unsigned int thread)
+		{
+			for (std::size_t b = thread; b < blocks.size(); b += threads)
+			{
+				for (std::size_t index = blocks[b].begin; index < blocks[b].end; index++)
+				{
+					blocks[b].vx += particles.vx[index];
+					blocks[b].vy += particles.vy[index];
+				}
+			}
 		}
+	);
+
+	// Adjust final velocity of each BallType so that the sum of their velocities is totalMomentum / mass
+	std::vector<Vec2<double>> runningVelocity(ballTypes.size(), Vec2<double>(0.0, 0.0));
+
+	for (const SumBlock& block : blocks)
+	{
+		runningVelocity[block.type].x += block.vx;
+		runningVelocity[block.type].y += block.vy;
+	}
+
+	for (std::size_t i = 0; i < ballTypes.size(); i++)
+	{
+		const BallType& balltype = ballTypes[i];
+
+		if (balltype.count == 0)
+			continue;
 
-		// Adjust final velocity so that sum of velocities of balls of type bt is totalVelocity
-		m_balls.back().velocity += balltype.totalMomentum / balltype.mass - runningVelocity;
+		std::size_t last = typeStart[i + 1] - 1;
 
+		particles.vx[last] += static_cast<float>(balltype.totalMomentum.x / balltype.mass - runningVelocity[i].x);
+		particles.vy[last] += static_cast<float>(balltype.totalMomentum.y / balltype.mass - runningVelocity[i].y);
 	}
+
+	return particles;
+}
+
+std::vector<Ball> Solver::getBalls() const
+{
+	std::vector<Ball> balls(m_particles.size());
+
+	for (std::size_t i = 0; i < balls.size(); i++)
+		balls[i] = m_particles.getBall(i);
+
+	return balls;
 }
 
-bool Solver::overlap(const Ball& ball1, const Ball& ball2)
+bool Solver::overlap(std::size_t i1, std::size_t i2, Vec2<float> shift)
 {
-	const float& radius1 = m_ballTypes[ball1.typeindex].radius;
-	const float& radius2 = m_ballTypes[ball2.typeindex].radius;
+	const Particles& p = m_particles;
+
+	float dx = p.x[i1] + shift.x - p.x[i2];
+	float dy = p.y[i1] + shift.y - p.y[i2];
+	float radiusSum = p.radius[i1] + p.radius[i2];
 
-	return distSquared(ball1.position, ball2.position) <= (radius1 + radius2) * (radius1 + radius2);
+	return dx * dx + dy * dy <= radiusSum * radiusSum;
 }
 
 
-void Solver::resolveCollision(Ball& ball1, Ball& ball2)
+void Solver::resolveCollision(std::size_t i1, std::size_t i2, Vec2<float> shift)
 {
+	Particles& p = m_particles;
 
-	const float& mass1 = m_ballTypes[ball1.typeindex].mass;
-	const float& mass2 = m_ballTypes[ball2.typeindex].mass;
+	const float& invMass1 = p.invMass[i1];
+	const float& invMass2 = p.invMass[i2];
 
-	const float& radius1 = m_ballTypes[ball1.typeindex].radius;
-	const float& radius2 = m_ballTypes[ball2.typeindex].radius;
+	const float& radius1 = p.radius[i1];
+	const float& radius2 = p.radius[i2];
 
 	// Update velocities according to collision physics
-	Vec2<float> deltaPos = ball1.position - ball2.position;
-	Vec2<float> deltaVel = ball1.velocity - ball2.velocity;
+	Vec2<float> deltaPos = { p.x[i1] + shift.x - p.x[i2], p.y[i1] + shift.y - p.y[i2] };
+
+	// Balls at the same point have no direction between them, so are separated along x
+	if (deltaPos.dot(deltaPos) < std::numeric_limits<float>::min())
+		deltaPos = { COINCIDENT_SEPARATION * (radius1 + radius2), 0.0f };
+
+	Vec2<float> deltaVel = { p.vx[i1] - p.vx[i2], p.vy[i1] - p.vy[i2] };
 
-	float collisionCoefficient1 = -((2.0f * mass2) / (mass1 + mass2)) * (deltaVel.dot(deltaPos) / deltaPos.dot(deltaPos));
-	float collisionCoefficient2 = -(mass1 / mass2) * collisionCoefficient1;
+	// Equivalent to 2*m2/(m1+m2) and 2*m1/(m1+m2) respectively
+	float collisionCoefficient1 = -((2.0f * invMass1) / (invMass1 + invMass2)) * (deltaVel.dot(deltaPos) / deltaPos.dot(deltaPos));
+	float collisionCoefficient2 = -(invMass2 / invMass1) * collisionCoefficient1;
 
-	ball1.velocity += deltaPos * collisionCoefficient1;
-	ball2.velocity += deltaPos * collisionCoefficient2;
+	p.vx[i1] += deltaPos.x * collisionCoefficient1;
+	p.vy[i1] += deltaPos.y * collisionCoefficient1;
+	p.vx[i2] += deltaPos.x * collisionCoefficient2;
+	p.vy[i2] += deltaPos.y * collisionCoefficient2;
 
 	// Dislodge balls to prevent sticking
 	float dislodgeFactor1 = radius2 / std::sqrt(deltaPos.dot(deltaPos)) - radius2 / (radius1 + radius2);
 	float dislodgeFactor2 = radius1 / std::sqrt(deltaPos.dot(deltaPos)) - radius1 / (radius1 + radius2);
-	ball1.position += deltaPos * dislodgeFactor1;
-	ball2.position -= deltaPos * dislodgeFactor2;
+	p.x[i1] += deltaPos.x * dislodgeFactor1;
+	p.y[i1] += deltaPos.y * dislodgeFactor1;
+	p.x[i2] -= deltaPos.x * dislodgeFactor2;
+	p.y[i2] -= deltaPos.y * dislodgeFactor2;
 }
 
 void Solver::update(float dt)
 {
 	// Check for collisions and update velocities if a collision occurs
-	solve(); 
+	{
+		PROFILE_SCOPE("solve");
+		solve();
+	}
+
+	{
+		PROFILE_SCOPE("updatePositions");
+		updatePositions(dt);
+	}
 
-	updatePositions(dt);
+	countStep();
+}
+
+void Solver::countStep()
+{
+	m_stats.numSteps++;
+
+	if (m_statsInterval > 0 && m_stats.numSteps % m_statsInterval == 0)
+		std::cout << "Step " << m_stats.numSteps << ": " << m_stats.describe() << std::endl;
 }
 
 void Solver::updatePositions(float dt)
 {
-	for (Ball& ball : m_balls)
-	{
-		Vec2<float>& position = ball.position;
+	integratePositions(
+		m_particles.x.data(), m_particles.y.data(),
+		m_particles.vx.data(), m_particles.vy.data(),
+		0, m_particles.size(),
+		dt, m_world
+	);
+}
+
+std::string SolverStats::describe() const
+{
+	std::string description = std::to_string(pairTests) + " pair tests, "
+	                        + std::to_string(overlapsFound) + " overlaps, "
+	                        + std::to_string(collisionsResolved) + " resolved, "
+	                        + std::to_string(wrappedPairs) + " across edges";
 
-		position += ball.velocity * dt;
+	if (occupancy.empty())
+		return description;
 
-		// Normalise positions to lie within world boundaries
-		if (position.x < m_world.xMin)
-			position.x += m_world.xWidth;
-		else if (position.x >= m_world.xMax)
-			position.x -= m_world.xWidth;
+	description += ", at most " + std::to_string(maxCellBalls) + " balls/cell, cells by balls held:";
 
-		if (position.y < m_world.yMin)
-			position.y += m_world.yWidth;
-		else if (position.y >= m_world.yMax)
-			position.y -= m_world.yWidth;
+	for (std::size_t balls = 0; balls < occupancy.size(); balls++)
+	{
+		if (occupancy[balls] == 0)
+			continue;
+
+		description += " " + std::to_string(balls) + (balls + 1 == occupancy.size() ? "+" : "") + ":" + std::to_string(occupancy[balls]);
 	}
-}
\ No newline at end of file
+
+	return description;
+}
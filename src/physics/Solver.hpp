@@ -5,7 +5,10 @@
 #include "Preset.hpp"
 #include "Ball.hpp"
 #include "BallType.hpp"
+#include "Particles.hpp"
 #include "World.hpp"
+#include "SolverStats.hpp"
+#include "ParticleSource.hpp"
 
 /**
  * An asbstract Solver class for maintaining and updating
@@ -18,31 +21,61 @@
  *     BruteForceMultithreadSolver (REMOVED)
  *     SweepAndPrune1DSolver (REMOVED)
  *     SpatialHashSolver
+ *     EventDrivenSolver
+ *     SweepAndPruneSolver
+ * 
+ * Use createSolver() to construct the solver named in a
+ * Preset.
+ * 
+ * Each step's work is counted in a SolverStats, available
+ * from getStats(), and logged every statsInterval steps when
+ * the preset sets one.
  */
 
-class Solver
+class Solver : public ParticleSource
 {
 public:
+
 	virtual void update(float dt); // Perform a full simulation cycle: check particle collisions, 
 	                               // update velocities of colliding particles, then update
 	                               // positions of each particle.
 
-	const std::vector<BallType>& getBallTypes() const { return m_ballTypes; }
-	const std::vector<Ball>&     getBalls()     const { return m_balls; }
-	const World&                 getWorld()     const { return m_world; }
+	const std::vector<BallType>& getBallTypes() const override { return m_ballTypes; }
+	const Particles&             getParticles() const override { return m_particles; }
+	std::vector<Ball>            getBalls()     const; // Copy of particle data as Ball structs
+	const World&                 getWorld()     const override { return m_world; }
+	std::size_t                  getSlot(std::size_t id) const { return m_slotOfId[id]; } // Index in getParticles() of the particle with a given ID
+	const SolverStats&           getStats()     const { return m_stats; } // Work done in the last step
+
+	// Random positions within world, with normally distributed velocities summing to each
+	// BallType's total momentum, generated on numThreads threads (0 uses one per hardware thread).
+	// The particles depend only on the seed, and are identical for any number of threads
+	static Particles randomParticles(const std::vector<BallType>& ballTypes, const World& world,
+	                                 std::uint64_t seed, unsigned int numThreads);
 
 protected:
 
 	Solver(Preset preset);    
+	Solver(Preset preset, const World& world, Particles particles); // Start from given particles, grouped by BallType, in a given world
 
 	std::vector<BallType> m_ballTypes;
-	std::vector<Ball>     m_balls;
+	Particles             m_particles;
 
 	virtual void solve() = 0;                     // Check collisions and update velocities
 
-	bool overlap(const Ball& ball1, const Ball& ball2); // Test whether balls b1 and b2 overlap
-	void resolveCollision(Ball& ball1, Ball& ball2);    // Resolve collision between b1 and b2
-	void updatePositions(float dt);               // Update positions of particles
+	// Collision methods for particles i1 and i2, where i1 is translated 
+	// by shift relative to i2 (e.g. to compare across world boundaries)
+	bool overlap(std::size_t i1, std::size_t i2, Vec2<float> shift = {});          // Test whether particles overlap
+	void resolveCollision(std::size_t i1, std::size_t i2, Vec2<float> shift = {}); // Resolve collision between particles
+
+	virtual void updatePositions(float dt);       // Update positions of particles
+
+	void countStep();                             // Count a finished step, logging m_stats if due
+
+	std::vector<std::uint32_t> m_slotOfId;        // Current slot of each particle ID
+
+	SolverStats m_stats;                          // Counted by solve(), apart from numSteps
+	std::size_t m_statsInterval;                  // Steps between logging m_stats (0 never logs)
 
 	World m_world;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+/**
+ * Counters describing the work done by a Solver in its last
+ * step, for sizing grids and spotting clustering. Threads
+ * count their own share while working, and the counts are
+ * summed once per step. Solvers that work in separate phases
+ * also time each phase, for benchmarking them apart.
+ *
+ * Solvers fill in what applies to them: the occupancy figures
+ * are only kept by solvers with a grid (SpatialHashSolver and
+ * DomainSolver), and the event-driven solver only counts the
+ * collisions it resolves (and how many were across the edges
+ * of the world). Cells hold any number of balls (see
+ * CellGrid), so none are ever dropped, and maxCellBalls shows
+ * how crowded the fullest cell became instead.
+ */
+
+struct SolverStats
+{
+	static const std::size_t OCCUPANCY_BINS = 17; // Cells holding 0 to 15 balls, then 16 or more
+
+	std::size_t numSteps           = 0; // Steps taken so far
+	std::size_t pairTests          = 0; // Pairs of balls tested for overlap
+	std::size_t overlapsFound      = 0; // Overlapping pairs found
+	std::size_t collisionsResolved = 0; // Pairs still overlapping when resolved (or collisions, when event-driven)
+	std::size_t wrappedPairs       = 0; // Overlapping pairs found across the edges of the world
+
+	// Occupancy of the cells, as of the last time the grid was checked
+	// (every step, unless neighbour lists are in use)
+	std::vector<std::size_t> occupancy;    // Number of cells by number of balls held (see OCCUPANCY_BINS), summed over levels
+	std::size_t              maxCellBalls = 0;
+
+	// Time spent in each phase of the step, by SpatialHashSolver (all zero
+	// otherwise, and only integrateSeconds while neighbour lists are in use)
+	double populateSeconds  = 0.0; // Updating the grid
+	double checkSeconds     = 0.0; // Finding overlapping pairs
+	double resolveSeconds   = 0.0; // Resolving the pairs
+	double integrateSeconds = 0.0; // Updating positions, and binning balls for the next step
+
+	std::string describe() const; // One line summary
+};
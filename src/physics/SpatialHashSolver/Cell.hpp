@@ -1,31 +1,99 @@
 #pragma once
 
-#include <array>
+#include <vector>
+#include <cstdint>
 
-enum Offset {
-	NONE, LEFT, RIGHT, DOWN, DOWN_LEFT, DOWN_RIGHT, UP, UP_LEFT, UP_RIGHT
-};
+#include "BigArray.hpp"
 
 struct BallInfo
 {
-	std::size_t ballID;
-	Offset offset;      // Offset from the balls original position that places it in a cell
+	std::uint32_t ballID;
+};
+
+/**
+ * Compressed storage for the contents of every cell in the
+ * grid. The entries of cell c are stored contiguously in
+ * entries[cellStart[c]] to entries[cellEnd[c] - 1], so cells
+ * hold any number of balls with no fixed per-cell capacity.
+ * Cells may be followed by spare room, up to entry
+ * cellLimit[c] - 1, so that balls can be moved between cells
+ * without rebuilding the grid. A cell that runs out of room
+ * is moved to the end of the entries with more room, leaving
+ * its old place unused.
+ *
+ * Cells are stored level by level, and within a level either
+ * in row-major order or, when cellIndex is filled, in the
+ * order given by cellIndex.
+ * 
+ * The arrays indexed by cell, and the entries, are BigArrays
+ * (see SpatialHashSolver::populateCells() for which thread
+ * first writes each part).
+ */
+
+struct CellGrid
+{
+	BigArray<std::uint32_t>    cellStart; // Offset of each cell's first entry (one extra for the end of the storage)
+	BigArray<std::uint32_t>    cellEnd;   // Offset past each cell's last entry
+	BigArray<std::uint32_t>    cellLimit; // Offset past each cell's spare room
+	BigArray<BallInfo>         entries;   // Cell contents, ordered by cell
+	std::vector<std::uint32_t> cellIndex; // Storage index of each cell, by row-major index (empty for row-major storage)
+
+	std::size_t numBalls(std::size_t cell) const { return cellEnd[cell] - cellStart[cell]; }
+};
+
+/**
+ * Geometry of one level of a multi-level grid. Each level
+ * covers the whole world, with cells sized to the largest
+ * ball placed on it. The cells of every level are stored 
+ * one level after another in a single CellGrid.
+ */
+
+struct GridLevel
+{
+	std::size_t numRows;
+	std::size_t numCols;
+	float       rowsPerUnit;   // numRows / world height
+	float       colsPerUnit;   // numCols / world width
+	std::size_t cellOffset;    // Index of the level's first cell in the CellGrid
+	std::size_t numBalls;      // Number of balls placed on the level
+	float       maxRadius;     // Radius of the largest ball placed on the level (plus any neighbour list margin)
+	float       baseCellSize;  // Cell size at the default resolution
+
+	std::size_t numBands;      // Bands of rows the checks within the level are split into
 };
 
-struct Cell
+/**
+ * A ball that has moved into another cell since the grid
+ * was last updated.
+ */
+
+struct CellMove
 {
-	std::array<BallInfo, 20> ballList; // Assume no more than twenty balls per cell
-	std::size_t numBalls;              // Number of balls contained in the cell
+	std::uint32_t ballID;
+	std::uint32_t cell;    // Storage index of the new cell
+	std::uint32_t oldCell; // Storage index of the cell the ball was filed in
+};
 
-	void addBall(BallInfo info)
-	{
-		if (numBalls < ballList.size())
-			ballList[numBalls++] = info;
-	}
+/**
+ * A pair of balls that are near enough to collide before
+ * the neighbour lists are next rebuilt.
+ */
 
-	void clear()
-	{
-		numBalls = 0;
-	}
+struct NeighbourPair
+{
+	std::uint32_t i1;
+	std::uint32_t i2;
+};
+
+/**
+ * A pair of grid levels checked against each other. Each
+ * ball on fromLevel looks up the cells of toLevel that its
+ * bounding box touches.
+ */
 
-};
\ No newline at end of file
+struct LevelPair
+{
+	std::size_t fromLevel;
+	std::size_t toLevel;
+	std::size_t numBands;      // Bands of rows of fromLevel the checks are split into
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+/**
+ * Statistics describing the resolution of a SpatialHashSolver's
+ * grid and how hard it is working. Per-step figures are averaged
+ * over the steps of the last grid evaluation, or over the steps
+ * so far if the grid has not been evaluated at this resolution.
+ */
+
+struct GridLevelStats
+{
+	std::size_t numRows;
+	std::size_t numCols;
+	float       cellWidth;
+	float       cellHeight;
+	std::size_t numBalls;
+	double      meanEntries;   // Cell entries added per step
+	double      meanOccupancy; // Entries per cell
+	double      meanPairTests; // Pairs of balls tested per step within the level
+};
+
+struct GridStats
+{
+	float                       cellScale;           // Cell size relative to the default resolution
+	std::vector<GridLevelStats> levels;              // Ordered from finest to coarsest
+	double                      meanCrossPairTests;  // Pairs of balls tested per step between levels
+	double                      meanPopulateSeconds; // Time per step spent populating the grid
+	double                      meanCheckSeconds;    // Time per step spent checking collisions
+	std::size_t                 numSteps;            // Number of steps the means are taken over
+	std::size_t                 numRegrids;          // Number of times the resolution has changed
+	std::string                 regridReason;        // Why the current resolution was chosen
+
+	// Grid maintenance, averaged over every step so far
+	double                      meanCellCrossings;   // Balls moved into another cell per step (incremental grid only)
+	std::size_t                 numFullRebuilds;     // Number of times the whole grid has been rebuilt
+
+	// Collision resolution, averaged over every step so far
+	double                      meanDetectedPairs;   // Overlapping pairs found per step
+	double                      meanResolvedPairs;   // Pairs still overlapping when resolved per step
+	double                      meanResolveRounds;   // Rounds of disjoint pairs per step
+	std::size_t                 maxPairBuffer;       // Most pairs found by one thread in a step
+	std::size_t                 pairBufferBytes;     // Memory allocated for the pair buffers
+
+	// Neighbour lists (all zero when disabled)
+	std::size_t                 neighbourListBuilds; // Number of times the lists have been built
+	std::size_t                 neighbourListSteps;  // Number of steps taken with neighbour lists
+	std::size_t                 neighbourPairs;      // Pairs in the current lists
+	std::size_t                 neighbourListBytes;  // Memory allocated for the lists
+};
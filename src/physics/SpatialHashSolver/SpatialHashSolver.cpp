@@ -1,250 +1,1777 @@
 #include "SpatialHashSolver.hpp"
 
 #include <cmath>
-#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
 #include <chrono>
+#include <iostream>
+
+#include "ParticleKernels.hpp"
+#include "Profiler.hpp"
+
+SpatialHashSolver::SpatialHashSolver(Preset preset)
+	: SpatialHashSolver(preset, World(preset.worldAspectRatio), randomParticles(preset.ballTypes, World(preset.worldAspectRatio), preset.seed, preset.numThreads))
+{
+}
+
+SpatialHashSolver::SpatialHashSolver(Preset preset, const World& world, Particles particles)
+	: Solver(preset, world, std::move(particles)),
+	  m_incremental(preset.incrementalGrid),
+	  m_gridValid(false),
+	  m_numGridUpdates(0),
+	  m_numCellCrossings(0),
+	  m_numFullRebuilds(0),
+	  m_numUnusedEntries(0),
+	  m_binEpoch(0),
+	  m_binStamp(0),
+	  m_cellsBinned(false),
+	  m_movesFound(false),
+	  m_autoTune(preset.autoTuneGrid),
+	  m_cellScale(1.0f),
+	  m_numRegrids(0),
+	  m_regridReason("default resolution"),
+	  m_numResolveSteps(0),
+	  m_numDetectedPairs(0),
+	  m_numResolvedPairs(0),
+	  m_numResolveRounds(0),
+	  m_maxPairBuffer(0),
+	  m_reorderInterval(preset.reorderInterval),
+	  m_stepsUntilReorder(0),
+	  m_threadPool(preset.numThreads, preset.pinThreads)
+{
+	m_skin               = std::max(0.0f, preset.neighbourSkin);
+	m_neighboursValid    = false;
+	m_numNeighbourBuilds = 0;
+	m_numNeighbourSteps  = 0;
+
+	float maxRadius = 0.0f;
+	for (const BallType& ballType : m_ballTypes)
+		if (ballType.count > 0)
+			maxRadius = std::max(maxRadius, ballType.radius);
+
+	if (6.0f * maxRadius > std::min(m_world.xWidth, m_world.yWidth))
+		std::cout << "Warning: balls wider than a third of the world, some collisions may be missed" << std::endl;
+
+	if (6.0f * maxRadius + 3.0f * m_skin > std::min(m_world.xWidth, m_world.yWidth))
+	{
+		if (m_skin > 0.0f)
+			std::cout << "Warning: neighbour skin too large for the world, neighbour lists disabled" << std::endl;
+
+		m_skin = 0.0f;
+	}
+
+	m_inflate = 0.5f * m_skin;
+
+	if (m_skin > 0.0f)
+		m_autoTune = false; // Lists record band indices, so the grid must stay fixed
+
+	buildLevels();
+
+	if (m_reorderInterval > 0)
+		layoutCellsMorton(m_levels, m_grid.cellIndex);
+
+	std::size_t numCells = m_levels.back().cellOffset + m_levels.back().numRows * m_levels.back().numCols;
+
+	m_grid.cellStart.resize(numCells + 1);
+	m_grid.cellEnd.resize(numCells);
+
+	if (m_incremental)
+		m_grid.cellLimit.resize(numCells);
+	m_grid.entries.reserve(m_particles.size());
+
+	m_ballCell.resize(m_particles.size());
+
+	if (m_incremental)
+		m_ballEntry.resize(m_particles.size());
+
+	m_threadData.resize(m_threadPool.size());
+	for (ThreadData& data : m_threadData)
+	{
+		data.cellCounts.resize(numCells);
+		data.pairTests.resize(m_levels.size());
+		data.occupancy.resize(SolverStats::OCCUPANCY_BINS);
+		m_pairBuffers.push_back(&data.pairs);
+	}
+
+	m_stats.occupancy.resize(SolverStats::OCCUPANCY_BINS);
+
+	m_tuneSample.entries.resize(m_levels.size());
+	m_tuneSample.pairTests.resize(m_levels.size());
+
+	sizeBinStamps();
+
+	if (!m_threadPool.getCpus().empty())
+	{
+		std::cout << "Pinned " << m_threadPool.size() << " solver threads to CPUs";
+		for (int cpu : m_threadPool.getCpus())
+			std::cout << " " << cpu;
+		std::cout << std::endl;
+
+		// Move each thread's balls to its own node
+		std::vector<std::uint32_t> order(m_particles.size());
+		std::iota(order.begin(), order.end(), 0);
+		placeParticles(order);
+	}
+}
+
+void SpatialHashSolver::setParticles(const Particles& particles)
+/**
+ * Replace the particles, which must be grouped by BallType,
+ * keeping the grid resolution. The grid is rebuilt in full
+ * on the next step. Grid plans made by auto-tuning hold the
+ * levels' earlier ball counts, so it must be disabled if this
+ * is used.
+ */
+{
+	m_particles = particles;
+
+	for (BallType& ballType : m_ballTypes)
+		ballType.count = 0;
+
+	std::uint32_t maxID = 0;
+
+	for (std::size_t i = 0; i < m_particles.size(); i++)
+	{
+		m_ballTypes[m_particles.typeindex[i]].count++;
+		maxID = std::max(maxID, m_particles.id[i]);
+	}
+
+	for (GridLevel& level : m_levels)
+		level.numBalls = 0;
+
+	for (std::size_t i = 0; i < m_ballTypes.size(); i++)
+	{
+		m_typeStart[i + 1] = m_typeStart[i] + m_ballTypes[i].count;
+		m_levels[m_levelOfType[i]].numBalls += m_ballTypes[i].count;
+	}
+
+	m_slotOfId.resize(std::max<std::size_t>(m_slotOfId.size(), maxID + 1));
+	for (std::size_t i = 0; i < m_particles.size(); i++)
+		m_slotOfId[m_particles.id[i]] = static_cast<std::uint32_t>(i);
+
+	m_ballCell.resize(m_particles.size());
+
+	if (m_incremental)
+		m_ballEntry.resize(m_particles.size());
+
+	if (m_particles.size() > m_countMask)
+		sizeBinStamps();
+
+	m_gridValid       = false;
+	m_cellsBinned     = false;
+	m_movesFound      = false;
+	m_neighboursValid = false;
+}
+
+void SpatialHashSolver::buildLevels()
+/**
+ * Group BallTypes into levels of similar radius, and size
+ * the cells and bands of each level.
+ */
+{
+	// Sort BallTypes by radius, smallest first
+	std::vector<std::size_t> order(m_ballTypes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), 
+		[this](std::size_t a, std::size_t b){ return m_ballTypes[a].radius < m_ballTypes[b].radius; });
+
+	// Balls are stored contiguously by BallType
+	m_typeStart.resize(m_ballTypes.size() + 1);
+	m_typeStart[0] = 0;
+	for (std::size_t i = 0; i < m_ballTypes.size(); i++)
+		m_typeStart[i + 1] = m_typeStart[i] + m_ballTypes[i].count;
+
+	// Start a new level whenever a radius exceeds twice the smallest radius on the current level
+	m_levelOfType.resize(m_ballTypes.size());
+	float levelMinRadius = 0.0f;
+
+	for (std::size_t typeIndex : order)
+	{
+		const BallType& ballType = m_ballTypes[typeIndex];
+
+		if (m_levels.empty() || ballType.radius > 2.0f * levelMinRadius)
+		{
+			m_levels.push_back(GridLevel{});
+			levelMinRadius = ballType.radius;
+		}
+
+		GridLevel& level = m_levels.back();
+		level.maxRadius = ballType.radius + m_inflate;
+		level.numBalls += ballType.count;
+
+		m_levelOfType[typeIndex] = m_levels.size() - 1;
+	}
+
+	if (m_levels.empty())
+		m_levels.push_back(GridLevel{});
+
+	// By default, size cells to fit the level's largest ball, limiting every 
+	// level to about as many cells as there are balls in total. Coarse levels 
+	// with few balls keep small cells, so that lookups from finer levels stay cheap
+	for (GridLevel& level : m_levels)
+	{
+		level.baseCellSize = std::max(
+			2.0f * level.maxRadius,
+			std::sqrt(m_world.xWidth * m_world.yWidth / static_cast<float>(std::max<std::size_t>(1, m_particles.size())))
+		);
+	}
+
+	sizeLevels(m_cellScale, m_ballTypes, m_levels, m_levelPairs);
+}
+
+void SpatialHashSolver::sizeLevels(float cellScale, const std::vector<BallType>& ballTypes, std::vector<GridLevel>& levels, std::vector<LevelPair>& levelPairs) const
+/**
+ * Set the cell dimensions and bands of each level, 
+ * with cells cellScale times their default size (but never 
+ * smaller than the level's largest ball), and pair up the
+ * levels, weighing lookups by the counts in ballTypes. Safe
+ * to call from a background thread, given its own copy of
+ * the BallTypes.
+ */
+{
+	std::size_t cellOffset = 0;
+
+	for (GridLevel& level : levels)
+	{
+		float cellSize = std::max(2.0f * level.maxRadius, cellScale * level.baseCellSize);
+
+		// At least three cells across, so that the cells around a cell are all distinct
+		level.numRows = std::max<std::size_t>(3, static_cast<std::size_t>(m_world.yWidth / cellSize));
+		level.numCols = std::max<std::size_t>(3, static_cast<std::size_t>(m_world.xWidth / cellSize));
+
+		level.rowsPerUnit = static_cast<float>(level.numRows) / m_world.yWidth;
+		level.colsPerUnit = static_cast<float>(level.numCols) / m_world.xWidth;
+
+		level.cellOffset = cellOffset;
+		cellOffset += level.numRows * level.numCols;
+	}
+
+	// Split rows into a few bands per thread, so that threads taking bands from
+	// a shared counter finish at about the same time
+	const std::size_t numBands = BANDS_PER_THREAD * m_threadPool.size();
+
+	for (GridLevel& level : levels)
+		level.numBands = std::max<std::size_t>(1, std::min(numBands, level.numRows));
+
+	// Estimate the number of cells visited when the balls of one level look up another
+	auto lookupCost = [this, &levels, &ballTypes](std::size_t fromLevel, std::size_t toLevel)
+	{
+		const GridLevel& level = levels[toLevel];
+		float cellWidth  = m_world.xWidth / static_cast<float>(level.numCols);
+		float cellHeight = m_world.yWidth / static_cast<float>(level.numRows);
+		float cost = 0.0f;
+
+		for (std::size_t i = 0; i < ballTypes.size(); i++)
+		{
+			if (m_levelOfType[i] != fromLevel)
+				continue;
+
+			const BallType& ballType = ballTypes[i];
+			float reach = ballType.radius + m_inflate + level.maxRadius;
+
+			cost += static_cast<float>(ballType.count) 
+			      * (2.0f * reach / cellWidth  + 1.0f)
+			      * (2.0f * reach / cellHeight + 1.0f);
+		}
+
+		return cost;
+	};
+
+	// Pair up levels, looking up from whichever side is cheaper
+	levelPairs.clear();
+
+	for (std::size_t fine = 0; fine < levels.size(); fine++)
+	{
+		for (std::size_t coarse = fine + 1; coarse < levels.size(); coarse++)
+		{
+			LevelPair pair;
+			pair.fromLevel = fine;
+			pair.toLevel   = coarse;
+
+			if (lookupCost(coarse, fine) < lookupCost(fine, coarse))
+				std::swap(pair.fromLevel, pair.toLevel);
+
+			pair.numBands = levels[pair.fromLevel].numBands;
+
+			levelPairs.push_back(pair);
+		}
+	}
+}
+
+void SpatialHashSolver::solve()
+{
+	if (m_autoTune)
+		applyGridPlan();
+
+	if (m_reorderInterval > 0 && m_stepsUntilReorder-- == 0)
+	{
+		reorderParticles();
+		m_stepsUntilReorder = m_reorderInterval - 1;
+		m_neighboursValid = false;
+		m_gridValid = false;
+		m_cellsBinned = false;
+		m_movesFound = false;
+	}
+
+	m_stats.pairTests       = 0; // Added to by checkCollisions() and resolveNeighbours()
+	m_stats.populateSeconds = 0.0;
+	m_stats.checkSeconds    = 0.0;
+	m_stats.resolveSeconds  = 0.0;
+
+	if (m_skin > 0.0f)
+	{
+		if (!m_neighboursValid || neighboursMovedTooFar())
+			buildNeighbourLists();
+
+		resolveNeighbours();
+		m_numNeighbourSteps++;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	updateCells();
+
+	auto populated = std::chrono::steady_clock::now();
+
+	checkCollisions();
+
+	auto checked = std::chrono::steady_clock::now();
+
+	resolvePairs();
+
+	auto resolved = std::chrono::steady_clock::now();
+
+	m_stats.populateSeconds = std::chrono::duration<double>(populated - start).count();
+	m_stats.checkSeconds    = std::chrono::duration<double>(checked - populated).count();
+	m_stats.resolveSeconds  = std::chrono::duration<double>(resolved - checked).count();
+
+	recordSample(m_stats.populateSeconds, m_stats.checkSeconds);
+
+	// Periodically evaluate the grid resolution in the background
+	if (m_autoTune && m_tuneSample.numSteps >= AUTOTUNE_INTERVAL && !m_pendingPlan.valid())
+	{
+		m_pendingPlan = std::async(
+			std::launch::async,
+			[this, sample = m_tuneSample, levels = m_levels, ballTypes = m_ballTypes, cellScale = m_cellScale]()
+			{
+				return planGrid(sample, levels, ballTypes, cellScale);
+			}
+		);
+
+		m_lastSample = m_tuneSample;
+		m_tuneSample = TuneSample{};
+		m_tuneSample.entries.resize(m_levels.size());
+		m_tuneSample.pairTests.resize(m_levels.size());
+	}
+}
+
+void SpatialHashSolver::recordSample(double populateSeconds, double checkSeconds)
+/**
+ * Add this step's work to the running auto-tuning sample.
+ */
+{
+	for (std::size_t i = 0; i < m_levels.size(); i++)
+	{
+		const GridLevel& level = m_levels[i];
+
+		m_tuneSample.entries[i] += static_cast<double>(level.numBalls);
+
+		for (const ThreadData& data : m_threadData)
+			m_tuneSample.pairTests[i] += static_cast<double>(data.pairTests[i]);
+	}
+
+	for (const ThreadData& data : m_threadData)
+		m_tuneSample.crossPairTests += static_cast<double>(data.crossPairTests);
+
+	m_tuneSample.populateSeconds += populateSeconds;
+	m_tuneSample.checkSeconds    += checkSeconds;
+	m_tuneSample.numSteps++;
+}
+
+void SpatialHashSolver::applyGridPlan()
+/**
+ * Switch to a new grid resolution once its evaluation has
+ * finished. All arrays were allocated by the background
+ * task, so this only swaps them in and clears the new
+ * histograms, each on its own thread.
+ */
+{
+	if (!m_pendingPlan.valid() || m_pendingPlan.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	GridPlan plan = m_pendingPlan.get();
+
+	m_regridReason = plan.reason;
+
+	if (!plan.changed)
+		return;
+
+	m_cellScale = plan.cellScale;
+	m_levels.swap(plan.levels);
+	m_levelPairs.swap(plan.levelPairs);
+	m_grid.cellStart.swap(plan.cellStart);
+	m_grid.cellEnd.resize(m_grid.cellStart.size() - 1);
+
+	if (m_incremental)
+		m_grid.cellLimit.resize(m_grid.cellStart.size() - 1);
+	m_grid.cellIndex.swap(plan.cellIndex);
+	m_gridValid = false;
+	m_cellsBinned = false;
+	m_movesFound = false;
+
+	for (std::size_t i = 0; i < m_threadData.size(); i++)
+		m_threadData[i].cellCounts.swap(plan.cellCounts[i]);
+
+	sizeBinStamps();
+
+	m_lastSample = TuneSample{};
+	m_numRegrids++;
+}
+
+SpatialHashSolver::GridPlan SpatialHashSolver::planGrid(const TuneSample& sample, const std::vector<GridLevel>& levels, const std::vector<BallType>& ballTypes, float cellScale) const
+/**
+ * Predict the cost per step of a range of cell sizes and pick 
+ * the cheapest. Runs on a background thread, so works from
+ * copies of the levels and BallTypes taken at launch, and
+ * only reads members that are fixed after construction.
+ * 
+ * The model splits the measured time per step into a cost per
+ * cell entry (populating) and per pair test (checking), each 
+ * with a smaller cost per cell visited. For each level, the
+ * pair tests are predicted as those of uniformly placed balls,
+ * 9N^2 / 2C for N balls in C cells (each cell being checked 
+ * against itself and four neighbours), scaled by how 
+ * clustered the level was measured to be.
+ */
+{
+	GridPlan plan;
+	plan.cellScale = cellScale;
+
+	const double numSteps = static_cast<double>(std::max<std::size_t>(1, sample.numSteps));
+
+	const double cellWeightPopulate = 0.25; // Cost of a cell relative to an entry when populating
+	const double cellWeightCheck    = 0.5;  // Cost of a cell relative to a pair test when checking
+
+	// Measured work per step at the current resolution
+	double entries = 0.0, pairTests = sample.crossPairTests / numSteps, cells = 0.0;
+	std::vector<double> clustering(levels.size(), 1.0);
+
+	for (std::size_t i = 0; i < levels.size(); i++)
+	{
+		double levelEntries = sample.entries[i] / numSteps;
+		double levelCells   = static_cast<double>(levels[i].numRows * levels[i].numCols);
+		double uniformPairs = 9.0 * levelEntries * levelEntries / (2.0 * levelCells);
+
+		if (uniformPairs > 0.0)
+			clustering[i] = std::max(1.0, (sample.pairTests[i] / numSteps) / uniformPairs);
+
+		entries   += levelEntries;
+		pairTests += sample.pairTests[i] / numSteps;
+		cells     += levelCells;
+	}
+
+	// Calibrate costs from the measured timings
+	const double costPerEntry = (sample.populateSeconds / numSteps) / std::max(1.0, entries + cellWeightPopulate * cells);
+	const double costPerPair  = (sample.checkSeconds / numSteps) / std::max(1.0, pairTests + cellWeightCheck * cells);
+	const double crossCost    = costPerPair * sample.crossPairTests / numSteps; // Assumed independent of cell size
+
+	auto predictCost = [&](const std::vector<GridLevel>& trialLevels)
+	{
+		double cost = crossCost;
+
+		for (std::size_t i = 0; i < trialLevels.size(); i++)
+		{
+			double levelEntries = static_cast<double>(trialLevels[i].numBalls);
+			double levelCells   = static_cast<double>(trialLevels[i].numRows * trialLevels[i].numCols);
+			double levelPairs   = clustering[i] * 9.0 * levelEntries * levelEntries / (2.0 * levelCells);
+
+			cost += costPerEntry * (levelEntries + cellWeightPopulate * levelCells)
+			      + costPerPair  * (levelPairs   + cellWeightCheck    * levelCells);
+		}
+
+		return cost;
+	};
+
+	const double currentCost = predictCost(levels);
+	double bestCost = currentCost;
+
+	for (float factor : { 0.5f, 0.71f, 1.41f, 2.0f })
+	{
+		float trialScale = std::min(8.0f, std::max(0.125f, cellScale * factor));
+
+		std::vector<GridLevel> trialLevels = levels;
+		std::vector<LevelPair> trialPairs;
+		sizeLevels(trialScale, ballTypes, trialLevels, trialPairs);
+
+		double cost = predictCost(trialLevels);
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			plan.cellScale  = trialScale;
+			plan.levels     = std::move(trialLevels);
+			plan.levelPairs = std::move(trialPairs);
+		}
+	}
+
+	// Only switch for a clear improvement, to avoid flip-flopping between resolutions
+	if (bestCost > 0.9 * currentCost)
+	{
+		plan.cellScale = cellScale;
+		plan.reason = "current resolution predicted within 10% of the best alternative ("
+		            + std::to_string(currentCost * 1e3) + " ms/step)";
+		return plan;
+	}
+
+	plan.changed = true;
+	plan.reason = "cell scale " + std::to_string(cellScale) + " -> " + std::to_string(plan.cellScale)
+	            + ": predicted " + std::to_string(bestCost * 1e3) + " ms/step vs " + std::to_string(currentCost * 1e3) 
+	            + " ms/step (mean occupancy " + std::to_string(entries / std::max(1.0, cells))
+	            + ", pair tests " + std::to_string(pairTests) + "/step)";
+
+	// Allocate the new grid arrays here, so switching costs the solver little
+	// (their pages are left for the solver's threads to touch first)
+	std::size_t numCells = plan.levels.back().cellOffset + plan.levels.back().numRows * plan.levels.back().numCols;
+
+	plan.cellStart.resize(numCells + 1);
+	plan.cellCounts.resize(m_threadData.size());
+	for (BigArray<std::uint32_t>& cellCounts : plan.cellCounts)
+		cellCounts.resize(numCells);
+
+	if (m_reorderInterval > 0)
+		layoutCellsMorton(plan.levels, plan.cellIndex);
+
+	return plan;
+}
+
+void SpatialHashSolver::layoutCellsMorton(const std::vector<GridLevel>& levels, std::vector<std::uint32_t>& cellIndex)
+/**
+ * Lay out the cells of each level in Morton order, found by
+ * interleaving the bits of the row and column. Grids whose
+ * sides are not powers of two skip the unused Morton codes,
+ * so the cells remain densely packed.
+ */
+{
+	auto spreadBits = [](std::uint64_t v) // Move bit i of a 32-bit value to bit 2i
+	{
+		v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+		v = (v | (v <<  8)) & 0x00FF00FF00FF00FFull;
+		v = (v | (v <<  4)) & 0x0F0F0F0F0F0F0F0Full;
+		v = (v | (v <<  2)) & 0x3333333333333333ull;
+		v = (v | (v <<  1)) & 0x5555555555555555ull;
+		return v;
+	};
+
+	cellIndex.resize(levels.back().cellOffset + levels.back().numRows * levels.back().numCols);
+
+	for (const GridLevel& level : levels)
+	{
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> codes; // Morton code and row-major index of each cell
+		codes.reserve(level.numRows * level.numCols);
+
+		for (std::size_t row = 0; row < level.numRows; row++)
+			for (std::size_t col = 0; col < level.numCols; col++)
+				codes.emplace_back((spreadBits(row) << 1) | spreadBits(col), static_cast<std::uint32_t>(row * level.numCols + col));
+
+		std::sort(codes.begin(), codes.end());
+
+		for (std::size_t rank = 0; rank < codes.size(); rank++)
+			cellIndex[level.cellOffset + codes[rank].second] = static_cast<std::uint32_t>(level.cellOffset + rank);
+	}
+}
+
+void SpatialHashSolver::reorderParticles()
+/**
+ * Sort the balls of each BallType by the storage index of
+ * the cell containing their centre. Keys are computed in
+ * parallel, and each thread sorts whole BallTypes.
+ */
+{
+	PROFILE_SCOPE("reorderParticles");
+
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numBalls   = m_particles.size();
+
+	std::vector<std::uint32_t> keys(numBalls);
+	std::vector<std::uint32_t> order(numBalls);
+	std::iota(order.begin(), order.end(), 0);
+
+	m_threadPool.run(
+		[this, &keys, numThreads, numBalls](unsigned int i)
+		{
+			std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+			std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+
+			for (std::size_t ball = indLower; ball < indUpper; ball++)
+			{
+				const GridLevel& level = m_levels[m_levelOfType[m_particles.typeindex[ball]]];
+
+				int row = std::min<int>(yPosToRow(level, m_particles.y[ball]), static_cast<int>(level.numRows) - 1);
+				int col = std::min<int>(xPosToCol(level, m_particles.x[ball]), static_cast<int>(level.numCols) - 1);
+
+				keys[ball] = static_cast<std::uint32_t>(hashCell(level, std::max(row, 0), std::max(col, 0)));
+			}
+		}
+	);
+
+	m_threadPool.run(
+		[this, &keys, &order, numThreads](unsigned int i)
+		{
+			for (std::size_t type = i; type < m_ballTypes.size(); type += numThreads)
+			{
+				std::sort(order.begin() + m_typeStart[type], order.begin() + m_typeStart[type + 1],
+					[&keys](std::uint32_t a, std::uint32_t b){ return keys[a] < keys[b]; });
+			}
+		}
+	);
+
+	placeParticles(order);
+}
+
+void SpatialHashSolver::placeParticles(const std::vector<std::uint32_t>& order)
+/**
+ * Gather the balls into fresh arrays, with the ball in slot
+ * order[i] moving to slot i. Each thread writes the range of
+ * slots it moves in updatePositions(), so the pages of its 
+ * balls are first touched, and placed, by that thread.
+ */
+{
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numBalls   = m_particles.size();
+
+	Particles placed;
+	placed.resize(numBalls);
+
+	m_threadPool.run(
+		[this, &placed, &order, numThreads, numBalls](unsigned int i)
+		{
+			std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+			std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+
+			for (std::size_t slot = indLower; slot < indUpper; slot++)
+			{
+				std::size_t from = order[slot];
+
+				placed.x[slot]         = m_particles.x[from];
+				placed.y[slot]         = m_particles.y[from];
+				placed.vx[slot]        = m_particles.vx[from];
+				placed.vy[slot]        = m_particles.vy[from];
+				placed.radius[slot]    = m_particles.radius[from];
+				placed.invMass[slot]   = m_particles.invMass[from];
+				placed.typeindex[slot] = m_particles.typeindex[from];
+				placed.id[slot]        = m_particles.id[from];
+
+				m_slotOfId[placed.id[slot]] = static_cast<std::uint32_t>(slot);
+			}
+		}
+	);
+
+	m_particles = std::move(placed);
+}
+
+void SpatialHashSolver::buildNeighbourLists()
+/**
+ * Rebuild the neighbour lists from the grid, and remember
+ * where each ball was.
+ */
+{
+	PROFILE_SCOPE("buildNeighbourLists");
+
+	m_neighbours.resize(m_levels.size() + m_levelPairs.size());
+
+	for (std::size_t pass = 0; pass < m_neighbours.size(); pass++)
+	{
+		std::size_t numBands = pass < m_levels.size() ? m_levels[pass].numBands : m_levelPairs[pass - m_levels.size()].numBands;
+
+		m_neighbours[pass].resize(numBands);
+		for (std::vector<NeighbourPair>& list : m_neighbours[pass])
+			list.clear();
+	}
+
+	updateCells();
+	checkCollisions();
+
+	for (ThreadData& data : m_threadData)
+		data.neighbours = nullptr;
+
+	m_buildX = m_particles.x;
+	m_buildY = m_particles.y;
+
+	m_neighboursValid = true;
+	m_numNeighbourBuilds++;
+}
+
+bool SpatialHashSolver::neighboursMovedTooFar()
+/**
+ * Test whether any ball has moved more than half the skin 
+ * since the neighbour lists were built. Displacements are 
+ * measured to the nearest image, since balls wrap around 
+ * the world.
+ */
+{
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numBalls   = m_particles.size();
+
+	m_threadPool.run(
+		[this, numThreads, numBalls](unsigned int i)
+		{
+			std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+			std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+
+			const float xWidth = m_world.xWidth;
+			const float yWidth = m_world.yWidth;
+			float maxSquared = 0.0f;
+
+			for (std::size_t ball = indLower; ball < indUpper; ball++)
+			{
+				float dx = std::fabs(m_particles.x[ball] - m_buildX[ball]);
+				float dy = std::fabs(m_particles.y[ball] - m_buildY[ball]);
+				dx = std::min(dx, xWidth - dx);
+				dy = std::min(dy, yWidth - dy);
+
+				maxSquared = std::max(maxSquared, dx * dx + dy * dy);
+			}
+
+			m_threadData[i].maxDisplacement = std::sqrt(maxSquared);
+		}
+	);
+
+	for (const ThreadData& data : m_threadData)
+		if (data.maxDisplacement > 0.5f * m_skin)
+			return true;
+
+	return false;
+}
+
+void SpatialHashSolver::resolveNeighbours()
+/**
+ * Collect the overlapping pairs of the neighbour lists into 
+ * the pair buffers, each translated to its nearest image, 
+ * and resolve them.
+ */
+{
+	PROFILE_SCOPE("resolveNeighbours");
+
+	for (ThreadData& data : m_threadData)
+	{
+		data.pairs.clear();
+		data.listPairTests = 0;
+		data.wrappedPairs = 0;
+	}
+
+	for (std::size_t pass = 0; pass < m_neighbours.size(); pass++)
+	{
+		checkBands(m_neighbours[pass].size(),
+			[this, pass](std::size_t band, ThreadData& data)
+			{
+				data.listPairTests += m_neighbours[pass][band].size();
+
+				for (const NeighbourPair& pair : m_neighbours[pass][band])
+				{
+					Vec2<float> shift = nearestImageShift(pair.i1, pair.i2);
+
+					if (Solver::overlap(pair.i1, pair.i2, shift))
+					{
+						data.pairs.push_back({ pair.i1, pair.i2, shift.x, shift.y });
+						data.wrappedPairs += shift.x != 0.0f || shift.y != 0.0f;
+					}
+				}
+			}
+		);
+	}
+
+	for (const ThreadData& data : m_threadData)
+		m_stats.pairTests += data.listPairTests;
+
+	resolvePairs();
+}
+
+GridStats SpatialHashSolver::getGridStats() const
+{
+	GridStats stats;
+
+	const TuneSample& sample = m_lastSample.numSteps > 0 ? m_lastSample : m_tuneSample;
+	const double numSteps = static_cast<double>(std::max<std::size_t>(1, sample.numSteps));
+
+	stats.cellScale           = m_cellScale;
+	stats.meanCrossPairTests  = sample.crossPairTests / numSteps;
+	stats.meanPopulateSeconds = sample.populateSeconds / numSteps;
+	stats.meanCheckSeconds    = sample.checkSeconds / numSteps;
+	stats.numSteps            = sample.numSteps;
+	stats.numRegrids          = m_numRegrids;
+	stats.regridReason        = m_regridReason;
+
+	stats.meanCellCrossings = static_cast<double>(m_numCellCrossings) / static_cast<double>(std::max<std::size_t>(1, m_numGridUpdates));
+	stats.numFullRebuilds   = m_numFullRebuilds;
+
+	const double numResolveSteps = static_cast<double>(std::max<std::size_t>(1, m_numResolveSteps));
+
+	stats.meanDetectedPairs = m_numDetectedPairs / numResolveSteps;
+	stats.meanResolvedPairs = m_numResolvedPairs / numResolveSteps;
+	stats.meanResolveRounds = m_numResolveRounds / numResolveSteps;
+	stats.maxPairBuffer     = m_maxPairBuffer;
+	stats.pairBufferBytes   = m_resolver.getBufferBytes();
+
+	for (const ThreadData& data : m_threadData)
+		stats.pairBufferBytes += data.pairs.capacity() * sizeof(CollisionPair);
+
+	stats.neighbourListBuilds = m_numNeighbourBuilds;
+	stats.neighbourListSteps  = m_numNeighbourSteps;
+	stats.neighbourPairs      = 0;
+	stats.neighbourListBytes  = (m_buildX.capacity() + m_buildY.capacity()) * sizeof(float);
+
+	for (const std::vector<std::vector<NeighbourPair>>& pass : m_neighbours)
+	{
+		for (const std::vector<NeighbourPair>& list : pass)
+		{
+			stats.neighbourPairs     += list.size();
+			stats.neighbourListBytes += list.capacity() * sizeof(NeighbourPair);
+		}
+	}
+
+	for (std::size_t i = 0; i < m_levels.size(); i++)
+	{
+		const GridLevel& level = m_levels[i];
+		GridLevelStats levelStats;
+
+		levelStats.numRows       = level.numRows;
+		levelStats.numCols       = level.numCols;
+		levelStats.cellWidth     = m_world.xWidth / static_cast<float>(level.numCols);
+		levelStats.cellHeight    = m_world.yWidth / static_cast<float>(level.numRows);
+		levelStats.numBalls      = level.numBalls;
+		levelStats.meanEntries   = sample.entries[i] / numSteps;
+		levelStats.meanOccupancy = levelStats.meanEntries / static_cast<double>(level.numRows * level.numCols);
+		levelStats.meanPairTests = sample.pairTests[i] / numSteps;
+
+		stats.levels.push_back(levelStats);
+	}
+
+	return stats;
+}
+
+void SpatialHashSolver::updatePositions(float dt)
+/**
+ * Move the balls in parallel, binning each block of balls
+ * into the grid for the next step straight after moving it:
+ * either counting their cells for populateCells() or, when
+ * the incremental grid can be kept, finding the balls that
+ * changed cell for moveCells(). Balls are not binned while
+ * neighbour lists are used, as the grid is rarely rebuilt.
+ */
+{
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numBalls   = m_particles.size();
+
+	const bool bin       = m_skin == 0.0f;
+	const bool findMoves = bin && m_incremental && m_gridValid;
+	const bool count     = bin && !findMoves;
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (count)
+		advanceBinEpoch();
+
+	m_threadPool.run(
+		[this, numThreads, numBalls, dt, findMoves, count](unsigned int i)
+		{
+			std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+			std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+
+			ThreadData& data = m_threadData[i];
+			data.moves.clear();
+
+			for (std::size_t blockLower = indLower; blockLower < indUpper; blockLower += INTEGRATE_BLOCK_SIZE)
+			{
+				std::size_t blockUpper = std::min(indUpper, blockLower + INTEGRATE_BLOCK_SIZE);
+
+				integratePositions(
+					m_particles.x.data(), m_particles.y.data(),
+					m_particles.vx.data(), m_particles.vy.data(),
+					blockLower, blockUpper,
+					dt, m_world
+				);
+
+				if (findMoves)
+					findMovesInRange(blockLower, blockUpper, data);
+				else if (count)
+					countCellsInRange(blockLower, blockUpper, data);
+			}
+		}
+	);
+
+	m_cellsBinned = count;
+	m_movesFound  = findMoves;
+
+	m_stats.integrateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SpatialHashSolver::updateCells()
+/**
+ * Bring m_grid up to date with the balls' positions, 
+ * moving only the balls that changed cell when using the
+ * incremental grid.
+ */
+{
+	PROFILE_SCOPE("updateCells");
+
+	m_numGridUpdates++;
+
+	if (m_incremental && m_gridValid && moveCells())
+		return;
+
+	populateCells();
+}
+
+bool SpatialHashSolver::moveCells()
+/**
+ * Find the balls that changed cell in parallel, then move
+ * them in parallel too (unless there are few), each thread
+ * taking the moves out of and into its own range of cells.
+ * Balls are taken out of their old cells first, then added
+ * to their new ones, so no ball's entry is written by two
+ * threads at once. Each cell sees its moves in the same
+ * order however many threads there are. Moves into a full
+ * cell are left for this thread, which moves the cell to
+ * make room. Returns false if cells moved to make room have
+ * left too many unused entries, leaving the grid to be
+ * rebuilt.
+ */
+{
+	PROFILE_SCOPE("moveCells");
+
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numBalls   = m_particles.size();
+	const std::size_t  numCells   = m_grid.cellEnd.size();
+
+	if (!m_movesFound)
+	{
+		m_threadPool.run(
+			[this, numThreads, numBalls](unsigned int i)
+			{
+				std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+				std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+
+				m_threadData[i].moves.clear();
+				findMovesInRange(indLower, indUpper, m_threadData[i]);
+			}
+		);
+	}
+
+	m_movesFound = false;
+
+	std::size_t numMoves = 0;
+	for (const ThreadData& data : m_threadData)
+		numMoves += data.moves.size();
+
+	// Take balls out of the cells in [cellLower, cellUpper), swapping the last entry of each cell into the ball's place
+	auto removeRange = [this](std::size_t cellLower, std::size_t cellUpper)
+	{
+		for (const ThreadData& data : m_threadData)
+		{
+			for (const CellMove& move : data.moves)
+			{
+				if (move.oldCell < cellLower || move.oldCell >= cellUpper)
+					continue;
+
+				std::uint32_t oldEntry  = m_ballEntry[move.ballID];
+				std::uint32_t lastEntry = --m_grid.cellEnd[move.oldCell];
+
+				m_grid.entries[oldEntry] = m_grid.entries[lastEntry];
+				m_ballEntry[m_grid.entries[oldEntry].ballID] = oldEntry;
+			}
+		}
+	};
+
+	auto addToCell = [this](std::uint32_t ball, std::uint32_t cell)
+	{
+		std::uint32_t newEntry = m_grid.cellEnd[cell]++;
+
+		m_grid.entries[newEntry] = { ball };
+		m_ballEntry[ball] = newEntry;
+		m_ballCell[ball]  = cell;
+	};
+
+	// Add balls to the cells in [cellLower, cellUpper), setting aside moves into full cells
+	auto addRange = [this, &addToCell](std::size_t cellLower, std::size_t cellUpper, std::vector<CellMove>& fullMoves)
+	{
+		fullMoves.clear();
+
+		for (const ThreadData& data : m_threadData)
+		{
+			for (const CellMove& move : data.moves)
+			{
+				if (move.cell < cellLower || move.cell >= cellUpper)
+					continue;
+
+				if (m_grid.cellEnd[move.cell] == m_grid.cellLimit[move.cell])
+					fullMoves.push_back(move);
+				else
+					addToCell(move.ballID, move.cell);
+			}
+		}
+	};
+
+	if (numThreads == 1 || numMoves < PARALLEL_MOVE_SIZE)
+	{
+		for (ThreadData& data : m_threadData)
+			data.fullMoves.clear();
+
+		removeRange(0, numCells);
+		addRange(0, numCells, m_threadData[0].fullMoves);
+	}
+	else
+	{
+		m_threadPool.run(
+			[&removeRange, numThreads, numCells](unsigned int i)
+			{
+				removeRange(numCells * i / numThreads, numCells * (i + 1) / numThreads);
+			}
+		);
+
+		m_threadPool.run(
+			[this, &addRange, numThreads, numCells](unsigned int i)
+			{
+				addRange(numCells * i / numThreads, numCells * (i + 1) / numThreads, m_threadData[i].fullMoves);
+			}
+		);
+	}
+
+	// Cells that filled up grow the entry array, so are moved one at a time
+	for (const ThreadData& data : m_threadData)
+	{
+		for (const CellMove& move : data.fullMoves)
+		{
+			if (m_grid.cellEnd[move.cell] == m_grid.cellLimit[move.cell])
+				relocateCell(move.cell);
+
+			addToCell(move.ballID, move.cell);
+		}
+	}
+
+	m_numCellCrossings += numMoves;
 
-SpatialHashSolver::SpatialHashSolver(Preset preset)
-	: Solver(preset) 
+	if (m_numUnusedEntries > m_particles.size())
+	{
+		m_gridValid = false;
+		return false;
+	}
+
+	return true;
+}
+
+void SpatialHashSolver::relocateCell(std::size_t cell)
+/**
+ * Move a full cell to the end of m_grid.entries, with room
+ * for twice as many entries.
+ */
+{
+	const std::uint32_t numEntries = m_grid.cellEnd[cell] - m_grid.cellStart[cell];
+	const std::uint32_t start      = static_cast<std::uint32_t>(m_grid.entries.size());
+
+	m_grid.entries.resize(start + 2 * numEntries + 2);
+
+	for (std::uint32_t k = 0; k < numEntries; k++)
+	{
+		BallInfo info = m_grid.entries[m_grid.cellStart[cell] + k];
+		m_grid.entries[start + k] = info;
+		m_ballEntry[info.ballID] = start + k;
+	}
+
+	m_numUnusedEntries += m_grid.cellLimit[cell] - m_grid.cellStart[cell];
+
+	m_grid.cellStart[cell] = start;
+	m_grid.cellEnd[cell]   = start + numEntries;
+	m_grid.cellLimit[cell] = static_cast<std::uint32_t>(m_grid.entries.size());
+}
+
+void SpatialHashSolver::findMovesInRange(std::size_t indLower, std::size_t indUpper, ThreadData& data)
+/*
+ * Add the balls in m_particles with indices in the range
+ * [indLower, indUpper) that are no longer in the cell they
+ * were filed in to the thread's move list.
+ */
+{
+	for (std::size_t type = 0; type < m_ballTypes.size(); type++)
+	{
+		const GridLevel& level = m_levels[m_levelOfType[type]];
+
+		std::size_t typeLower = std::max(indLower, m_typeStart[type]);
+		std::size_t typeUpper = std::min(indUpper, m_typeStart[type + 1]);
+
+		for (std::size_t i = typeLower; i < typeUpper; i++)
+		{
+			std::uint32_t cell = static_cast<std::uint32_t>(centreCell(level, i));
+
+			if (cell != m_ballCell[i])
+				data.moves.push_back({ static_cast<std::uint32_t>(i), cell, m_ballCell[i] });
+		}
+	}
+}
+
+void SpatialHashSolver::populateCells()
+/**
+ * Rebuild m_grid with a parallel counting sort. Each
+ * thread handles balls in m_particles with indices in 
+ * the range [indLower, indUpper):
+ *     1. Count the entries its balls add to each cell.
+ *     2. Sum the counts over a chunk of cells, then turn
+ *        the counts into write positions for each thread.
+ *     3. Write its balls' entries at those positions.
+ * Entries in each cell end up ordered by ball index. With
+ * the incremental grid, each cell is followed by spare room.
+ * Step 1 is skipped if the balls were counted while updating
+ * their positions, and counts are only read if stamped with
+ * the current epoch.
+ */
 {
-	m_numRows = 1 + static_cast<std::size_t>(
-		m_world.yMax * std::sqrt(
-			static_cast<double>(m_balls.size())
-		)
+	PROFILE_SCOPE("populateCells");
+
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numCells   = m_grid.cellStart.size() - 1;
+	const std::size_t  numBalls   = m_particles.size();
+
+	auto ballRange = [numThreads, numBalls](unsigned int i)
+	{
+		std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+		std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+		return std::make_pair(indLower, indUpper);
+	};
+
+	auto cellRange = [numThreads, numCells](unsigned int i)
+	{
+		std::size_t cellLower = std::min(numCells, i * (numCells / numThreads + 1));
+		std::size_t cellUpper = std::min(numCells, (i + 1) * (numCells / numThreads + 1));
+		return std::make_pair(cellLower, cellUpper);
+	};
+
+	// Count entries per cell, unless already counted
+	if (!m_cellsBinned)
+	{
+		advanceBinEpoch();
+
+		m_threadPool.run(
+			[this, &ballRange](unsigned int i)
+			{
+				std::pair<std::size_t, std::size_t> range = ballRange(i);
+				countCellsInRange(range.first, range.second, m_threadData[i]);
+			}
+		);
+	}
+
+	m_cellsBinned = false;
+	m_movesFound  = false;
+
+	const std::uint32_t countMask = m_countMask;
+	const std::uint32_t binStamp  = m_binStamp;
+
+	// Total the entries in each thread's chunk of cells
+	m_threadPool.run(
+		[this, &cellRange, countMask, binStamp](unsigned int i)
+		{
+			std::pair<std::size_t, std::size_t> range = cellRange(i);
+			std::size_t total = 0;
+
+			for (std::size_t cell = range.first; cell < range.second; cell++)
+			{
+				std::uint32_t cellTotal = 0;
+
+				for (const ThreadData& data : m_threadData)
+					cellTotal += stampedCount(data.cellCounts[cell], countMask, binStamp);
+
+				total += cellTotal + cellSlack(cellTotal);
+			}
+
+			m_threadData[i].chunkTotal = total;
+		}
+	);
+
+	std::size_t numEntries = 0;
+	for (ThreadData& data : m_threadData)
+	{
+		std::size_t chunkTotal = data.chunkTotal;
+		data.chunkTotal = numEntries; // Now the offset of the chunk's first entry
+		numEntries += chunkTotal;
+	}
+
+	m_grid.entries.resize(numEntries);
+	m_grid.cellStart[numCells] = static_cast<std::uint32_t>(numEntries);
+
+	// Convert counts to write positions
+	m_threadPool.run(
+		[this, &cellRange, countMask, binStamp](unsigned int i)
+		{
+			std::pair<std::size_t, std::size_t> range = cellRange(i);
+			std::size_t position = m_threadData[i].chunkTotal;
+
+			for (std::size_t cell = range.first; cell < range.second; cell++)
+			{
+				m_grid.cellStart[cell] = static_cast<std::uint32_t>(position);
+
+				for (ThreadData& data : m_threadData)
+				{
+					std::uint32_t count = stampedCount(data.cellCounts[cell], countMask, binStamp);
+					data.cellCounts[cell] = static_cast<std::uint32_t>(position);
+					position += count;
+				}
+
+				m_grid.cellEnd[cell] = static_cast<std::uint32_t>(position);
+
+				if (m_incremental)
+				{
+					position += cellSlack(m_grid.cellEnd[cell] - m_grid.cellStart[cell]);
+					m_grid.cellLimit[cell] = static_cast<std::uint32_t>(position);
+				}
+			}
+		}
 	);
 
-	m_numCols = 1 + static_cast<std::size_t>(
-		m_world.xMax * std::sqrt(
-			static_cast<double>(m_balls.size())
-		)
+	// Write entries
+	m_threadPool.run(
+		[this, &ballRange](unsigned int i)
+		{
+			std::pair<std::size_t, std::size_t> range = ballRange(i);
+			populateCellsInRange(range.first, range.second, m_threadData[i]);
+		}
 	);
 
-	m_grid.resize(m_numRows * m_numCols); // Number of cells is of order m_balls.size()
+	m_gridValid = true;
+	m_numUnusedEntries = 0;
+	m_numFullRebuilds++;
 }
 
-void SpatialHashSolver::solve()
+void SpatialHashSolver::sizeBinStamps()
+/**
+ * Split the bits of the histogram counts between the count,
+ * which needs enough bits for every ball, and the epoch 
+ * (below the top bit), then start from clear histograms.
+ */
 {
-	clearCells();
+	std::uint32_t countBits = 1;
+	while (countBits < 31 && (std::size_t(1) << countBits) <= m_particles.size())
+		countBits++;
 
-	populateCells();
+	m_countMask = (std::uint32_t(1) << countBits) - 1;
+	m_numEpochs = std::uint32_t(1) << (31 - countBits);
 
-	checkCollisions();
+	clearCellCounts();
+
+	m_binEpoch    = 0;
+	m_cellsBinned = false;
 }
 
-void SpatialHashSolver::clearCells()
+void SpatialHashSolver::clearCellCounts()
+/**
+ * Zero the histograms, each on the thread filling it.
+ */
 {
-	for (Cell& cell : m_grid)
-		cell.clear();
+	m_threadPool.run(
+		[this](unsigned int i)
+		{
+			BigArray<std::uint32_t>& cellCounts = m_threadData[i].cellCounts;
+			std::fill(cellCounts.begin(), cellCounts.end(), 0);
+		}
+	);
 }
 
+void SpatialHashSolver::advanceBinEpoch()
+/**
+ * Start a new epoch of cell counts. A count made in an epoch
+ * has its top bit set and the epoch in the bits above the
+ * count (see m_countMask). Write positions (under 2^31) never
+ * have the top bit set, so can't be mistaken for counts. The
+ * histograms are only cleared when the epochs wrap around.
+ */
+{
+	if (++m_binEpoch == m_numEpochs)
+	{
+		clearCellCounts();
+
+		m_binEpoch = 0;
+	}
+
+	m_binStamp = (std::uint32_t(1) << 31) | (m_binEpoch * (m_countMask + 1));
+}
 
-void SpatialHashSolver::populateCells()
+std::uint32_t SpatialHashSolver::stampedCount(std::uint32_t cellCount, std::uint32_t countMask, std::uint32_t binStamp)
 /**
- * Split task of populating cells across multiple
- * threads. Each thread then places balls in m_balls
- * with indices in the range [indLower, indUpper) into
- * cells
+ * Without branching, as cells are about as likely to be 
+ * stale as not.
  */
 {
-	m_futures.clear();
+	std::uint32_t current = std::uint32_t(0) - std::uint32_t((cellCount ^ binStamp) <= countMask); // All ones if current
+
+	return cellCount & countMask & current;
+}
+
+std::size_t SpatialHashSolver::centreCell(const GridLevel& level, std::size_t ballID)
+{
+	// Positions are wrapped into the world, up to rounding at its edges
+	int row = wrapIndex(yPosToRow(level, m_particles.y[ballID]), static_cast<int>(level.numRows));
+	int col = wrapIndex(xPosToCol(level, m_particles.x[ballID]), static_cast<int>(level.numCols));
+
+	return hashCell(level, static_cast<std::size_t>(row), static_cast<std::size_t>(col));
+}
+
+std::uint32_t SpatialHashSolver::cellSlack(std::uint32_t numEntries) const
+{
+	return m_incremental ? 1 + numEntries / 2 : 0;
+}
 
-	for (unsigned int i = 0; i < NUM_THREADS; i++)
+void SpatialHashSolver::countCellsInRange(std::size_t indLower, std::size_t indUpper, ThreadData& data)
+/*
+ * Count the entries added to each cell by balls in
+ * m_particles with indices in the range [indLower, indUpper),
+ * recording the cell containing each ball's centre. Counts
+ * from an earlier epoch are reset on first use. Cells are
+ * found first, so the counting loop is short enough to have
+ * many cache misses in flight.
+ */
+{
+	for (std::size_t type = 0; type < m_ballTypes.size(); type++)
 	{
-		std::size_t indLower = std::min(m_balls.size(), i * (m_balls.size() / NUM_THREADS + 1));
-		std::size_t indUpper = std::min(m_balls.size(), (i + 1) * (m_balls.size() / NUM_THREADS + 1));
+		const GridLevel& level = m_levels[m_levelOfType[type]];
 
-		m_futures.push_back(
-			std::async(
-				std::launch::async, 
-				[this, indLower, indUpper](){return populateCellsInRange(indLower, indUpper);} 
-			)
-		);
+		std::size_t typeLower = std::max(indLower, m_typeStart[type]);
+		std::size_t typeUpper = std::min(indUpper, m_typeStart[type + 1]);
+
+		for (std::size_t i = typeLower; i < typeUpper; i++)
+			m_ballCell[i] = static_cast<std::uint32_t>(centreCell(level, i));
 	}
 
-	for (std::future<void>& future : m_futures)
-		future.wait();
+	const std::uint32_t  countMask  = m_countMask;
+	const std::uint32_t  binStamp   = m_binStamp;
+	const std::uint32_t* ballCell   = m_ballCell.data();
+	std::uint32_t*       cellCounts = data.cellCounts.data();
+
+	for (std::size_t i = indLower; i < indUpper; i++)
+		cellCounts[ballCell[i]] = binStamp + stampedCount(cellCounts[ballCell[i]], countMask, binStamp) + 1;
 }
 
-void SpatialHashSolver::populateCellsInRange(std::size_t indLower, std::size_t indUpper)
+void SpatialHashSolver::populateCellsInRange(std::size_t indLower, std::size_t indUpper, ThreadData& data)
 /*
- * Iterate through entries of m_balls with indices
+ * Iterate through entries of m_particles with indices
  * in the specified range [indLower, indUpper), storing
- * their info in m_grid.
+ * their info in m_grid at the thread's write positions.
  */
 {
 	for (std::size_t i = indLower; i < indUpper; i++)
 	{
-		const Ball& ball = m_balls[i];
+		std::uint32_t entry = data.cellCounts[m_ballCell[i]]++;
+		m_grid.entries[entry] = { static_cast<std::uint32_t>(i) };
 
-		const float& radius = m_ballTypes[ball.typeindex].radius;
+		if (m_incremental)
+			m_ballEntry[i] = entry;
+	}
+}
 
-		float xLeft  = ball.position.x - radius;
-		float xRight = ball.position.x + radius;
-		float yLow   = ball.position.y - radius;
-		float yHigh  = ball.position.y + radius;
+void SpatialHashSolver::checkCollisions()
+/**
+ * Check each level in turn for pairs within the level,
+ * then each pair of levels for pairs across them.
+ */
+{
+	PROFILE_SCOPE("checkCollisions");
 
-		for (int rowRaw = yPosToRow(yLow); rowRaw <= yPosToRow(yHigh); rowRaw++)
-		{
-			for (int colRaw = xPosToCol(xLeft); colRaw <= xPosToCol(xRight); colRaw++)
-			{
-				Offset offset = NONE;
-				int row = rowRaw;
-				int col = colRaw;
+	for (ThreadData& data : m_threadData)
+	{
+		std::fill(data.pairTests.begin(), data.pairTests.end(), 0);
+		data.crossPairTests = 0;
+		data.wrappedPairs = 0;
+		std::fill(data.occupancy.begin(), data.occupancy.end(), 0);
+		data.maxCellBalls = 0;
+		data.pairs.clear();
+	}
 
-				if (row < 0)
-				{
-					row += m_numRows;
-					offset = UP;
-				}
-				else if (row >= m_numRows)
-				{
-					row -= m_numRows;
-					offset = DOWN;
-				}
+	for (std::size_t i = 0; i < m_levels.size(); i++)
+	{
+		const GridLevel& level = m_levels[i];
 
-				if (col < 0)
-				{
-					col += m_numCols;
-					offset = (Offset)(offset + RIGHT);
-				}
-				else if (col >= m_numCols)
-				{
-					col -= m_numCols;
-					offset = (Offset)(offset + LEFT);
-				}
+		checkBands(level.numBands,
+			[this, i, &level](std::size_t band, ThreadData& data)
+			{
+				data.neighbours = m_skin > 0.0f ? &m_neighbours[i][band] : nullptr;
+				data.pairTests[i] += checkCollisionsInRange(level, bandToRow(level, band, level.numBands), bandToRow(level, band + 1, level.numBands), data);
+			}
+		);
+	}
+
+	for (std::size_t i = 0; i < m_levelPairs.size(); i++)
+	{
+		const LevelPair& pair  = m_levelPairs[i];
+		const GridLevel& level = m_levels[pair.fromLevel];
+		const std::size_t pass = m_levels.size() + i;
 
-				m_grid[hashCell(row, col)].addBall({i, offset});
+		checkBands(pair.numBands,
+			[this, pass, &pair, &level](std::size_t band, ThreadData& data)
+			{
+				data.neighbours = m_skin > 0.0f ? &m_neighbours[pass][band] : nullptr;
+				data.crossPairTests += checkLevelPairInRange(pair, bandToRow(level, band, pair.numBands), bandToRow(level, band + 1, pair.numBands), data);
 			}
-		}
+		);
+	}
+
+	std::fill(m_stats.occupancy.begin(), m_stats.occupancy.end(), 0);
+	m_stats.maxCellBalls = 0;
+
+	for (const ThreadData& data : m_threadData)
+	{
+		for (std::size_t i = 0; i < m_levels.size(); i++)
+			m_stats.pairTests += data.pairTests[i];
+		m_stats.pairTests += data.crossPairTests;
+
+		for (std::size_t bin = 0; bin < SolverStats::OCCUPANCY_BINS; bin++)
+			m_stats.occupancy[bin] += data.occupancy[bin];
+		m_stats.maxCellBalls = std::max(m_stats.maxCellBalls, data.maxCellBalls);
 	}
 }
 
-void SpatialHashSolver::checkCollisions()
+void SpatialHashSolver::checkBands(std::size_t numBands, const std::function<void(std::size_t, ThreadData&)>& checkBand)
 /**
  * Split task of checking collisions across multiple
- * threads. Each thread checks cells with row index
- * in the range [rowLower, rowUpper).
+ * threads, with threads taking bands of rows from a 
+ * shared counter until none remain.
  */
 {
-	m_futures.clear();
+	std::atomic<std::size_t> nextBand(0);
 
-	for (unsigned int i = 0; i < NUM_THREADS; i++)
-	{
-		std::size_t rowLower = std::min(m_numRows, i * (m_numRows / NUM_THREADS + 1));
-		std::size_t rowUpper = std::min(m_numRows, (i + 1) * (m_numRows / NUM_THREADS + 1));
+	m_threadPool.run(
+		[this, &nextBand, &checkBand, numBands](unsigned int i)
+		{
+			for (std::size_t band = nextBand.fetch_add(1); band < numBands; band = nextBand.fetch_add(1))
+				checkBand(band, m_threadData[i]);
+		}
+	);
+}
 
-		m_futures.push_back(
-			std::async(
-				std::launch::async, 
-				[this, rowLower, rowUpper](){return checkCollisionsInRange(rowLower, rowUpper);} 
-			)
-		);
+void SpatialHashSolver::findPairs(std::vector<CollisionPair>& pairs)
+/**
+ * Bin the balls and check the grid as solve() does, but copy
+ * the overlapping pairs out instead of resolving them. Pair
+ * tests and cell occupancy are counted in getStats().
+ */
+{
+	updateCells();
+
+	m_stats.pairTests = 0;
+	checkCollisions();
+
+	pairs.clear();
+	for (const ThreadData& data : m_threadData)
+		pairs.insert(pairs.end(), data.pairs.begin(), data.pairs.end());
+}
+
+void SpatialHashSolver::resolveSelectedPairs(const std::vector<CollisionPair>& pairs)
+/**
+ * Resolve the given pairs as resolvePairs() would had they
+ * all been found by one thread, counting them in getStats().
+ */
+{
+	PROFILE_SCOPE("resolvePairs");
+
+	m_stats.overlapsFound = pairs.size();
+	m_stats.wrappedPairs  = 0;
+
+	for (const CollisionPair& pair : pairs)
+		m_stats.wrappedPairs += pair.shiftX != 0.0f || pair.shiftY != 0.0f;
+
+	m_stats.collisionsResolved = m_resolver.resolve({ &pairs }, m_particles, m_threadPool);
+}
+
+void SpatialHashSolver::addToParticle(std::size_t slot, float dx, float dy, float dvx, float dvy)
+{
+	m_particles.x[slot]  += dx;
+	m_particles.y[slot]  += dy;
+	m_particles.vx[slot] += dvx;
+	m_particles.vy[slot] += dvy;
+}
+
+void SpatialHashSolver::resolvePairs()
+/**
+ * Resolve the overlapping pairs in every thread's buffer (see
+ * PairResolver).
+ */
+{
+	PROFILE_SCOPE("resolvePairs");
+
+	std::size_t numPairs = 0;
+
+	m_stats.wrappedPairs = 0;
+
+	for (const ThreadData& data : m_threadData)
+	{
+		numPairs += data.pairs.size();
+		m_maxPairBuffer = std::max(m_maxPairBuffer, data.pairs.size());
+		m_stats.wrappedPairs += data.wrappedPairs;
 	}
 
-	for (std::future<void>& future : m_futures)
-		future.wait();
+	m_numResolveSteps++;
+	m_numDetectedPairs += numPairs;
+
+	m_stats.overlapsFound      = numPairs;
+	m_stats.collisionsResolved = m_resolver.resolve(m_pairBuffers, m_particles, m_threadPool);
+
+	m_numResolvedPairs += m_stats.collisionsResolved;
+	m_numResolveRounds += m_resolver.getNumRounds();
 }
 
-void SpatialHashSolver::checkCollisionsInRange(std::size_t rowLower, std::size_t rowUpper)
+std::size_t SpatialHashSolver::checkCollisionsInRange(const GridLevel& level, std::size_t rowLower, std::size_t rowUpper, ThreadData& data)
 /**
  * Check collisions between pairs of balls within cells
  * having row number in the range [rowLower, rowUpper).
+ * Returns the number of pairs tested.
  */
 {
-	for (std::size_t row = rowLower; row < std::min(rowUpper, m_numRows); row++)
+	std::size_t pairTests = 0;
+
+	for (std::size_t row = rowLower; row < std::min(rowUpper, level.numRows); row++)
 	{
-		for (std::size_t col = 0; col < m_numCols; col++)
+		for (std::size_t col = 0; col < level.numCols; col++)
 		{
-			findCollisionsInCell(m_grid[hashCell(row, col)]);
+			pairTests += findCollisionsInCell(level, row, col, data);
 		}
 	}
+
+	return pairTests;
 }
 
-void SpatialHashSolver::findCollisionsInCell(Cell& cell)
+std::size_t SpatialHashSolver::checkLevelPairInRange(const LevelPair& pair, std::size_t rowLower, std::size_t rowUpper, ThreadData& data)
+/**
+ * Check collisions between balls on pair.fromLevel whose
+ * lower-left cell has row number in [rowLower, rowUpper),
+ * and balls on pair.toLevel. Returns the number of pairs
+ * tested.
+ */
 {
-	for (std::size_t i1 = 0; i1 < cell.numBalls; i1++)
+	const GridLevel& level = m_levels[pair.fromLevel];
+	std::size_t pairTests = 0;
+
+	for (std::size_t row = rowLower; row < std::min(rowUpper, level.numRows); row++)
 	{
-		BallInfo& info1 = cell.ballList[i1];
-		for (std::size_t i2 = i1 + 1; i2 < cell.numBalls; i2++)
+		for (std::size_t col = 0; col < level.numCols; col++)
 		{
-			BallInfo& info2 = cell.ballList[i2];
-			if (overlap(info1, info2))
-				resolveCollision(info1, info2);
+			std::size_t cell = hashCell(level, row, col);
+
+			for (std::uint32_t entry = m_grid.cellStart[cell]; entry < m_grid.cellEnd[cell]; entry++)
+			{
+				pairTests += findCollisionsWithLevel(m_grid.entries[entry].ballID, m_levels[pair.toLevel], data);
+			}
 		}
 	}
+
+	return pairTests;
 }
 
-bool SpatialHashSolver::overlap(BallInfo& info1, BallInfo& info2)
+std::size_t SpatialHashSolver::findCollisionsInCell(const GridLevel& level, std::size_t row, std::size_t col, ThreadData& data)
+/**
+ * Check the balls in a cell against each other and against
+ * the balls in its half-shell of neighbours. The IDs, radii 
+ * and positions (each translated to its image nearest the
+ * cell's centre) of the balls in the cell, followed by those
+ * of its neighbours, are gathered into contiguous arrays so
+ * that each ball in the cell can be tested against every
+ * later ball in batches with overlapBatch(). Overlapping 
+ * pairs are added to the thread's pair buffer, or when 
+ * building neighbour lists (with radii including the 
+ * margin), to the band's list. Returns the number of pairs
+ * tested.
+ */
 {
-	Ball& ball1 = m_balls[info1.ballID];
-	Ball& ball2 = m_balls[info2.ballID];
+	const std::size_t cell = hashCell(level, row, col);
+	const std::size_t numHome = m_grid.numBalls(cell);
 
-	Vec2<float> translate1 = offsetToTranslate(info1.offset);
-	Vec2<float> translate2 = offsetToTranslate(info2.offset);
+	data.occupancy[std::min(numHome, SolverStats::OCCUPANCY_BINS - 1)]++;
+	data.maxCellBalls = std::max(data.maxCellBalls, numHome);
 
-	float& radius1 = m_ballTypes[ball1.typeindex].radius;
-	float& radius2 = m_ballTypes[ball2.typeindex].radius;
+	if (numHome == 0)
+		return 0;
 
-	return distSquared(ball1.position + translate1, ball2.position + translate2) <= (radius1 + radius2) * (radius1 + radius2);
-}
+	const int numRows = static_cast<int>(level.numRows);
+	const int numCols = static_cast<int>(level.numCols);
+	const int rowInt  = static_cast<int>(row);
+	const int colInt  = static_cast<int>(col);
 
-Vec2<float> SpatialHashSolver::offsetToTranslate(Offset& offset)
-{
-	switch (offset)
+	const std::size_t shell[5] = {
+		cell,
+		hashCell(level, row, static_cast<std::size_t>(wrapIndex(colInt + 1, numCols))),
+		hashCell(level, static_cast<std::size_t>(wrapIndex(rowInt + 1, numRows)), static_cast<std::size_t>(wrapIndex(colInt - 1, numCols))),
+		hashCell(level, static_cast<std::size_t>(wrapIndex(rowInt + 1, numRows)), col),
+		hashCell(level, static_cast<std::size_t>(wrapIndex(rowInt + 1, numRows)), static_cast<std::size_t>(wrapIndex(colInt + 1, numCols)))
+	};
+
+	std::size_t numBalls = 0;
+	for (std::size_t shellCell : shell)
+		numBalls += m_grid.numBalls(shellCell);
+
+	if (numBalls < 2)
+		return 0;
+
+	if (data.xs.size() < numBalls)
+	{
+		data.ids.resize(numBalls);
+		data.xs.resize(numBalls);
+		data.ys.resize(numBalls);
+		data.rs.resize(numBalls);
+	}
+
+	std::uint32_t* ids = data.ids.data();
+	float* xs = data.xs.data();
+	float* ys = data.ys.data();
+	float* rs = data.rs.data();
+
+	const float centreX = m_world.xMin + (static_cast<float>(col) + 0.5f) / level.colsPerUnit;
+	const float centreY = m_world.yMin + (static_cast<float>(row) + 0.5f) / level.rowsPerUnit;
+
+	std::size_t k = 0;
+
+	for (std::size_t shellCell : shell)
+	{
+		for (std::uint32_t entry = m_grid.cellStart[shellCell]; entry < m_grid.cellEnd[shellCell]; entry++, k++)
+		{
+			std::uint32_t id = m_grid.entries[entry].ballID;
+			ids[k] = id;
+			xs[k]  = m_particles.x[id] + imageShift(m_particles.x[id] - centreX, m_world.xWidth);
+			ys[k]  = m_particles.y[id] + imageShift(m_particles.y[id] - centreY, m_world.yWidth);
+			rs[k]  = m_particles.radius[id] + m_inflate;
+		}
+	}
+
+	for (std::size_t i1 = 0; i1 < numHome; i1++)
 	{
-		case NONE:       return Vec2<float>{           0.0f,            0.0f}; break;
-		case LEFT:       return Vec2<float>{-m_world.xWidth,            0.0f}; break;
-		case RIGHT:      return Vec2<float>{ m_world.xWidth,            0.0f}; break;
-		case DOWN:       return Vec2<float>{           0.0f, -m_world.yWidth}; break;
-		case DOWN_LEFT:  return Vec2<float>{-m_world.xWidth, -m_world.yWidth}; break;
-		case DOWN_RIGHT: return Vec2<float>{ m_world.xWidth, -m_world.yWidth}; break;
-		case UP:         return Vec2<float>{           0.0f,  m_world.yWidth}; break;
-		case UP_LEFT:    return Vec2<float>{-m_world.xWidth,  m_world.yWidth}; break;
-		case UP_RIGHT:   return Vec2<float>{ m_world.xWidth,  m_world.yWidth}; break;
+		const std::uint32_t id1 = ids[i1];
+
+		// Test against later balls in the cell and every ball in the half-shell, up to 32 at a time
+		for (std::size_t batch = i1 + 1; batch < numBalls; batch += 32)
+		{
+			std::size_t count = std::min<std::size_t>(32, numBalls - batch);
+			std::uint32_t mask = overlapBatch(xs[i1], ys[i1], rs[i1], xs + batch, ys + batch, rs + batch, count);
+
+			for (std::size_t bit = 0; mask != 0; bit++, mask >>= 1)
+			{
+				if ((mask & 1u) == 0)
+					continue;
+
+				const std::uint32_t id2 = ids[batch + bit];
+
+				if (data.neighbours)
+				{
+					data.neighbours->push_back({ id1, id2 });
+				}
+				else
+				{
+					Vec2<float> shift = nearestImageShift(id1, id2);
+					data.pairs.push_back({ id1, id2, shift.x, shift.y });
+					data.wrappedPairs += shift.x != 0.0f || shift.y != 0.0f;
+				}
+			}
+		}
 	}
 
-	return Vec2<float>{0.0f, 0.0f};
+	return numHome * (numHome - 1) / 2 + numHome * (numBalls - numHome);
+}
+
+std::size_t SpatialHashSolver::findCollisionsWithLevel(std::size_t ballID, const GridLevel& level, ThreadData& data)
+/**
+ * Check collisions between a ball and the balls on another
+ * level whose centres lie in the cells that its bounding box,
+ * grown by the largest radius on that level, touches. 
+ * Returns the number of pairs tested.
+ */
+{
+	std::size_t pairTests = 0;
+
+	const float& x     = m_particles.x[ballID];
+	const float& y     = m_particles.y[ballID];
+	const float  reach = m_particles.radius[ballID] + m_inflate + level.maxRadius;
+
+	forEachCellOfBox(level, yPosToRow(level, y - reach), yPosToRow(level, y + reach), xPosToCol(level, x - reach), xPosToCol(level, x + reach),
+		[this, ballID, &level, &pairTests, &data](std::size_t row, std::size_t col)
+		{
+			const std::uint32_t id1 = static_cast<std::uint32_t>(ballID);
+			std::size_t cell = hashCell(level, row, col);
+
+			pairTests += m_grid.numBalls(cell);
+
+			for (std::uint32_t entry = m_grid.cellStart[cell]; entry < m_grid.cellEnd[cell]; entry++)
+			{
+				const std::uint32_t id2 = m_grid.entries[entry].ballID;
+				Vec2<float> shift = nearestImageShift(id1, id2);
+
+				if (data.neighbours)
+				{
+					if (withinSkin(id1, id2, shift))
+						data.neighbours->push_back({ id1, id2 });
+				}
+				else if (Solver::overlap(id1, id2, shift))
+				{
+					data.pairs.push_back({ id1, id2, shift.x, shift.y });
+					data.wrappedPairs += shift.x != 0.0f || shift.y != 0.0f;
+				}
+			}
+		}
+	);
+
+	return pairTests;
+}
+
+float SpatialHashSolver::imageShift(float delta, float width)
+{
+	const float half = 0.5f * width;
+
+	return width * (static_cast<float>(delta < -half) - static_cast<float>(delta > half));
 }
 
-void SpatialHashSolver::resolveCollision(BallInfo& info1, BallInfo& info2)
+Vec2<float> SpatialHashSolver::nearestImageShift(std::size_t i1, std::size_t i2)
 {
-	std::lock_guard<std::mutex> lock(m_mutex); // Prevent simultaneously editing balls in different threads
+	return Vec2<float>{
+		imageShift(m_particles.x[i1] - m_particles.x[i2], m_world.xWidth),
+		imageShift(m_particles.y[i1] - m_particles.y[i2], m_world.yWidth)
+	};
+}
 
-	Ball& ball1 = m_balls[info1.ballID];
-	Ball& ball2 = m_balls[info2.ballID];
-	
-	Vec2<float> translate1 = offsetToTranslate(info1.offset);
-	Vec2<float> translate2 = offsetToTranslate(info2.offset);
-	
-	ball1.position += translate1;
-	ball2.position += translate2;
+bool SpatialHashSolver::withinSkin(std::size_t i1, std::size_t i2, Vec2<float> shift)
+/**
+ * Test whether the gap between two balls is no more than 
+ * the neighbour list margin.
+ */
+{
+	float dx = m_particles.x[i1] + shift.x - m_particles.x[i2];
+	float dy = m_particles.y[i1] + shift.y - m_particles.y[i2];
+	float reach = m_particles.radius[i1] + m_particles.radius[i2] + m_skin;
 
-	Solver::resolveCollision(ball1, ball2);
+	return dx * dx + dy * dy <= reach * reach;
+}
 
-	ball1.position -= translate1;
-	ball2.position -= translate2;
+int SpatialHashSolver::wrapIndex(int index, int count)
+{
+	return index + count * (static_cast<int>(index < 0) - static_cast<int>(index >= count));
 }
 
+std::size_t SpatialHashSolver::hashCell(const GridLevel& level, std::size_t row, std::size_t col)
+{
+	std::size_t cell = level.cellOffset + row * level.numCols + col;
+
+	return m_grid.cellIndex.empty() ? cell : m_grid.cellIndex[cell];
+}
 
-std::size_t SpatialHashSolver::hashCell(std::size_t row, std::size_t col)
+std::size_t SpatialHashSolver::bandToRow(const GridLevel& level, std::size_t band, std::size_t numBands)
 {
-	return row * m_numCols + col;
+	return band * level.numRows / numBands;
 }
 
-int SpatialHashSolver::yPosToRow(float y)
+int SpatialHashSolver::yPosToRow(const GridLevel& level, float y)
 {
-	return static_cast<int>(
-		std::floor(
-			((y - m_world.yMin) / m_world.yWidth) * static_cast<float>(m_numRows)
-		)
-	);
+	float row = (y - m_world.yMin) * level.rowsPerUnit;
+	int   rowTruncated = static_cast<int>(row);
+
+	return rowTruncated - (row < static_cast<float>(rowTruncated)); // Floor without calling std::floor
 }
 
-int SpatialHashSolver::xPosToCol(float x)
+int SpatialHashSolver::xPosToCol(const GridLevel& level, float x)
 {
-	return static_cast<int>(
-		std::floor(
-			((x - m_world.xMin) / m_world.xWidth) * static_cast<float>(m_numCols)
-		)
-	);
-}
\ No newline at end of file
+	float col = (x - m_world.xMin) * level.colsPerUnit;
+	int   colTruncated = static_cast<int>(col);
+
+	return colTruncated - (col < static_cast<float>(colTruncated)); // Floor without calling std::floor
+}
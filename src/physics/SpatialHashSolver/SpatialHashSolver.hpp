@@ -1,62 +1,368 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+#include <functional>
 #include <future>
-#include <mutex>
+#include <string>
 
 #include "Solver.hpp"
+#include "ThreadPool.hpp"
+#include "PairResolver.hpp"
 
 #include "Cell.hpp"
+#include "GridStats.hpp"
 
 
 /**
  * A derived class of Solver implementing a spatial hash 
  * algorithm.
  * 
- * The world space is subdivided into a grid of cells.
- * At the beginning of each frame, each cell in the grid
- * is populated with the balls it shares x- and y-overlaps 
- * with, including whether how the ball must be translated to 
- * reach that position. Collisions between balls are then 
- * checked for pairs of balls in each cell.
+ * The world space is subdivided into a grid of cells, each
+ * at least as wide as the largest ball. At the beginning of
+ * each frame, every ball is placed in the cell containing
+ * its centre. Two balls can then only overlap if their cells
+ * are the same or adjacent, so each cell is checked against
+ * itself and a half-shell of neighbours: the next cell in 
+ * its row and the three cells of the next row, wrapping 
+ * around the edges of the world. Every pair of adjacent cells
+ * is checked exactly once, so each pair of balls is tested
+ * once per step. Separations are measured to the nearest 
+ * image of the other ball (the minimum image convention), 
+ * which is computed without branches, so pairs across the 
+ * edges of the world cost the same as any other. Levels have
+ * at least three cells across, so balls must be smaller than
+ * a third of the world.
+ * 
+ * To cope with balls of very different sizes, the grid has
+ * several levels. BallTypes are sorted by radius and grouped
+ * so that radii on a level differ by at most a factor of two,
+ * and each level's cells are sized to its largest ball (or 
+ * so the level has about as many cells as there are balls,
+ * if larger). Pairs on the same level are found in that 
+ * level's cells, while pairs across levels are found by
+ * looking up each ball on one level in the cells of the other
+ * within reach of its bounding box (grown by the other level's
+ * largest radius). Either level of a pair may do the looking 
+ * up: whichever is estimated to visit fewer cells, which is
+ * usually the coarse level when it holds only a few balls. 
+ * 
+ * The grid is rebuilt each frame as a counting sort: each
+ * thread counts the entries its balls add to each cell in
+ * its own histogram, a prefix sum over the histograms gives 
+ * every thread its own write position in every cell, and the
+ * entries are then scattered without any synchronisation.
+ * Counting is fused with updating positions: at the end of
+ * each step, threads move their balls in blocks small enough
+ * to stay in cache, and find the new cell of each ball of a
+ * block straight after moving it, so the positions are only
+ * streamed through once. Histogram counts are stamped with
+ * an epoch that advances each time balls are binned, held in
+ * the high bits of the count so the histograms stay as small
+ * as possible, and counts from earlier epochs are ignored
+ * rather than cleared.
+ * 
+ * When the preset enables the incremental grid, the grid is
+ * instead kept from step to step, with spare room after each
+ * cell. Threads compare the cell of each of their balls with
+ * the cell it was filed in, adding the balls that changed
+ * cell to their own move lists (again while updating 
+ * positions). Each ball is then swapped out of its old cell
+ * and appended to its new one. Once there are at least
+ * PARALLEL_MOVE_SIZE moves, they are applied in parallel,
+ * each thread taking every ball out of its own range of
+ * cells and then adding every ball to it, so no entry is
+ * written by two threads. Fewer moves are applied on one
+ * thread, where splitting them would cost more than it
+ * saves. A move into a full cell is left to the calling
+ * thread, which moves the cell to the end of the entries
+ * with twice the room. The grid is
+ * only rebuilt in full (with fresh spare room, and cells back
+ * in order) once the unused entries left behind outnumber 
+ * the balls, or when the balls are reordered or the 
+ * resolution changes.
  * 
  * Multithreading is used to split populating and collision
- * checking across threads.
+ * checking across threads. The threads are owned by a
+ * ThreadPool created once on construction, with the thread
+ * count taken from the preset.
+ * 
+ * The large arrays are BigArrays, whose pages are placed on
+ * the NUMA node of the thread that first writes them, and
+ * each part of them is first written by the thread that
+ * handles it every step: histograms by their own thread, the
+ * cell offsets by the thread owning each chunk of cells, and
+ * the cells of balls by the thread moving the balls. When the
+ * preset pins threads to CPUs, the balls are copied on
+ * construction so that each thread first writes the range it
+ * moves, as it does whenever balls are reordered. Each thread
+ * then works next to its own memory, apart from the balls of
+ * neighbouring cells read while checking collisions.
+ * 
+ * Collisions are found and resolved in two phases. Checking 
+ * only reads ball data, so the rows of each level are split 
+ * into bands which threads take from a shared counter, each
+ * thread appending the overlapping pairs it finds (with their
+ * translations) to its own buffer. The buffers are then
+ * resolved by a PairResolver, in rounds in which no ball
+ * appears twice.
+ * 
+ * When auto-tuning is enabled in the preset, the solver records
+ * cell entries, pair tests and phase timings each step. Every 
+ * AUTOTUNE_INTERVAL steps, a background task fits a simple cost
+ * model to these measurements (time per entry, per pair test and
+ * per cell, with the measured clustering of each level) and
+ * predicts the cost of other cell sizes. If another size is
+ * predicted to be cheaper by a clear margin, the task also 
+ * allocates the new grid arrays, so that switching at the start
+ * of a later step is only a swap. Statistics, including the
+ * chosen resolution and the reason for it, are available from
+ * getGridStats(). Each thread also counts the pairs it tests
+ * and finds and the occupancy of the cells it checks, which
+ * are summed into the step's SolverStats (see getStats()),
+ * along with the time taken by each phase of the step.
+ * 
+ * When the preset sets a reorder interval, the cells of each
+ * level are stored in Morton (Z-curve) order rather than 
+ * row-major order, and every reorderInterval steps the balls
+ * of each BallType are sorted by the Morton order of the cell
+ * containing their centre. Balls close in space then lie close
+ * in memory, so the gathers made while checking a cell touch
+ * few cache lines. Balls stay grouped by BallType, and keep 
+ * their IDs (see Solver::getSlot()).
+ * 
+ * When the preset sets a neighbour skin, the grid is only
+ * used to build neighbour lists: every ball's bounding box
+ * is grown by half the skin, and instead of resolving the
+ * overlaps found, each check records the pairs within the
+ * skin of touching in a list for its band. Each step then
+ * collects the overlapping pairs of the lists into the pair
+ * buffers and resolves them as above. The lists
+ * are rebuilt once any ball has moved more than half the 
+ * skin since they were built (so no pair can have closed
+ * the gap unseen), or when balls are reordered. Separations
+ * are measured to the nearest image, so the skin plus the
+ * two largest diameters must be under half the world. Grid
+ * auto-tuning is disabled in this mode.
  */
 
 class SpatialHashSolver : public Solver
 {
 public:
 	SpatialHashSolver(Preset preset);
+	SpatialHashSolver(Preset preset, const World& world, Particles particles);
+
+	GridStats getGridStats() const;
+
+	void setParticles(const Particles& particles); // Replace the particles (grouped by BallType), keeping the grid resolution
+
+	// The steps of solve() for a caller choosing which pairs to resolve (e.g. DomainSolver, which
+	// leaves some to other ranks). The preset must disable auto-tuning, reordering and neighbour lists
+	void findPairs(std::vector<CollisionPair>& pairs);                  // Collect every overlapping pair of the current positions
+	void resolveSelectedPairs(const std::vector<CollisionPair>& pairs); // Resolve pairs found by findPairs(), in order
+	void addToParticle(std::size_t slot, float dx, float dy, float dvx, float dvy); // Add on a change made elsewhere between resolves
 
 private:
-	std::vector<Cell> m_grid;
-	std::size_t       m_numRows;
-	std::size_t       m_numCols;
+	CellGrid                   m_grid;
+	std::vector<GridLevel>     m_levels;      // Ordered from finest to coarsest
+	std::vector<LevelPair>     m_levelPairs;  // Every pair of distinct levels
+	std::vector<std::size_t>   m_levelOfType; // Level of each BallType in m_ballTypes
+	std::vector<std::size_t>   m_typeStart;   // Index of the first ball of each BallType in m_particles (one extra for the end)
+
+	BigArray<std::uint32_t>    m_ballCell;    // Cell containing the centre of each ball
+	BigArray<std::uint32_t>    m_ballEntry;   // Position of each ball in m_grid.entries (incremental grid only)
+
+	// Incremental grid data
+	bool        m_incremental;
+	bool        m_gridValid;        // Whether m_grid holds every ball, so can be updated incrementally
+	std::size_t m_numGridUpdates;
+	std::size_t m_numCellCrossings;
+	std::size_t m_numFullRebuilds;
+	std::size_t m_numUnusedEntries; // Entries left behind by cells moved to the end of m_grid.entries
+
+	// Binning data, filled while updating positions
+	std::uint32_t m_binEpoch;    // Epoch of the latest cell counts
+	std::uint32_t m_numEpochs;   // Epochs that fit in a count's stamp bits
+	std::uint32_t m_countMask;   // Bits of a histogram count holding the count (the rest hold its stamp)
+	std::uint32_t m_binStamp;    // Stamp bits of counts made in the current epoch
+	bool          m_cellsBinned; // Whether m_ballCell and the cell counts match the current positions
+	bool          m_movesFound;  // Whether the move lists match the current positions
+
+	static const std::size_t INTEGRATE_BLOCK_SIZE = 1024; // Balls moved and binned together while updating positions
+
+	// Per-thread working data
+	struct ThreadData
+	{
+		std::vector<CellMove>      moves;      // Balls that changed cell (incremental grid only)
+		std::vector<CellMove>      fullMoves;  // Moves into this thread's cells that found them full
+		BigArray<std::uint32_t>    cellCounts; // Histogram of entries per cell (stamped, see advanceBinEpoch()), then write positions
+		std::size_t                chunkTotal; // Number of entries in this thread's chunk of cells
+
+		// Gathered IDs, positions and radii of the balls in the cell being checked and its half-shell
+		std::vector<std::uint32_t> ids;
+		std::vector<float> xs;
+		std::vector<float> ys;
+		std::vector<float> rs;
+
+		// Work done this step
+		std::vector<std::size_t> pairTests;      // Per level
+		std::size_t              crossPairTests; // Between levels
+		std::size_t              listPairTests;  // Neighbour list pairs tested
+		std::size_t              wrappedPairs;   // Overlapping pairs across the edges of the world
+		std::vector<std::size_t> occupancy;      // Cells checked by number of balls held (see SolverStats)
+		std::size_t              maxCellBalls;
+
+		std::vector<CollisionPair> pairs; // Overlapping pairs found this step
+
+		// Neighbour list working data
+		std::vector<NeighbourPair>* neighbours = nullptr; // List of the band being checked, while building neighbour lists
+		float                       maxDisplacement = 0.0f;
+	};
+	std::vector<ThreadData> m_threadData;
+
+	// Auto-tuning data
+	struct TuneSample // Measurements summed over the steps since the last evaluation
+	{
+		std::vector<double> entries;   // Per level
+		std::vector<double> pairTests; // Per level
+		double              crossPairTests  = 0.0;
+		double              populateSeconds = 0.0;
+		double              checkSeconds    = 0.0;
+		std::size_t         numSteps        = 0;
+	};
+
+	struct GridPlan // Result of evaluating the grid resolution
+	{
+		bool                                    changed = false;
+		float                                   cellScale;
+		std::vector<GridLevel>                  levels;
+		std::vector<LevelPair>                  levelPairs;
+		BigArray<std::uint32_t>                 cellStart;  // Allocated in advance when changed
+		std::vector<BigArray<std::uint32_t>>    cellCounts; // Allocated in advance when changed
+		std::vector<std::uint32_t>              cellIndex;  // Curve layout of the new cells, if used
+		std::string                             reason;
+	};
+
+	bool        m_autoTune;
+	float       m_cellScale;
+	TuneSample  m_tuneSample;
+	TuneSample  m_lastSample; // Last complete sample, reported by getGridStats()
+	std::size_t m_numRegrids;
+	std::string m_regridReason;
+
+	static const std::size_t AUTOTUNE_INTERVAL = 100; // Steps between evaluations of the grid resolution
+
+	// Collision resolution data
+	PairResolver                                   m_resolver;
+	std::vector<const std::vector<CollisionPair>*> m_pairBuffers; // Each thread's pairs, as passed to m_resolver
+
+	std::size_t m_numResolveSteps;
+	std::size_t m_numDetectedPairs;
+	std::size_t m_numResolvedPairs;
+	std::size_t m_numResolveRounds;
+	std::size_t m_maxPairBuffer;
+
+	static const std::size_t PARALLEL_MOVE_SIZE  = 4096; // Fewer cell crossings are applied on one thread
+	static const std::size_t BANDS_PER_THREAD    = 4;
+
+	// Neighbour list data
+	float       m_skin;               // 0 when neighbour lists are disabled
+	float       m_inflate;            // Growth of each ball's radius in the grid (half the skin)
+	bool        m_neighboursValid;
+	std::size_t m_numNeighbourBuilds;
+	std::size_t m_numNeighbourSteps;
+	BigArray<float> m_buildX;         // Positions of the balls when the lists were last built
+	BigArray<float> m_buildY;
+	std::vector<std::vector<std::vector<NeighbourPair>>> m_neighbours; // Per check pass (levels, then level pairs) and band
+
+	// Space-filling curve ordering data
+	std::size_t m_reorderInterval;   // Steps between reorderings of balls (0 disables curve ordering)
+	std::size_t m_stepsUntilReorder;
 
 	void solve() override;
+	void updatePositions(float dt) override;
+
+	void buildLevels();
+	void sizeLevels(float cellScale, const std::vector<BallType>& ballTypes, std::vector<GridLevel>& levels, std::vector<LevelPair>& levelPairs) const;
+
+	void recordSample(double populateSeconds, double checkSeconds);
+	void applyGridPlan();
+	GridPlan planGrid(const TuneSample& sample, const std::vector<GridLevel>& levels, const std::vector<BallType>& ballTypes, float cellScale) const;
 
-	void clearCells();
+	static void layoutCellsMorton(const std::vector<GridLevel>& levels, std::vector<std::uint32_t>& cellIndex);
+	void reorderParticles();
+	void placeParticles(const std::vector<std::uint32_t>& order);
 
+	void buildNeighbourLists();
+	bool neighboursMovedTooFar();
+	void resolveNeighbours();
+
+	void updateCells();
+	bool moveCells();
+	void relocateCell(std::size_t cell);
+	void findMovesInRange(std::size_t indLower, std::size_t indUpper, ThreadData& data);
 	void populateCells();
-	void populateCellsInRange(std::size_t rowLower, std::size_t rowUpper);
+	void sizeBinStamps();
+	void clearCellCounts();
+	void advanceBinEpoch();
+	static std::uint32_t stampedCount(std::uint32_t cellCount, std::uint32_t countMask, std::uint32_t binStamp); // Count held by a histogram entry (0 if stale)
+	std::size_t centreCell(const GridLevel& level, std::size_t ballID);
+	std::uint32_t cellSlack(std::uint32_t numEntries) const; // Spare room left after a cell of numEntries entries
+	void countCellsInRange(std::size_t indLower, std::size_t indUpper, ThreadData& data);
+	void populateCellsInRange(std::size_t indLower, std::size_t indUpper, ThreadData& data);
 
 	void checkCollisions();
-	void checkCollisionsInRange(std::size_t rowLower, std::size_t rowUpper);
+	void resolvePairs();
+	void checkBands(std::size_t numBands, const std::function<void(std::size_t, ThreadData&)>& checkBand);
+	// These return the number of pairs of balls tested
+	std::size_t checkCollisionsInRange(const GridLevel& level, std::size_t rowLower, std::size_t rowUpper, ThreadData& data);
+	std::size_t checkLevelPairInRange(const LevelPair& pair, std::size_t rowLower, std::size_t rowUpper, ThreadData& data);
+
+	std::size_t findCollisionsInCell(const GridLevel& level, std::size_t row, std::size_t col, ThreadData& data);
+	std::size_t findCollisionsWithLevel(std::size_t ballID, const GridLevel& level, ThreadData& data);
 
-	void findCollisionsInCell(Cell& c1);
+	template <typename Func>
+	void forEachCellOfBox(const GridLevel& level, int rowLow, int rowHigh, int colLeft, int colRight, Func&& func);
 
 	// Methods for hashing ball positions
-	std::size_t hashCell(std::size_t row, std::size_t col);
-	int xPosToCol(float x);
-	int yPosToRow(float y);
+	std::size_t hashCell(const GridLevel& level, std::size_t row, std::size_t col);
+	std::size_t bandToRow(const GridLevel& level, std::size_t band, std::size_t numBands);
+	int xPosToCol(const GridLevel& level, float x);
+	int yPosToRow(const GridLevel& level, float y);
 
-	// Multithreading compatible methods
-	bool overlap(BallInfo& info1, BallInfo& info2);
-	Vec2<float> offsetToTranslate(Offset& offset);
-	void resolveCollision(BallInfo& info1, BallInfo& info2);
+	// Methods accounting for the wrapping of the world
+	static float imageShift(float delta, float width);   // Translation bringing a separation delta within half a width of 0
+	Vec2<float> nearestImageShift(std::size_t i1, std::size_t i2); // Translation of i1 to its image nearest i2
+	bool withinSkin(std::size_t i1, std::size_t i2, Vec2<float> shift);
+	static int wrapIndex(int index, int count);            // Wrap a row or column index into [0, count)
 
 	// Multithreading data
-	static const unsigned int NUM_THREADS = 10;
-	std::mutex m_mutex;
-	std::vector<std::future<void>> m_futures;
-};
\ No newline at end of file
+	ThreadPool m_threadPool;
+
+	// Pending evaluation of the grid resolution, running in the background
+	// (declared last so it is waited on before other members are destroyed)
+	std::future<GridPlan> m_pendingPlan;
+};
+
+template <typename Func>
+void SpatialHashSolver::forEachCellOfBox(const GridLevel& level, int rowLow, int rowHigh, int colLeft, int colRight, Func&& func)
+/**
+ * Call func(row, col) for each cell of the level in the 
+ * (unwrapped) range of rows and columns given, visiting
+ * each cell at most once.
+ */
+{
+	const int numRows = static_cast<int>(level.numRows);
+	const int numCols = static_cast<int>(level.numCols);
+
+	rowHigh  = std::min(rowHigh, rowLow + numRows - 1);
+	colRight = std::min(colRight, colLeft + numCols - 1);
+
+	for (int rowRaw = rowLow; rowRaw <= rowHigh; rowRaw++)
+	{
+		const std::size_t row = static_cast<std::size_t>(wrapIndex(rowRaw, numRows));
+
+		for (int colRaw = colLeft; colRaw <= colRight; colRaw++)
+			func(row, static_cast<std::size_t>(wrapIndex(colRaw, numCols)));
+	}
+}
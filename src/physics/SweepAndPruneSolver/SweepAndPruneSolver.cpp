@@ -0,0 +1,192 @@
+#include "SweepAndPruneSolver.hpp"
+
+#include <algorithm>
+
+SweepAndPruneSolver::SweepAndPruneSolver(Preset preset)
+	: SweepAndPruneSolver(preset, World(preset.worldAspectRatio), randomParticles(preset.ballTypes, World(preset.worldAspectRatio), preset.seed, preset.numThreads))
+{
+}
+
+SweepAndPruneSolver::SweepAndPruneSolver(Preset preset, const World& world, Particles particles)
+	: Solver(preset, world, std::move(particles)),
+	  m_threadPool(preset.numThreads)
+{
+	const std::size_t numBalls = m_particles.size();
+
+	m_order.resize(numBalls);
+	for (std::size_t i = 0; i < numBalls; i++)
+		m_order[i] = { m_particles.x[i] - m_particles.radius[i], static_cast<std::uint32_t>(i) };
+
+	std::sort(m_order.begin(), m_order.end(), [](const Entry& a, const Entry& b){ return a.xLow < b.xLow; });
+
+	m_merged.resize(numBalls);
+	m_lastX.resize(numBalls);
+	for (const Entry& entry : m_order)
+		m_lastX[entry.id] = entry.xLow;
+
+	m_sortedX.resize(numBalls);
+	m_sortedY.resize(numBalls);
+	m_sortedRadius.resize(numBalls);
+
+	m_pairs.resize(m_threadPool.size());
+	m_pairTests.resize(m_threadPool.size());
+
+	for (const std::vector<CollisionPair>& pairs : m_pairs)
+		m_pairBuffers.push_back(&pairs);
+}
+
+void SweepAndPruneSolver::solve()
+{
+	const unsigned int numThreads = m_threadPool.size();
+	const std::size_t  numBalls   = m_order.size();
+
+	sortOrder();
+
+	m_threadPool.run(
+		[this, numThreads, numBalls](unsigned int i)
+		{
+			std::size_t indLower = std::min(numBalls, i * (numBalls / numThreads + 1));
+			std::size_t indUpper = std::min(numBalls, (i + 1) * (numBalls / numThreads + 1));
+
+			m_pairs[i].clear();
+			m_pairTests[i] = findPairsInRange(indLower, indUpper, m_pairs[i]);
+		}
+	);
+
+	m_stats.pairTests     = 0;
+	m_stats.overlapsFound = 0;
+	m_stats.wrappedPairs  = 0;
+
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		m_stats.pairTests     += m_pairTests[i];
+		m_stats.overlapsFound += m_pairs[i].size();
+
+		for (const CollisionPair& pair : m_pairs[i])
+			m_stats.wrappedPairs += pair.shiftX != 0.0f || pair.shiftY != 0.0f;
+	}
+
+	m_stats.collisionsResolved = m_resolver.resolve(m_pairBuffers, m_particles, m_threadPool);
+}
+
+void SweepAndPruneSolver::sortOrder()
+/**
+ * Bring m_order up to date with the balls' current positions,
+ * and gather the sorted copies of their data.
+ */
+{
+	const float halfWidth = 0.5f * m_world.xWidth;
+
+	// Refresh keys, taking out the balls that wrapped across the left or right edge
+	m_wrapped.clear();
+
+	std::size_t kept = 0;
+
+	for (std::size_t i = 0; i < m_order.size(); i++)
+	{
+		Entry entry = m_order[i];
+		float lastX = m_lastX[entry.id];
+		entry.xLow = m_particles.x[entry.id] - m_particles.radius[entry.id];
+
+		if (entry.xLow < lastX - halfWidth || entry.xLow > lastX + halfWidth)
+			m_wrapped.push_back(entry);
+		else
+			m_order[kept++] = entry;
+	}
+
+	// Insertion sort, close to linear since the order is almost sorted
+	for (std::size_t i = 1; i < kept; i++)
+	{
+		Entry entry = m_order[i];
+		std::size_t j = i;
+
+		while (j > 0 && m_order[j - 1].xLow > entry.xLow)
+		{
+			m_order[j] = m_order[j - 1];
+			j--;
+		}
+
+		m_order[j] = entry;
+	}
+
+	// Merge the wrapped balls back in
+	if (!m_wrapped.empty())
+	{
+		auto byX = [](const Entry& a, const Entry& b){ return a.xLow < b.xLow; };
+
+		std::sort(m_wrapped.begin(), m_wrapped.end(), byX);
+		std::merge(m_order.begin(), m_order.begin() + kept, m_wrapped.begin(), m_wrapped.end(), m_merged.begin(), byX);
+		m_order.swap(m_merged);
+	}
+
+	for (std::size_t i = 0; i < m_order.size(); i++)
+	{
+		std::uint32_t id = m_order[i].id;
+
+		m_sortedX[i]      = m_particles.x[id];
+		m_sortedY[i]      = m_particles.y[id];
+		m_sortedRadius[i] = m_particles.radius[id];
+		m_lastX[id]       = m_order[i].xLow;
+	}
+}
+
+std::size_t SweepAndPruneSolver::findPairsInRange(std::size_t indLower, std::size_t indUpper, std::vector<CollisionPair>& pairs)
+/**
+ * Sweep forward from each ball in m_order with index in the
+ * range [indLower, indUpper) to the end of the order, then
+ * from its start with the balls translated by a world width,
+ * and collect the pairs that overlap.
+ */
+{
+	const std::size_t numBalls = m_order.size();
+	const float xWidth = m_world.xWidth;
+	const float yWidth = m_world.yWidth;
+	const float halfHeight = 0.5f * yWidth;
+	std::size_t pairTests = 0;
+
+	for (std::size_t k = indLower; k < indUpper; k++)
+	{
+		const float x1     = m_sortedX[k];
+		const float y1     = m_sortedY[k];
+		const float radius = m_sortedRadius[k];
+		const float reach  = x1 + radius; // Right end of the ball's extent
+
+		// Stop after one lap of the order, in case balls are large compared to the world
+		for (std::size_t step = 1; step < numBalls; step++)
+		{
+			std::size_t j = k + step;
+			float shiftX = 0.0f;
+
+			if (j >= numBalls)
+			{
+				j -= numBalls;
+				shiftX = xWidth;
+			}
+
+			if (m_order[j].xLow + shiftX > reach)
+			{
+				if (shiftX != 0.0f)
+					break;
+
+				// Balls near the left edge extend past it, so the order, translated
+				// past its end, may start before where it ends: sweep on from its start
+				step = numBalls - 1 - k;
+				continue;
+			}
+
+			pairTests++;
+
+			float dx = x1 - (m_sortedX[j] + shiftX);
+			float dy = y1 - m_sortedY[j];
+			float shiftY = (dy > halfHeight) ? -yWidth : (dy < -halfHeight) ? yWidth : 0.0f; // Nearest image in y
+			dy += shiftY;
+
+			float radiusSum = radius + m_sortedRadius[j];
+
+			if (dx * dx + dy * dy <= radiusSum * radiusSum)
+				pairs.push_back({ m_order[k].id, m_order[j].id, -shiftX, shiftY });
+		}
+	}
+
+	return pairTests;
+}
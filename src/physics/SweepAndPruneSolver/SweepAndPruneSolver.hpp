@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Solver.hpp"
+#include "ThreadPool.hpp"
+#include "PairResolver.hpp"
+
+
+/**
+ * A derived class of Solver implementing an incremental
+ * sweep and prune algorithm.
+ *
+ * Balls are kept sorted by the left end of their extent in
+ * x (their centre's x-coordinate less their radius). Since
+ * balls move little from one step to the next, the
+ * order from the previous step is almost sorted, and is
+ * restored with an insertion sort in close to linear time.
+ * Balls that wrapped across the left or right edge of the
+ * world since the last step are first taken out of the
+ * order, sorted on their own and merged back in, so that
+ * they do not have to be inserted past every other ball.
+ *
+ * Collisions are then found by sweeping through the order:
+ * each ball is paired with the balls after it whose extents
+ * in x start before its own ends, so a small ball only sweeps
+ * past its close neighbours, however large other balls are.
+ * Each sweep runs to the end of the order, then on from its
+ * start with the balls translated by a world width, so
+ * extents wrapping across the left and right edges pair up
+ * exactly once. Pairs then have their y-separation measured
+ * to the nearest image across the top and bottom edges.
+ *
+ * The sweep is split across threads, each collecting the
+ * overlapping pairs of its share of the order in its own
+ * buffer. As in SpatialHashSolver, the buffers are then
+ * resolved by a PairResolver.
+ */
+
+class SweepAndPruneSolver : public Solver
+{
+public:
+	SweepAndPruneSolver(Preset preset);
+	SweepAndPruneSolver(Preset preset, const World& world, Particles particles);
+
+private:
+	struct Entry
+	{
+		float         xLow; // Left end of the ball's extent in x
+		std::uint32_t id;   // Index of the ball in m_particles
+	};
+
+	std::vector<Entry> m_order;   // Balls sorted by the left ends of their extents
+	std::vector<Entry> m_wrapped; // Balls that wrapped across the left or right edge this step
+	std::vector<Entry> m_merged;  // The order with the wrapped balls merged back in
+	BigArray<float>    m_lastX;   // Left end of each ball's extent when last sorted
+
+	// Sorted copies of ball data, so the sweep streams through memory
+	std::vector<float> m_sortedX;
+	std::vector<float> m_sortedY;
+	std::vector<float> m_sortedRadius;
+
+	// Per-thread buffers of overlapping pairs, and the number of pairs each thread tested
+	std::vector<std::vector<CollisionPair>>        m_pairs;
+	std::vector<std::size_t>                       m_pairTests;
+	std::vector<const std::vector<CollisionPair>*> m_pairBuffers; // The buffers, as passed to m_resolver
+
+	PairResolver m_resolver;
+
+	void solve() override;
+
+	void sortOrder();
+	std::size_t findPairsInRange(std::size_t indLower, std::size_t indUpper, std::vector<CollisionPair>& pairs); // Returns the number of pairs tested
+
+	// Multithreading data
+	ThreadPool m_threadPool;
+};
@@ -0,0 +1,142 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Topology.hpp"
+#include "Profiler.hpp"
+
+ThreadPool::ThreadPool(unsigned int numThreads, bool pinThreads)
+	: m_numThreads(numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency())),
+	  m_task(nullptr),
+	  m_taskName(nullptr),
+	  m_generation(0),
+	  m_remaining(0),
+	  m_stop(false)
+{
+	if (pinThreads)
+	{
+		m_cpus = detectTopology().pinOrder(m_numThreads);
+
+		if (!pinThisThread(m_cpus[0]))
+		{
+			std::cout << "Warning: could not pin solver threads to CPUs" << std::endl;
+			m_cpus.clear();
+		}
+	}
+
+	// Thread 0 is the calling thread, so only spawn the remaining workers
+	for (unsigned int i = 1; i < m_numThreads; i++)
+	{
+		int cpu = m_cpus.empty() ? -1 : m_cpus[i];
+
+		m_workers.emplace_back([this, i, cpu]()
+		{
+			if (cpu >= 0)
+				pinThisThread(cpu);
+#ifdef TORUSPARTICLES_PROFILING
+			Profiler::setThreadName("Worker " + std::to_string(i));
+#endif
+			workerLoop(i);
+		});
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop.store(true, std::memory_order_release);
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::run(const std::function<void(unsigned int)>& task)
+{
+	m_taskName = PROFILE_CURRENT_SCOPE();
+
+	if (m_workers.empty())
+	{
+		PROFILE_TASK(m_taskName);
+		task(0);
+		return;
+	}
+
+	m_task = &task;
+	m_remaining.store(static_cast<unsigned int>(m_workers.size()), std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+	m_wakeCondition.notify_all();
+
+	{
+		PROFILE_TASK(m_taskName);
+		task(0);
+	}
+
+	// Wait for the workers, spinning first since phases are usually short
+	for (unsigned int spin = 0; spin < SPIN_COUNT; spin++)
+	{
+		if (m_remaining.load(std::memory_order_acquire) == 0)
+			return;
+		std::this_thread::yield();
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this](){ return m_remaining.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::workerLoop(unsigned int threadIndex)
+/**
+ * Wait for the generation counter to change, run the
+ * current task, then signal completion. Repeats until
+ * the pool is destroyed.
+ */
+{
+	std::size_t seenGeneration = 0;
+
+	while (true)
+	{
+		bool woken = false;
+
+		for (unsigned int spin = 0; spin < SPIN_COUNT; spin++)
+		{
+			if (m_generation.load(std::memory_order_acquire) != seenGeneration)
+			{
+				woken = true;
+				break;
+			}
+			std::this_thread::yield();
+		}
+
+		if (!woken)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, seenGeneration](){ 
+				return m_generation.load(std::memory_order_acquire) != seenGeneration; 
+			});
+		}
+
+		seenGeneration = m_generation.load(std::memory_order_acquire);
+
+		if (m_stop.load(std::memory_order_acquire))
+			return;
+
+		{
+			PROFILE_TASK(m_taskName);
+			(*m_task)(threadIndex);
+		}
+
+		if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_doneCondition.notify_one();
+		}
+	}
+}
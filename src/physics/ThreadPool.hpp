@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A long-lived pool of worker threads for running the
+ * parallel phases of a solver.
+ *
+ * The pool is created once, and each call to run() executes
+ * the same task on every thread, passing each its thread
+ * index. The calling thread takes part as thread 0, so a
+ * pool of size 1 has no workers and runs tasks inline.
+ *
+ * Between calls, workers spin briefly on a generation counter
+ * before parking on a condition variable, so back-to-back
+ * phases within a step are dispatched in microseconds without
+ * the workers burning a core while the renderer is busy.
+ *
+ * Threads can be pinned to CPUs (see Topology::pinOrder()),
+ * so each thread keeps running next to the memory it first
+ * touched. Thread 0 is then pinned too, which pins the
+ * thread creating the pool.
+ *
+ * When profiling, each thread's part of a task is timed (see
+ * Profiler), named after the scope run() was called from.
+ */
+
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int numThreads, bool pinThreads = false); // numThreads == 0 uses std::thread::hardware_concurrency()
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int size() const { return m_numThreads; }
+
+	const std::vector<int>& getCpus() const { return m_cpus; } // CPU each thread is pinned to (empty if not pinned)
+
+	// Run task(threadIndex) on every thread, returning once all have finished
+	void run(const std::function<void(unsigned int)>& task);
+
+private:
+	unsigned int             m_numThreads;
+	std::vector<std::thread> m_workers;
+	std::vector<int>         m_cpus;
+
+	const std::function<void(unsigned int)>* m_task;
+	const char*                              m_taskName; // Profiler scope the current task was dispatched from
+
+	std::atomic<std::size_t>  m_generation; // Incremented each time a task is dispatched
+	std::atomic<unsigned int> m_remaining;  // Number of workers yet to finish the current task
+	std::atomic<bool>         m_stop;
+
+	std::mutex              m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	static const unsigned int SPIN_COUNT = 2000; // Number of polls before parking on a condition variable
+
+	void workerLoop(unsigned int threadIndex);
+};
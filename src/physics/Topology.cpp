@@ -0,0 +1,183 @@
+#include "Topology.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static std::vector<int> parseCpuList(const std::string& list)
+/**
+ * Parse a list of CPUs in the kernel's format, e.g.
+ * "0-3,8-11", into the CPU numbers.
+ */
+{
+	std::vector<int> cpus;
+	std::stringstream stream(list);
+	std::string range;
+
+	while (std::getline(stream, range, ','))
+	{
+		std::size_t dash = range.find('-');
+
+		try
+		{
+			int first = std::stoi(range.substr(0, dash));
+			int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+			for (int cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		}
+		catch (const std::exception&)
+		{
+			// Skip blank or malformed ranges (an empty node's list is a blank line)
+		}
+	}
+
+	return cpus;
+}
+
+static std::string formatCpuList(const std::vector<int>& cpus)
+/**
+ * Format sorted CPU numbers as a list of ranges, e.g. "0-3,8".
+ */
+{
+	std::string list;
+
+	for (std::size_t i = 0; i < cpus.size(); )
+	{
+		std::size_t j = i;
+		while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+			j++;
+
+		if (!list.empty())
+			list += ",";
+
+		list += std::to_string(cpus[i]);
+		if (j > i)
+			list += "-" + std::to_string(cpus[j]);
+
+		i = j + 1;
+	}
+
+	return list;
+}
+
+Topology detectTopology()
+{
+	Topology topology;
+
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	bool haveAffinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+	// Node numbers may have gaps (e.g. with memory-only nodes), so read the list of nodes first
+	std::ifstream onlineFile("/sys/devices/system/node/online");
+	std::string   online;
+
+	if (std::getline(onlineFile, online))
+	{
+		for (int node : parseCpuList(online))
+		{
+			std::ifstream cpuFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			std::string   cpuList;
+			std::getline(cpuFile, cpuList);
+
+			std::vector<int> cpus;
+			for (int cpu : parseCpuList(cpuList))
+				if (!haveAffinity || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+					cpus.push_back(cpu);
+
+			if (cpus.empty())
+				continue; // No usable CPUs on this node
+
+			topology.nodes.push_back(node);
+			topology.nodeCpus.push_back(cpus);
+		}
+	}
+
+	if (topology.nodes.empty() && haveAffinity)
+	{
+		std::vector<int> cpus;
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &allowed))
+				cpus.push_back(cpu);
+
+		topology.nodes.push_back(0);
+		topology.nodeCpus.push_back(cpus);
+	}
+#endif
+
+	if (topology.nodes.empty())
+	{
+		std::vector<int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+		for (std::size_t cpu = 0; cpu < cpus.size(); cpu++)
+			cpus[cpu] = static_cast<int>(cpu);
+
+		topology.nodes.push_back(0);
+		topology.nodeCpus.push_back(cpus);
+	}
+
+	return topology;
+}
+
+std::vector<int> Topology::pinOrder(unsigned int numThreads) const
+{
+	std::size_t numCpus = 0;
+	for (const std::vector<int>& cpus : nodeCpus)
+		numCpus += cpus.size();
+
+	std::vector<int> order;
+	std::size_t cpusBefore = 0;
+
+	for (const std::vector<int>& cpus : nodeCpus)
+	{
+		// Threads [first, last) go to this node
+		std::size_t first = numThreads * cpusBefore / numCpus;
+		std::size_t last  = numThreads * (cpusBefore + cpus.size()) / numCpus;
+
+		for (std::size_t i = first; i < last; i++)
+			order.push_back(cpus[(i - first) % cpus.size()]);
+
+		cpusBefore += cpus.size();
+	}
+
+	return order;
+}
+
+std::string Topology::describe() const
+{
+	std::string description = std::to_string(nodes.size()) + (nodes.size() == 1 ? " NUMA node (" : " NUMA nodes (");
+
+	for (std::size_t i = 0; i < nodes.size(); i++)
+	{
+		if (i > 0)
+			description += ", ";
+
+		description += "node " + std::to_string(nodes[i]) + ": CPUs " + formatCpuList(nodeCpus[i]);
+	}
+
+	return description + ")";
+}
+
+bool pinThisThread(int cpu)
+{
+#ifdef __linux__
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
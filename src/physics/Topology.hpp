@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * The NUMA nodes of the machine, with the CPUs of each that
+ * this process may run on.
+ *
+ * On Linux the nodes are read from /sys/devices/system/node
+ * and intersected with the process's CPU affinity, so CPUs
+ * excluded by e.g. taskset or a cgroup are left out. Elsewhere,
+ * or if the nodes can't be read, the machine is treated as a
+ * single node holding every hardware thread.
+ */
+
+struct Topology
+{
+	std::vector<int>              nodes;    // Node numbers, in increasing order
+	std::vector<std::vector<int>> nodeCpus; // CPUs of each node, in increasing order
+
+	// CPUs to pin numThreads threads to. Threads are split between the nodes
+	// in proportion to their CPUs, in contiguous blocks, so threads handling
+	// neighbouring ranges of an array share a node
+	std::vector<int> pinOrder(unsigned int numThreads) const;
+
+	std::string describe() const; // e.g. "2 NUMA nodes (node 0: CPUs 0-7, node 1: CPUs 8-15)"
+};
+
+Topology detectTopology();
+
+// Pin the calling thread to a CPU, returning false if it could not be pinned
+bool pinThisThread(int cpu);
@@ -0,0 +1,776 @@
+#include "Trajectory.hpp"
+#include "Checkpoint.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TORUSPARTICLES_HAVE_MMAP
+#endif
+
+static_assert(sizeof(TrajectoryHeader) == 72, "TrajectoryHeader must have no implicit padding");
+static_assert(sizeof(TrajectoryFrameHeader) == 32, "TrajectoryFrameHeader must have no implicit padding");
+static_assert(sizeof(TrajectoryIndexEntry) == 24, "TrajectoryIndexEntry must have no implicit padding");
+static_assert(sizeof(TrajectoryTrailer) == 24, "TrajectoryTrailer must have no implicit padding");
+
+static const char          TRAJECTORY_MAGIC[8]         = { 'T', 'O', 'R', 'U', 'S', 'T', 'R', 'J' };
+static const char          TRAJECTORY_INDEX_MAGIC[8]   = { 'T', 'R', 'J', 'I', 'N', 'D', 'E', 'X' };
+static const std::uint32_t TRAJECTORY_BYTE_ORDER       = 0x01020304;
+static const unsigned int  TRAJECTORY_MAX_BITS         = 24; // Beyond a float's precision
+static const unsigned int  RICE_ESCAPE                 = 24; // Quotients this long are stored raw instead
+
+// Appends values of up to 32 bits to a byte array, least significant bits first
+struct BitWriter
+{
+	std::vector<std::uint8_t>& bytes;
+	std::uint64_t              buffer = 0;
+	unsigned int               numBits = 0;
+
+	BitWriter(std::vector<std::uint8_t>& output) : bytes(output) {}
+
+	void write(std::uint32_t value, unsigned int bits)
+	{
+		buffer |= static_cast<std::uint64_t>(value) << numBits;
+		numBits += bits;
+
+		while (numBits >= 8)
+		{
+			bytes.push_back(static_cast<std::uint8_t>(buffer));
+			buffer >>= 8;
+			numBits -= 8;
+		}
+	}
+
+	// Rice code: the quotient in unary (that many 1s, then a 0), then the k low bits
+	void writeRice(std::uint32_t value, unsigned int k, unsigned int rawBits)
+	{
+		std::uint32_t quotient = value >> k;
+
+		if (quotient >= RICE_ESCAPE)
+		{
+			write((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+			write(value, rawBits);
+			return;
+		}
+
+		write((1u << quotient) - 1, quotient + 1);
+		if (k > 0)
+			write(value & ((1u << k) - 1), k);
+	}
+
+	void flush()
+	{
+		if (numBits > 0)
+			bytes.push_back(static_cast<std::uint8_t>(buffer));
+
+		buffer = 0;
+		numBits = 0;
+	}
+};
+
+// Reads back what a BitWriter wrote, failing rather than reading past the end
+struct BitReader
+{
+	const std::uint8_t* next;
+	const std::uint8_t* end;
+	std::uint64_t       buffer = 0;
+	unsigned int        numBits = 0;
+	bool                failed = false;
+
+	BitReader(const std::uint8_t* data, std::size_t numBytes) : next(data), end(data + numBytes) {}
+
+	// Hold at least 56 bits, enough for a whole Rice code, unless the data runs out
+	void refill()
+	{
+		while (numBits <= 56 && next < end)
+		{
+			buffer |= static_cast<std::uint64_t>(*next++) << numBits;
+			numBits += 8;
+		}
+	}
+
+	std::uint32_t read(unsigned int bits)
+	{
+		if (numBits < bits)
+		{
+			failed = true;
+			return 0;
+		}
+
+		std::uint32_t value = static_cast<std::uint32_t>(buffer & ((std::uint64_t(1) << bits) - 1));
+		buffer >>= bits;
+		numBits -= bits;
+
+		return value;
+	}
+
+	std::uint32_t readRice(unsigned int k, unsigned int rawBits)
+	{
+		refill();
+
+		std::uint32_t quotient = 0;
+
+		while (quotient < RICE_ESCAPE && numBits > 0 && (buffer & 1) != 0)
+		{
+			buffer >>= 1;
+			numBits--;
+			quotient++;
+		}
+
+		if (quotient == RICE_ESCAPE)
+			return read(rawBits);
+
+		read(1); // The 0 ending the quotient
+		return (quotient << k) | (k > 0 ? read(k) : 0);
+	}
+};
+
+static std::uint32_t zigzag(std::uint32_t delta, unsigned int numBits)
+/**
+ * Map a change in a quantised coordinate (modulo 2^numBits)
+ * to the shortest signed step it could be, then interleave
+ * the signs (0, -1, 1, -2, 2...) so small steps either way
+ * become small values.
+ */
+{
+	const std::uint32_t half = 1u << (numBits - 1);
+	std::int32_t signedDelta = delta < half ? static_cast<std::int32_t>(delta) : static_cast<std::int32_t>(delta) - static_cast<std::int32_t>(2 * half);
+
+	return signedDelta >= 0 ? 2u * static_cast<std::uint32_t>(signedDelta) : 2u * static_cast<std::uint32_t>(-signedDelta) - 1u;
+}
+
+static std::uint32_t unzigzag(std::uint32_t value)
+{
+	return (value & 1) != 0 ? ~(value >> 1) : value >> 1; // The step, modulo 2^32
+}
+
+static unsigned int riceParameter(const std::vector<std::uint32_t>& values, unsigned int numBits)
+/**
+ * Choose the Rice parameter for a set of values: the largest
+ * k for which 2^k is at most their mean, which is close to
+ * the best for the roughly geometric spread of steps.
+ */
+{
+	std::uint64_t sum = 0;
+	for (std::uint32_t value : values)
+		sum += value;
+
+	const std::uint64_t count = values.size();
+	unsigned int k = 0;
+
+	while (k + 1 < numBits && (count << (k + 1)) <= sum)
+		k++;
+
+	return k;
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string& path, const Solver& solver, float dt, std::size_t interval,
+                                   std::size_t numTracers, unsigned int numBits, std::size_t keyframeInterval)
+	: m_file(path, std::ios::binary | std::ios::trunc),
+	  m_open(false),
+	  m_path(path),
+	  m_interval(std::max<std::size_t>(1, interval)),
+	  m_keyframeInterval(std::max<std::size_t>(1, keyframeInterval)),
+	  m_numBits(std::min(std::max(numBits, 1u), TRAJECTORY_MAX_BITS)),
+	  m_ringHead(0),
+	  m_ringTail(0),
+	  m_stop(false),
+	  m_numWritten(0),
+	  m_numDropped(0),
+	  m_numBytes(0)
+{
+	if (!m_file.is_open())
+	{
+		std::cout << "Error: could not write trajectory to \"" << path << "\"" << std::endl;
+		return;
+	}
+
+	const Particles&             particles = solver.getParticles();
+	const std::vector<BallType>& ballTypes = solver.getBallTypes();
+	const World&                 world     = solver.getWorld();
+	const std::size_t            numBalls  = particles.size();
+
+	// Tracers are spread evenly over the IDs, which number the balls of each BallType in turn
+	if (numTracers == 0 || numTracers > numBalls)
+		numTracers = numBalls;
+
+	m_ids.resize(numTracers);
+	for (std::size_t i = 0; i < numTracers; i++)
+		m_ids[i] = static_cast<std::uint32_t>(i * numBalls / numTracers);
+
+	const float levels = static_cast<float>(std::uint64_t(1) << m_numBits);
+	m_xMin   = world.xMin;
+	m_xScale = levels / world.xWidth;
+	m_yMin   = world.yMin;
+	m_yScale = levels / world.yWidth;
+
+	for (Slot& slot : m_ring)
+	{
+		slot.x.resize(numTracers);
+		slot.y.resize(numTracers);
+	}
+
+	// Header, BallTypes, then the ID and BallType of each tracer
+	TrajectoryHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+
+	header.version          = TRAJECTORY_VERSION;
+	header.byteOrder        = TRAJECTORY_BYTE_ORDER;
+	header.headerBytes      = sizeof(TrajectoryHeader);
+	header.numBits          = m_numBits;
+	header.numParticles     = numTracers;
+	header.numBallTypes     = ballTypes.size();
+	header.interval         = static_cast<std::uint32_t>(m_interval);
+	header.keyframeInterval = static_cast<std::uint32_t>(m_keyframeInterval);
+	header.dt               = dt;
+	header.worldBounds[0]   = world.xMin;
+	header.worldBounds[1]   = world.xMax;
+	header.worldBounds[2]   = world.yMin;
+	header.worldBounds[3]   = world.yMax;
+
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (const BallType& ballType : ballTypes)
+	{
+		CheckpointBallType record = toCheckpointBallType(ballType);
+		m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	}
+
+	std::vector<std::uint32_t> typeIndices(numTracers);
+	for (std::size_t i = 0; i < numTracers; i++)
+		typeIndices[i] = particles.typeindex[solver.getSlot(m_ids[i])];
+
+	m_file.write(reinterpret_cast<const char*>(m_ids.data()), static_cast<std::streamsize>(numTracers * sizeof(std::uint32_t)));
+	m_file.write(reinterpret_cast<const char*>(typeIndices.data()), static_cast<std::streamsize>(numTracers * sizeof(std::uint32_t)));
+
+	if (!m_file)
+	{
+		std::cout << "Error: could not write trajectory to \"" << path << "\"" << std::endl;
+		return;
+	}
+
+	m_numBytes = static_cast<std::uint64_t>(m_file.tellp());
+	m_open = true;
+	m_thread = std::thread(&TrajectoryWriter::writerLoop, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	close();
+}
+
+void TrajectoryWriter::record(const Solver& solver, std::uint64_t step)
+/**
+ * Quantise the tracers' positions into the next free slot of
+ * the ring, or drop the frame if there is none, so the step
+ * loop never waits for the writer.
+ */
+{
+	if (!m_open || step % m_interval != 0)
+		return;
+
+	Slot* slot = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_ringHead - m_ringTail == RING_SLOTS)
+		{
+			m_numDropped++;
+			return;
+		}
+
+		slot = &m_ring[m_ringHead % RING_SLOTS];
+	}
+
+	// Only this thread touches the slot at the head until it is queued
+	const Particles&    particles = solver.getParticles();
+	const std::uint32_t mask      = static_cast<std::uint32_t>((std::uint64_t(1) << m_numBits) - 1);
+
+	slot->step = step;
+
+	for (std::size_t i = 0; i < m_ids.size(); i++)
+	{
+		const std::size_t index = solver.getSlot(m_ids[i]);
+
+		slot->x[i] = static_cast<std::uint32_t>(static_cast<std::int64_t>((particles.x[index] - m_xMin) * m_xScale)) & mask;
+		slot->y[i] = static_cast<std::uint32_t>(static_cast<std::int64_t>((particles.y[index] - m_yMin) * m_yScale)) & mask;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_ringHead++;
+	}
+	m_condition.notify_all();
+}
+
+void TrajectoryWriter::close()
+/**
+ * Stop the writer once it has written every queued frame,
+ * then end the file with the index of its frames.
+ */
+{
+	if (!m_open)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+
+	m_thread.join();
+	m_open = false;
+
+	TrajectoryTrailer trailer;
+	std::memset(&trailer, 0, sizeof(trailer));
+	std::memcpy(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic));
+
+	trailer.indexOffset = m_numBytes;
+	trailer.numFrames   = m_index.size();
+
+	m_file.write(reinterpret_cast<const char*>(m_index.data()), static_cast<std::streamsize>(m_index.size() * sizeof(TrajectoryIndexEntry)));
+	m_file.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+	m_file.close();
+
+	if (!m_file)
+		std::cout << "Error: could not write trajectory to \"" << m_path << "\"" << std::endl;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_numBytes += m_index.size() * sizeof(TrajectoryIndexEntry) + sizeof(trailer);
+}
+
+std::size_t TrajectoryWriter::getNumWritten() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numWritten;
+}
+
+std::size_t TrajectoryWriter::getNumDropped() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numDropped;
+}
+
+std::uint64_t TrajectoryWriter::getNumBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numBytes;
+}
+
+void TrajectoryWriter::writerLoop()
+/**
+ * Write queued frames, oldest first, until stopped, then
+ * write any still queued before returning.
+ */
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_condition.wait(lock, [this]() { return m_ringTail != m_ringHead || m_stop; });
+
+		if (m_ringTail == m_ringHead)
+			return;
+
+		const Slot& slot = m_ring[m_ringTail % RING_SLOTS];
+		lock.unlock();
+
+		writeFrame(slot);
+
+		lock.lock();
+		m_ringTail++;
+		m_numWritten++;
+		m_numBytes = m_index.back().offset + sizeof(TrajectoryFrameHeader) + m_payload.size();
+	}
+}
+
+void TrajectoryWriter::writeFrame(const Slot& slot)
+/**
+ * Code a frame and append it to the file. Keyframes store the
+ * quantised coordinates in numBits bits each; other frames
+ * store each coordinate's step since the previous frame,
+ * zigzag and Rice coded (x for every particle, then y).
+ */
+{
+	const bool isKeyframe = m_index.size() % m_keyframeInterval == 0;
+
+	TrajectoryFrameHeader header;
+	std::memset(&header, 0, sizeof(header));
+
+	header.magic      = TRAJECTORY_FRAME_MAGIC;
+	header.isKeyframe = isKeyframe ? 1 : 0;
+	header.step       = slot.step;
+
+	m_payload.clear();
+	BitWriter writer(m_payload);
+
+	if (isKeyframe)
+	{
+		for (std::uint32_t x : slot.x)
+			writer.write(x, m_numBits);
+		for (std::uint32_t y : slot.y)
+			writer.write(y, m_numBits);
+	}
+	else
+	{
+		const std::uint32_t mask = static_cast<std::uint32_t>((std::uint64_t(1) << m_numBits) - 1);
+
+		const std::vector<std::uint32_t>* current[2]  = { &slot.x, &slot.y };
+		std::vector<std::uint32_t>*       previous[2] = { &m_previousX, &m_previousY };
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			// Steps are zigzagged in place of the previous coordinates, which are no longer needed
+			std::vector<std::uint32_t>& steps = *previous[axis];
+
+			for (std::size_t i = 0; i < steps.size(); i++)
+				steps[i] = zigzag(((*current[axis])[i] - steps[i]) & mask, m_numBits);
+
+			const unsigned int k = riceParameter(steps, m_numBits);
+			header.riceParameters[axis] = k;
+
+			for (std::uint32_t step : steps)
+				writer.writeRice(step, k, m_numBits);
+		}
+	}
+
+	writer.flush();
+	header.payloadBytes = m_payload.size();
+
+	m_previousX = slot.x;
+	m_previousY = slot.y;
+
+	TrajectoryIndexEntry entry;
+	entry.step       = slot.step;
+	entry.offset     = static_cast<std::uint64_t>(m_file.tellp());
+	entry.isKeyframe = isKeyframe ? 1 : 0;
+	m_index.push_back(entry);
+
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_file.write(reinterpret_cast<const char*>(m_payload.data()), static_cast<std::streamsize>(m_payload.size()));
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& path)
+	: m_data(nullptr),
+	  m_numBytes(0),
+	  m_numBits(0),
+	  m_dt(0.0f),
+	  m_world(1.0f),
+	  m_currentFrame(0),
+	  m_numDecoded(0)
+{
+	if (!open(path))
+	{
+		unmap();
+		m_index.clear();
+	}
+
+	m_currentFrame = m_index.size();
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	unmap();
+}
+
+bool TrajectoryReader::readFrame(std::size_t frame, std::vector<float>& x, std::vector<float>& y)
+/**
+ * Decode forward from the frame held, if it comes before the
+ * one asked for with no keyframe between them, or else from
+ * the last keyframe before it.
+ */
+{
+	if (frame >= m_index.size())
+		return false;
+
+	std::size_t first = frame;
+	while (first > 0 && m_index[first].isKeyframe == 0)
+		first--;
+
+	if (m_currentFrame < m_index.size() && m_currentFrame >= first && m_currentFrame <= frame)
+		first = m_currentFrame + 1;
+
+	for (std::size_t f = first; f <= frame; f++)
+	{
+		if (!decodeFrame(f))
+		{
+			m_currentFrame = m_index.size();
+			std::cout << "Error: frame " << f << " of the trajectory is corrupt" << std::endl;
+			return false;
+		}
+
+		m_currentFrame = f;
+		m_numDecoded++;
+	}
+
+	const float xStep = m_world.xWidth / static_cast<float>(std::uint64_t(1) << m_numBits);
+	const float yStep = m_world.yWidth / static_cast<float>(std::uint64_t(1) << m_numBits);
+
+	x.resize(m_ids.size());
+	y.resize(m_ids.size());
+
+	// Each position is taken from the middle of its quantisation step
+	for (std::size_t i = 0; i < m_ids.size(); i++)
+	{
+		x[i] = m_world.xMin + (static_cast<float>(m_currentX[i]) + 0.5f) * xStep;
+		y[i] = m_world.yMin + (static_cast<float>(m_currentY[i]) + 0.5f) * yStep;
+	}
+
+	return true;
+}
+
+bool TrajectoryReader::open(const std::string& path)
+/**
+ * Map the file, check its header and read everything before
+ * the frames, then the index of the frames (or, if there is
+ * none, scan the frames to build one).
+ */
+{
+#ifdef TORUSPARTICLES_HAVE_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+	{
+		std::cout << "Error: could not open trajectory \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	struct stat status;
+
+	if (fstat(fd, &status) != 0 || status.st_size <= 0)
+	{
+		::close(fd);
+		std::cout << "Error: \"" << path << "\" is not a valid trajectory (empty)" << std::endl;
+		return false;
+	}
+
+	m_numBytes = static_cast<std::size_t>(status.st_size);
+	void* mapping = mmap(nullptr, m_numBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cout << "Error: could not map trajectory \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	m_data = static_cast<const std::uint8_t*>(mapping);
+#else
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+	{
+		std::cout << "Error: could not open trajectory \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+	file.seekg(0);
+
+	if (m_buffer.empty() || !file.read(reinterpret_cast<char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size())))
+	{
+		std::cout << "Error: could not read trajectory \"" << path << "\"" << std::endl;
+		return false;
+	}
+
+	m_data     = m_buffer.data();
+	m_numBytes = m_buffer.size();
+#endif
+
+	auto fail = [&path](const std::string& reason)
+	{
+		std::cout << "Error: \"" << path << "\" is not a valid trajectory (" << reason << ")" << std::endl;
+		return false;
+	};
+
+	TrajectoryHeader header;
+
+	if (m_numBytes < sizeof(header))
+		return fail("too short");
+
+	std::memcpy(&header, m_data, sizeof(header));
+
+	if (std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0)
+		return fail("not a trajectory file");
+	if (header.byteOrder != TRAJECTORY_BYTE_ORDER)
+		return fail("written on a machine with a different byte order");
+	if (header.version != TRAJECTORY_VERSION)
+		return fail("format version " + std::to_string(header.version) + ", expected " + std::to_string(TRAJECTORY_VERSION));
+	if (header.headerBytes != sizeof(TrajectoryHeader))
+		return fail("unexpected record sizes");
+	if (header.numBits < 1 || header.numBits > TRAJECTORY_MAX_BITS)
+		return fail("invalid quantisation");
+	if (!(header.dt > 0.0f) || !(header.worldBounds[1] > header.worldBounds[0]) || !(header.worldBounds[3] > header.worldBounds[2]))
+		return fail("invalid timestep or world");
+
+	const std::size_t available = m_numBytes - sizeof(header);
+
+	if (header.numBallTypes > available / sizeof(CheckpointBallType) || header.numParticles > available / 8
+	    || header.numBallTypes * sizeof(CheckpointBallType) + header.numParticles * 8 > available)
+		return fail("sections overrun the file");
+
+	m_numBits = header.numBits;
+	m_dt      = header.dt;
+	m_world   = World(header.worldBounds[0], header.worldBounds[1], header.worldBounds[2], header.worldBounds[3]);
+
+	std::size_t offset = sizeof(header);
+
+	for (std::uint64_t i = 0; i < header.numBallTypes; i++)
+	{
+		CheckpointBallType record;
+		std::memcpy(&record, m_data + offset, sizeof(record));
+		offset += sizeof(record);
+
+		m_ballTypes.push_back(fromCheckpointBallType(record));
+	}
+
+	const std::size_t numParticles = static_cast<std::size_t>(header.numParticles);
+
+	m_ids.resize(numParticles);
+	m_typeIndices.resize(numParticles);
+	m_currentX.resize(numParticles);
+	m_currentY.resize(numParticles);
+
+	if (numParticles > 0)
+	{
+		std::memcpy(m_ids.data(), m_data + offset, numParticles * 4);
+		std::memcpy(m_typeIndices.data(), m_data + offset + numParticles * 4, numParticles * 4);
+	}
+
+	offset += numParticles * 8;
+
+	for (std::uint32_t type : m_typeIndices)
+	{
+		if (type >= m_ballTypes.size())
+			return fail("particles of unknown BallTypes");
+	}
+
+	// The index, if the file was closed properly
+	TrajectoryTrailer trailer;
+
+	if (m_numBytes - offset >= sizeof(trailer))
+	{
+		std::memcpy(&trailer, m_data + m_numBytes - sizeof(trailer), sizeof(trailer));
+
+		const std::uint64_t indexEnd = m_numBytes - sizeof(trailer);
+
+		if (std::memcmp(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic)) == 0
+		    && trailer.indexOffset >= offset && trailer.indexOffset <= indexEnd
+		    && trailer.numFrames == (indexEnd - trailer.indexOffset) / sizeof(TrajectoryIndexEntry)
+		    && (indexEnd - trailer.indexOffset) % sizeof(TrajectoryIndexEntry) == 0)
+		{
+			m_index.resize(static_cast<std::size_t>(trailer.numFrames));
+
+			if (!m_index.empty())
+				std::memcpy(m_index.data(), m_data + trailer.indexOffset, m_index.size() * sizeof(TrajectoryIndexEntry));
+
+			for (const TrajectoryIndexEntry& entry : m_index)
+			{
+				if (entry.offset < offset || entry.offset > trailer.indexOffset || trailer.indexOffset - entry.offset < sizeof(TrajectoryFrameHeader))
+					return fail("index overruns the file");
+			}
+		}
+	}
+
+	if (m_index.empty() && !scanFrames(offset))
+		return fail("no complete frames");
+
+	if (m_index[0].isKeyframe == 0)
+		return fail("first frame is not a keyframe");
+
+	return true;
+}
+
+bool TrajectoryReader::scanFrames(std::size_t offset)
+/**
+ * Follow the frames from the first, stopping at the first
+ * one that is incomplete, as the last frame of a file that
+ * was never closed may be.
+ */
+{
+	m_index.clear();
+
+	while (m_numBytes - offset >= sizeof(TrajectoryFrameHeader))
+	{
+		TrajectoryFrameHeader header;
+		std::memcpy(&header, m_data + offset, sizeof(header));
+
+		if (header.magic != TRAJECTORY_FRAME_MAGIC || header.payloadBytes > m_numBytes - offset - sizeof(header))
+			break;
+
+		TrajectoryIndexEntry entry;
+		entry.step       = header.step;
+		entry.offset     = offset;
+		entry.isKeyframe = header.isKeyframe;
+		m_index.push_back(entry);
+
+		offset += sizeof(header) + static_cast<std::size_t>(header.payloadBytes);
+	}
+
+	return !m_index.empty();
+}
+
+bool TrajectoryReader::decodeFrame(std::size_t frame)
+/**
+ * Decode a frame into m_currentX/Y, which must hold the frame
+ * before it unless it is a keyframe.
+ */
+{
+	const std::size_t offset = static_cast<std::size_t>(m_index[frame].offset);
+
+	TrajectoryFrameHeader header;
+	std::memcpy(&header, m_data + offset, sizeof(header));
+
+	if (header.magic != TRAJECTORY_FRAME_MAGIC || header.payloadBytes > m_numBytes - offset - sizeof(header))
+		return false;
+
+	BitReader reader(m_data + offset + sizeof(header), static_cast<std::size_t>(header.payloadBytes));
+	std::vector<std::uint32_t>* current[2] = { &m_currentX, &m_currentY };
+
+	if (header.isKeyframe != 0)
+	{
+		for (int axis = 0; axis < 2; axis++)
+		{
+			for (std::uint32_t& value : *current[axis])
+			{
+				reader.refill();
+				value = reader.read(m_numBits);
+			}
+		}
+	}
+	else
+	{
+		const std::uint32_t mask = static_cast<std::uint32_t>((std::uint64_t(1) << m_numBits) - 1);
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			const unsigned int k = header.riceParameters[axis];
+
+			if (k >= m_numBits)
+				return false;
+
+			for (std::uint32_t& value : *current[axis])
+				value = (value + unzigzag(reader.readRice(k, m_numBits))) & mask;
+		}
+	}
+
+	return !reader.failed;
+}
+
+void TrajectoryReader::unmap()
+{
+#ifdef TORUSPARTICLES_HAVE_MMAP
+	if (m_data != nullptr)
+		munmap(const_cast<std::uint8_t*>(m_data), m_numBytes);
+#endif
+
+	m_data = nullptr;
+	m_buffer.clear();
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+#include "BallType.hpp"
+#include "Solver.hpp"
+#include "World.hpp"
+
+/**
+ * Compressed recordings of particle positions over a run.
+ *
+ * A trajectory file holds a TrajectoryHeader, the BallTypes
+ * (as CheckpointBallTypes), the ID and BallType index of each
+ * recorded particle, then one frame after another, and ends
+ * with an index of the frames. Positions are quantised to
+ * numBits bits across the world, which wraps, so a frame is
+ * stored as the change in each quantised coordinate since the
+ * previous frame, taken modulo 2^numBits (so particles that
+ * cross an edge move a short way, not across the world).
+ * Changes are zigzag coded and then Rice coded with the
+ * parameter suiting the frame, so slow particles cost a few
+ * bits each. Every keyframeInterval frames, a keyframe stores
+ * the quantised positions themselves, so readers can start
+ * decoding there.
+ *
+ * A TrajectoryWriter records either every particle or an
+ * evenly spread subset of tracers, identified by ID. record()
+ * only quantises the positions into a slot of a bounded ring
+ * buffer. A background thread codes the frames and writes
+ * them, so the solver never waits on the disk. If the ring
+ * is full, the frame is dropped (and counted) rather than
+ * stalling the run; the frames written carry their step
+ * numbers, so a dropped frame leaves a gap.
+ *
+ * A TrajectoryReader maps a file and decodes frames on
+ * request, touching only the frames it decodes and those
+ * back to the previous keyframe. A file that was not closed
+ * (e.g. after a crash) has no index, and is read up to its
+ * last complete frame.
+ */
+
+const std::uint32_t TRAJECTORY_VERSION = 1;
+
+struct TrajectoryHeader
+{
+	char          magic[8];         // "TORUSTRJ"
+	std::uint32_t version;          // TRAJECTORY_VERSION
+	std::uint32_t byteOrder;        // 0x01020304 as written by the machine that wrote the file
+	std::uint32_t headerBytes;      // sizeof(TrajectoryHeader)
+	std::uint32_t numBits;          // Bits per quantised coordinate
+	std::uint64_t numParticles;     // Particles recorded in each frame
+	std::uint64_t numBallTypes;
+	std::uint32_t interval;         // Steps between frames
+	std::uint32_t keyframeInterval; // Frames between keyframes
+	float         dt;
+	float         worldBounds[4];   // xMin, xMax, yMin, yMax
+	std::uint32_t padding;
+};
+
+struct TrajectoryFrameHeader
+{
+	std::uint32_t magic;        // TRAJECTORY_FRAME_MAGIC
+	std::uint32_t isKeyframe;
+	std::uint64_t step;
+	std::uint64_t payloadBytes; // Coded positions following the header
+	std::uint32_t riceParameters[2]; // For x and y (unused in keyframes)
+};
+
+struct TrajectoryIndexEntry
+{
+	std::uint64_t step;
+	std::uint64_t offset;     // Of the frame header, from the start of the file
+	std::uint64_t isKeyframe;
+};
+
+struct TrajectoryTrailer
+{
+	std::uint64_t indexOffset;
+	std::uint64_t numFrames;
+	char          magic[8];   // "TRJINDEX"
+};
+
+const std::uint32_t TRAJECTORY_FRAME_MAGIC = 0x4d415246; // "FRAM"
+
+class TrajectoryWriter
+{
+public:
+	// Record numTracers particles (all of them if 0 or more than there are) every interval steps
+	TrajectoryWriter(const std::string& path, const Solver& solver, float dt, std::size_t interval,
+	                 std::size_t numTracers = 0, unsigned int numBits = 16, std::size_t keyframeInterval = 100);
+	~TrajectoryWriter(); // Writes the frames still queued, then the index
+
+	TrajectoryWriter(const TrajectoryWriter&) = delete;
+	TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+	bool        isOpen()          const { return m_open; }
+	std::size_t getNumParticles() const { return m_ids.size(); } // Particles recorded in each frame
+
+	void record(const Solver& solver, std::uint64_t step); // Queue a frame if step is a multiple of the interval
+	void close();                                          // Write the frames still queued and the index
+
+	std::size_t getNumWritten() const; // Frames written
+	std::size_t getNumDropped() const; // Frames dropped because the ring was full
+	std::uint64_t getNumBytes() const; // Bytes written so far
+
+	static const std::size_t RING_SLOTS = 8;
+
+private:
+	struct Slot
+	{
+		std::uint64_t              step;
+		std::vector<std::uint32_t> x; // Quantised coordinates of each recorded particle
+		std::vector<std::uint32_t> y;
+	};
+
+	std::ofstream              m_file;
+	bool                       m_open;
+	std::string                m_path;
+	std::vector<std::uint32_t> m_ids;   // IDs of the recorded particles
+	std::size_t                m_interval;
+	std::size_t                m_keyframeInterval;
+	unsigned int               m_numBits;
+	float                      m_xMin, m_xScale; // Quantised coordinate = (x - xMin) * xScale, modulo 2^numBits
+	float                      m_yMin, m_yScale;
+
+	// Ring buffer of frames waiting to be coded, from m_ringTail (oldest) to m_ringHead
+	Slot                       m_ring[RING_SLOTS];
+	std::size_t                m_ringHead;
+	std::size_t                m_ringTail;
+	bool                       m_stop;
+	std::size_t                m_numWritten;
+	std::size_t                m_numDropped;
+	std::uint64_t              m_numBytes;
+	mutable std::mutex         m_mutex;
+	std::condition_variable    m_condition;
+
+	// Used only by the writer thread
+	std::vector<std::uint32_t>        m_previousX; // Quantised coordinates of the last frame written
+	std::vector<std::uint32_t>        m_previousY;
+	std::vector<std::uint8_t>         m_payload;
+	std::vector<TrajectoryIndexEntry> m_index;
+
+	std::thread                m_thread;
+
+	void writerLoop();
+	void writeFrame(const Slot& slot);
+};
+
+class TrajectoryReader
+{
+public:
+	TrajectoryReader(const std::string& path); // Check isOpen() for success (errors are printed)
+	~TrajectoryReader();
+
+	TrajectoryReader(const TrajectoryReader&) = delete;
+	TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+	bool isOpen() const { return m_data != nullptr; }
+
+	std::size_t                        getNumFrames()    const { return m_index.size(); }
+	std::size_t                        getNumParticles() const { return m_ids.size(); }
+	std::uint64_t                      getStep(std::size_t frame) const { return m_index[frame].step; }
+	float                              getDt()           const { return m_dt; }
+	const World&                       getWorld()        const { return m_world; }
+	const std::vector<BallType>&       getBallTypes()    const { return m_ballTypes; }
+	const std::vector<std::uint32_t>&  getIds()          const { return m_ids; }        // ID of each recorded particle
+	const std::vector<std::uint32_t>&  getTypeIndices()  const { return m_typeIndices; } // BallType of each recorded particle
+	std::size_t                        getNumDecoded()   const { return m_numDecoded; }  // Frames decoded so far
+
+	// Decode a frame's positions, in the order of getIds(). Returns false if the frame is corrupt
+	bool readFrame(std::size_t frame, std::vector<float>& x, std::vector<float>& y);
+
+private:
+	const std::uint8_t*               m_data;
+	std::size_t                       m_numBytes;
+	std::vector<std::uint8_t>         m_buffer; // File contents, where the file can't be mapped
+
+	unsigned int                      m_numBits;
+	float                             m_dt;
+	World                             m_world;
+	std::vector<BallType>             m_ballTypes;
+	std::vector<std::uint32_t>        m_ids;
+	std::vector<std::uint32_t>        m_typeIndices;
+	std::vector<TrajectoryIndexEntry> m_index;
+
+	// Quantised coordinates of the last frame decoded, so reading forward decodes one frame
+	std::vector<std::uint32_t>        m_currentX;
+	std::vector<std::uint32_t>        m_currentY;
+	std::size_t                       m_currentFrame; // Frame held in m_currentX/Y (getNumFrames() if none)
+	std::size_t                       m_numDecoded;
+
+	bool open(const std::string& path);
+	void unmap();
+	bool scanFrames(std::size_t offset); // Index the frames from offset when the file has no index
+	bool decodeFrame(std::size_t frame);
+};
@@ -0,0 +1,134 @@
+#include "TrajectoryPlayer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+TrajectoryPlayer::TrajectoryPlayer(const std::string& path)
+	: m_reader(path),
+	  m_frame(0),
+	  m_time(0.0),
+	  m_speed(1.0f),
+	  m_paused(false),
+	  m_numShown(0)
+{
+	if (!m_reader.isOpen())
+		return;
+
+	if (m_reader.getNumFrames() == 0)
+	{
+		std::cout << "Error: trajectory \"" << path << "\" has no frames" << std::endl;
+		return;
+	}
+
+	const std::vector<std::uint32_t>& typeIndices = m_reader.getTypeIndices();
+	const std::size_t                 numParticles = typeIndices.size();
+
+	// Count the particles recorded of each BallType, then group them in file order
+	m_ballTypes = m_reader.getBallTypes();
+
+	for (BallType& ballType : m_ballTypes)
+		ballType.count = 0;
+	for (std::uint32_t type : typeIndices)
+		m_ballTypes[type].count++;
+
+	std::vector<std::size_t> nextSlot(m_ballTypes.size(), 0);
+	for (std::size_t i = 1; i < m_ballTypes.size(); i++)
+		nextSlot[i] = nextSlot[i - 1] + m_ballTypes[i - 1].count;
+
+	m_particles.resize(numParticles);
+	m_slots.resize(numParticles);
+
+	for (std::size_t i = 0; i < numParticles; i++)
+	{
+		const std::uint32_t type = typeIndices[i];
+		const std::size_t   slot = nextSlot[type]++;
+
+		m_slots[i] = slot;
+
+		m_particles.x[slot]         = 0.0f;
+		m_particles.y[slot]         = 0.0f;
+		m_particles.vx[slot]        = 0.0f;
+		m_particles.vy[slot]        = 0.0f;
+		m_particles.radius[slot]    = m_ballTypes[type].radius;
+		m_particles.invMass[slot]   = 1.0f / m_ballTypes[type].mass;
+		m_particles.typeindex[slot] = type;
+		m_particles.id[slot]        = m_reader.getIds()[i];
+	}
+
+	show(0);
+	m_time = frameTime(0);
+}
+
+void TrajectoryPlayer::advance(double seconds)
+{
+	if (!isOpen() || m_paused)
+		return;
+
+	const double start = frameTime(0);
+	const double end   = frameTime(getNumFrames() - 1);
+
+	m_time += seconds * static_cast<double>(m_speed);
+
+	if (m_time >= end || m_time <= start)
+	{
+		m_time   = std::min(std::max(m_time, start), end);
+		m_paused = true;
+	}
+
+	seekTime(m_time);
+}
+
+bool TrajectoryPlayer::seek(std::size_t frame)
+{
+	if (!isOpen())
+		return false;
+
+	frame  = std::min(frame, getNumFrames() - 1);
+	m_time = frameTime(frame);
+
+	return frame == m_frame || show(frame);
+}
+
+bool TrajectoryPlayer::seekTime(double time)
+/**
+ * Find the last frame recorded at or before the time (or the
+ * first frame, if there is none) by bisecting the frames'
+ * steps, which only reads the index.
+ */
+{
+	if (!isOpen())
+		return false;
+
+	std::size_t lower = 0, upper = getNumFrames(); // The frame lies in [lower, upper)
+
+	while (upper - lower > 1)
+	{
+		std::size_t middle = lower + (upper - lower) / 2;
+
+		if (frameTime(middle) <= time)
+			lower = middle;
+		else
+			upper = middle;
+	}
+
+	m_time = time;
+
+	return lower == m_frame || show(lower);
+}
+
+bool TrajectoryPlayer::show(std::size_t frame)
+{
+	if (!m_reader.readFrame(frame, m_x, m_y))
+		return false;
+
+	for (std::size_t i = 0; i < m_slots.size(); i++)
+	{
+		m_particles.x[m_slots[i]] = m_x[i];
+		m_particles.y[m_slots[i]] = m_y[i];
+	}
+
+	m_frame = frame;
+	m_numShown++;
+
+	return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ParticleSource.hpp"
+#include "Trajectory.hpp"
+
+/**
+ * Replays a recorded trajectory (see Trajectory.hpp) as a
+ * ParticleSource, so a Renderer can draw it just as it draws
+ * a live Solver.
+ *
+ * The file is mapped rather than read, so opening it only
+ * touches the header and the index, however long the run,
+ * and playing it only touches the frames decoded. Playback
+ * follows simulated time: advance() moves the playback time
+ * on by the wall time passed, times the speed (which may be
+ * negative, to play backwards), and shows the last frame
+ * recorded by then. Frames passed over are skipped: they are
+ * neither converted nor drawn, and are only decoded when no
+ * keyframe lies between them and the frame shown.
+ *
+ * When the trajectory only holds tracers, the BallTypes'
+ * counts are those of the tracers of each BallType.
+ */
+
+class TrajectoryPlayer : public ParticleSource
+{
+public:
+	TrajectoryPlayer(const std::string& path); // Check isOpen() for success (errors are printed)
+
+	bool isOpen() const { return m_reader.isOpen() && m_reader.getNumFrames() > 0; }
+
+	const std::vector<BallType>& getBallTypes() const override { return m_ballTypes; }
+	const Particles&             getParticles() const override { return m_particles; }
+	const World&                 getWorld()     const override { return m_reader.getWorld(); }
+
+	std::size_t   getNumFrames() const { return m_reader.getNumFrames(); }
+	std::size_t   getFrame()     const { return m_frame; }                   // Frame shown
+	std::uint64_t getStep()      const { return m_reader.getStep(m_frame); } // Step at which the frame shown was recorded
+	double        getTime()      const { return m_time; }                    // Playback time, in simulated seconds
+	std::size_t   getNumShown()  const { return m_numShown; }                // Frames shown so far
+	std::size_t   getNumDecoded() const { return m_reader.getNumDecoded(); } // Frames decoded so far, whether shown or not
+
+	float getSpeed() const { return m_speed; }
+	void  setSpeed(float speed) { m_speed = speed; } // Simulated seconds played per second (1 by default)
+	bool  isPaused() const { return m_paused; }
+	void  setPaused(bool paused) { m_paused = paused; }
+
+	void advance(double seconds);   // Move playback on by seconds of wall time, pausing at either end
+	bool seek(std::size_t frame);   // Show a frame (clamped to the last), moving playback time to it
+	bool seekTime(double time);     // Show the last frame recorded at or before a playback time
+
+private:
+	TrajectoryReader           m_reader;
+	std::vector<BallType>      m_ballTypes;
+	Particles                  m_particles;
+	std::vector<std::size_t>   m_slots;   // Index in m_particles of each particle recorded, in file order
+	std::vector<float>         m_x;       // Positions decoded, in file order
+	std::vector<float>         m_y;
+
+	std::size_t                m_frame;
+	double                     m_time;
+	float                      m_speed;
+	bool                       m_paused;
+	std::size_t                m_numShown;
+
+	double frameTime(std::size_t frame) const { return static_cast<double>(m_reader.getStep(frame)) * m_reader.getDt(); }
+	bool   show(std::size_t frame);
+};
@@ -22,4 +22,9 @@ struct World
 	World(float aspectRatio)
 		: xMin(     -std::sqrt(aspectRatio)), xMax(     std::sqrt(aspectRatio)), xWidth(2.0f*std::sqrt(aspectRatio)), xMid(0.0f),
 		  yMin(-1.0f/std::sqrt(aspectRatio)), yMax(1.0f/std::sqrt(aspectRatio)), yWidth(2.0f/std::sqrt(aspectRatio)), yMid(0.0f) {}
+
+	// A world with the given boundaries, e.g. part of a larger world
+	World(float xLower, float xUpper, float yLower, float yUpper)
+		: xMin(xLower), xMax(xUpper), xWidth(xUpper - xLower), xMid(0.5f * (xLower + xUpper)),
+		  yMin(yLower), yMax(yUpper), yWidth(yUpper - yLower), yMid(0.5f * (yLower + yUpper)) {}
 };
\ No newline at end of file
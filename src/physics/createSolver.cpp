@@ -0,0 +1,43 @@
+#include "createSolver.hpp"
+
+#include <iostream>
+
+#include "SpatialHashSolver.hpp"
+#include "EventDrivenSolver.hpp"
+#include "SweepAndPruneSolver.hpp"
+#include "BigArray.hpp"
+
+std::unique_ptr<Solver> createSolver(const Preset& preset)
+{
+	// Large arrays allocated from here on use the preset's huge pages
+	setHugePageMode(preset.hugePages);
+
+	if (preset.solver == "SpatialHash")
+		return std::make_unique<SpatialHashSolver>(preset);
+
+	if (preset.solver == "EventDriven")
+		return std::make_unique<EventDrivenSolver>(preset);
+
+	if (preset.solver == "SweepAndPrune")
+		return std::make_unique<SweepAndPruneSolver>(preset);
+
+	std::cout << "Error: unknown solver \"" << preset.solver << "\"" << std::endl;
+	return nullptr;
+}
+
+std::unique_ptr<Solver> createSolver(const Preset& preset, const World& world, Particles particles)
+{
+	setHugePageMode(preset.hugePages);
+
+	if (preset.solver == "SpatialHash")
+		return std::make_unique<SpatialHashSolver>(preset, world, std::move(particles));
+
+	if (preset.solver == "EventDriven")
+		return std::make_unique<EventDrivenSolver>(preset, world, std::move(particles));
+
+	if (preset.solver == "SweepAndPrune")
+		return std::make_unique<SweepAndPruneSolver>(preset, world, std::move(particles));
+
+	std::cout << "Error: unknown solver \"" << preset.solver << "\"" << std::endl;
+	return nullptr;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+/**
+ * A function to construct the Solver named by a Preset's
+ * "solver" setting. Recognised names are:
+ *     "SpatialHash"   (SpatialHashSolver, the default)
+ *     "EventDriven"   (EventDrivenSolver)
+ *     "SweepAndPrune" (SweepAndPruneSolver)
+ * 
+ * If the name is not recognised, an error message is printed
+ * and nullptr is returned.
+ * 
+ * The second form starts the solver from given particles in
+ * a given world (e.g. from a Checkpoint) rather than placing
+ * the preset's balls at random.
+ */
+
+#include <memory>
+
+#include "Solver.hpp"
+#include "Preset.hpp"
+
+std::unique_ptr<Solver> createSolver(const Preset& preset);
+std::unique_ptr<Solver> createSolver(const Preset& preset, const World& world, Particles particles);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <cstdint>
 
 #include "BallType.hpp"
 
@@ -14,6 +16,16 @@ struct Preset
     float dt;
     float worldAspectRatio;
     bool antialiasing;
+    std::string solver = "SpatialHash"; // Name of the Solver to use (see createSolver())
+    unsigned int numThreads = 0; // Solver threads (0 uses std::thread::hardware_concurrency())
+    bool autoTuneGrid = true;    // Let the solver adjust its grid resolution while running
+    unsigned int reorderInterval = 0; // Steps between sorting particles along a space-filling curve (0 never sorts)
+    float neighbourSkin = 0.0f;  // Margin of the solver's neighbour lists (0 disables them)
+    bool incrementalGrid = false; // Only move balls that changed cell, rather than rebuilding the grid every step
+    bool pinThreads = false;     // Pin solver threads to CPUs, and have each thread first touch its share of the arrays
+    std::string hugePages = "off"; // Backing of large arrays: "off", "thp" (transparent huge pages) or "hugetlb"
+    unsigned int statsInterval = 0; // Steps between logging the solver's work counters (0 never logs)
+    std::uint64_t seed = 0;      // Seed for the initial particles (the same seed always gives the same particles)
     std::vector<BallType> ballTypes;
 
     bool loadSuccessful = false;
@@ -0,0 +1,361 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// A timed scope, as recorded by the thread it ran on
+struct ProfileEvent
+{
+	const char*  name;
+	std::int64_t start;
+	std::int64_t end;
+	bool         isTask;
+};
+
+// Events of one thread since the last frame, appended to only by that thread
+struct ThreadLog
+{
+	std::string               name;
+	std::size_t               index; // Thread ID in traces
+	std::vector<ProfileEvent> events;
+};
+
+// An event kept for a trace
+struct TraceEvent
+{
+	const char*  name;
+	std::size_t  thread;
+	std::int64_t start;
+	std::int64_t end;
+	bool         isTask;
+};
+
+// Recent frames of one phase
+struct PhaseHistory
+{
+	std::deque<double> seconds;   // Time spent per frame
+	std::deque<double> imbalance; // Busiest thread's task time over the mean thread's, per frame
+};
+
+static std::atomic<bool> s_enabled(false);
+static const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+
+static std::mutex                              s_mutex; // Guards everything below
+static std::vector<std::unique_ptr<ThreadLog>> s_logs;  // Kept after their threads exit, so pointers stay valid
+static std::map<std::string, PhaseHistory>     s_history;
+static std::size_t                             s_frame = 0;
+static std::int64_t                            s_frameStart = 0;
+
+static std::string             s_tracePath;
+static std::size_t             s_traceFirst = 0;
+static std::size_t             s_traceCount = 0;
+static std::vector<TraceEvent> s_traceEvents;
+
+static thread_local ThreadLog*  t_log   = nullptr;
+static thread_local const char* t_scope = nullptr;
+
+static ThreadLog& threadLog()
+{
+	if (t_log == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+
+		s_logs.push_back(std::make_unique<ThreadLog>());
+		t_log = s_logs.back().get();
+		t_log->index = s_logs.size() - 1;
+		t_log->name  = "Thread " + std::to_string(t_log->index);
+	}
+
+	return *t_log;
+}
+
+static void pushRecent(std::deque<double>& values, double value)
+{
+	values.push_back(value);
+
+	if (values.size() > Profiler::WINDOW_FRAMES)
+		values.pop_front();
+}
+
+static double percentile(std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0.0;
+
+	std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+	return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+static void writeTrace()
+/**
+ * Write the kept events to s_tracePath as Chrome trace events:
+ * a complete ("X") event per scope, with times in microseconds,
+ * and a metadata ("M") event naming each thread.
+ */
+{
+	std::ofstream file(s_tracePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Error: could not write trace to \"" << s_tracePath << "\"" << std::endl;
+		return;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << std::fixed << std::setprecision(3);
+
+	bool first = true;
+
+	for (const std::unique_ptr<ThreadLog>& log : s_logs)
+	{
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->index
+		     << ",\"args\":{\"name\":\"" << log->name << "\"}}";
+		first = false;
+	}
+
+	for (const TraceEvent& event : s_traceEvents)
+	{
+		file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.isTask ? "task" : "phase")
+		     << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+		     << ",\"ts\":" << static_cast<double>(event.start) * 1e-3
+		     << ",\"dur\":" << static_cast<double>(event.end - event.start) * 1e-3 << "}";
+	}
+
+	file << "\n]}\n";
+
+	std::cout << "Wrote " << s_traceEvents.size() << " events from frames " << s_traceFirst << " to "
+	          << s_traceFirst + s_traceCount - 1 << " to \"" << s_tracePath << "\"" << std::endl;
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	if (enabled && !s_enabled.load())
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_frameStart = now();
+	}
+
+	s_enabled.store(enabled);
+}
+
+bool Profiler::isEnabled()
+{
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+	ThreadLog& log = threadLog();
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	log.name = name;
+}
+
+void Profiler::nextFrame()
+/**
+ * Total the time each phase took this frame, on every thread,
+ * and for tasks find each thread's share, keeping the events
+ * if the frame is being traced.
+ */
+{
+	if (!isEnabled())
+		return;
+
+	const std::int64_t frameEnd = now();
+	ThreadLog& frameLog = threadLog();
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	const bool tracing = !s_tracePath.empty() && s_frame >= s_traceFirst && s_frame < s_traceFirst + s_traceCount;
+
+	std::map<std::string, double>                             phaseSeconds;
+	std::map<std::string, std::map<std::size_t, double>>      taskSeconds; // By name, then thread
+
+	for (const std::unique_ptr<ThreadLog>& log : s_logs)
+	{
+		for (const ProfileEvent& event : log->events)
+		{
+			double seconds = static_cast<double>(event.end - event.start) * 1e-9;
+
+			if (event.isTask)
+				taskSeconds[event.name][log->index] += seconds;
+			else
+				phaseSeconds[event.name] += seconds;
+
+			if (tracing)
+				s_traceEvents.push_back({ event.name, log->index, event.start, event.end, event.isTask });
+		}
+
+		log->events.clear();
+	}
+
+	if (tracing)
+		s_traceEvents.push_back({ "Frame", frameLog.index, s_frameStart, frameEnd, false });
+
+	for (const std::pair<const std::string, double>& phase : phaseSeconds)
+		pushRecent(s_history[phase.first].seconds, phase.second);
+
+	for (const std::pair<const std::string, std::map<std::size_t, double>>& task : taskSeconds)
+	{
+		double total = 0.0, busiest = 0.0;
+
+		for (const std::pair<const std::size_t, double>& thread : task.second)
+		{
+			total += thread.second;
+			busiest = std::max(busiest, thread.second);
+		}
+
+		double mean = total / static_cast<double>(task.second.size());
+		pushRecent(s_history[task.first].imbalance, mean > 0.0 ? busiest / mean : 1.0);
+	}
+
+	s_frame++;
+	s_frameStart = frameEnd;
+
+	if (tracing && s_frame == s_traceFirst + s_traceCount)
+	{
+		writeTrace();
+		s_tracePath.clear();
+		s_traceEvents.clear();
+	}
+}
+
+std::size_t Profiler::getFrame()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_frame;
+}
+
+void Profiler::traceFrames(const std::string& path, std::size_t firstFrame, std::size_t numFrames)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	s_tracePath  = numFrames > 0 ? path : "";
+	s_traceFirst = firstFrame;
+	s_traceCount = numFrames;
+	s_traceEvents.clear();
+}
+
+bool Profiler::parseFrameRange(const std::string& range, std::size_t& firstFrame, std::size_t& numFrames)
+{
+	std::size_t colon = range.find(':');
+
+	if (colon == std::string::npos || range.find_first_not_of("0123456789:") != std::string::npos)
+		return false;
+
+	try
+	{
+		firstFrame = std::stoull(range.substr(0, colon));
+		numFrames  = std::stoull(range.substr(colon + 1));
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	return numFrames > 0;
+}
+
+std::vector<Profiler::PhaseStats> Profiler::getPhaseStats()
+{
+	std::vector<PhaseStats> stats;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	for (const std::pair<const std::string, PhaseHistory>& phase : s_history)
+	{
+		std::vector<double> sorted(phase.second.seconds.begin(), phase.second.seconds.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		PhaseStats phaseStats;
+		phaseStats.name      = phase.first;
+		phaseStats.numFrames = sorted.size();
+		phaseStats.p50       = percentile(sorted, 0.5);
+		phaseStats.p90       = percentile(sorted, 0.9);
+		phaseStats.p99       = percentile(sorted, 0.99);
+		phaseStats.max       = sorted.empty() ? 0.0 : sorted.back();
+		phaseStats.imbalance = 0.0;
+
+		for (double imbalance : phase.second.imbalance)
+			phaseStats.imbalance += imbalance / static_cast<double>(phase.second.imbalance.size());
+
+		stats.push_back(phaseStats);
+	}
+
+	std::sort(stats.begin(), stats.end(), [](const PhaseStats& a, const PhaseStats& b){ return a.p50 > b.p50; });
+
+	return stats;
+}
+
+void Profiler::printPhaseStats()
+{
+	std::vector<PhaseStats> stats = getPhaseStats();
+
+	std::cout << "Phase timings over the last " << WINDOW_FRAMES << " frames (ms per frame):" << std::endl;
+	std::cout << "  phase                   frames       p50       p90       p99       max  imbalance" << std::endl;
+
+	for (const PhaseStats& phase : stats)
+	{
+		std::cout << std::fixed << std::setprecision(3)
+		          << "  " << std::left << std::setw(22) << phase.name << std::right
+		          << std::setw(8) << phase.numFrames
+		          << std::setw(10) << phase.p50 * 1e3 << std::setw(10) << phase.p90 * 1e3
+		          << std::setw(10) << phase.p99 * 1e3 << std::setw(10) << phase.max * 1e3;
+
+		if (phase.imbalance > 0.0)
+			std::cout << std::setprecision(2) << std::setw(11) << phase.imbalance;
+
+		std::cout << std::defaultfloat << std::endl;
+	}
+}
+
+const char* Profiler::currentScope()
+{
+	return t_scope;
+}
+
+std::int64_t Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+}
+
+Profiler::ScopedTimer::ScopedTimer(const char* name, bool isTask)
+	: m_name(name != nullptr ? name : "ThreadPool::run"),
+	  m_outerScope(nullptr),
+	  m_start(0),
+	  m_isTask(isTask),
+	  m_active(isEnabled())
+{
+	if (!m_active)
+		return;
+
+	if (!m_isTask)
+	{
+		m_outerScope = t_scope;
+		t_scope = m_name;
+	}
+
+	m_start = now();
+}
+
+Profiler::ScopedTimer::~ScopedTimer()
+{
+	if (!m_active)
+		return;
+
+	std::int64_t end = now();
+
+	if (!m_isTask)
+		t_scope = m_outerScope;
+
+	threadLog().events.push_back({ m_name, m_start, end, m_isTask });
+}
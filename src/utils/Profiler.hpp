@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Scoped timers for the phases of each frame, on every thread.
+ *
+ * A phase is timed by putting PROFILE_SCOPE("name") at the top
+ * of a block; the timer records the block's start and end in
+ * a buffer belonging to the thread, with no locking. Work run
+ * by a ThreadPool is recorded on each thread as a task, named
+ * after the innermost scope of the thread calling run(), so
+ * the time every worker spends on each phase can be compared.
+ * Names must be string literals (or otherwise live forever).
+ *
+ * Once per frame (or step, when running headless), the driving
+ * thread calls nextFrame(), which collects every thread's
+ * events. For each name, it keeps the total time spent in the
+ * phase on the last WINDOW_FRAMES frames, from which rolling
+ * percentiles are taken (see getPhaseStats()), and for tasks
+ * the imbalance between the threads: the busiest thread's time
+ * over the mean thread's. A window of frames can also be
+ * written as a trace in the Chrome trace event format, which
+ * chrome://tracing and https://ui.perfetto.dev display as a
+ * timeline with a row per thread.
+ *
+ * Profiling is off until setEnabled(true), and a disabled
+ * timer costs one relaxed atomic load. Configuring with
+ * TORUSPARTICLES_ENABLE_PROFILING=OFF compiles the timers out
+ * entirely. nextFrame() must be called while no other thread
+ * is inside a timed scope (e.g. between calls to
+ * ThreadPool::run()), as it reads their buffers.
+ */
+
+class Profiler
+{
+public:
+	struct PhaseStats
+	{
+		std::string name;
+		std::size_t numFrames; // Frames in the window the phase ran in
+		double      p50;       // Percentiles of the time spent per frame, in seconds
+		double      p90;
+		double      p99;
+		double      max;
+		double      imbalance; // Mean ratio of the busiest thread's task time to the mean thread's (0 if not run as a task)
+	};
+
+	static const std::size_t WINDOW_FRAMES = 256;
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	static void setThreadName(const std::string& name); // Name of the calling thread in traces
+
+	// Close the current frame, collecting the events of every thread
+	static void nextFrame();
+	static std::size_t getFrame(); // Index of the current frame, counting from 0
+
+	// Write the frames [firstFrame, firstFrame + numFrames) to a trace file once the last has finished
+	static void traceFrames(const std::string& path, std::size_t firstFrame, std::size_t numFrames);
+	static bool parseFrameRange(const std::string& range, std::size_t& firstFrame, std::size_t& numFrames); // "FIRST:COUNT"
+
+	static std::vector<PhaseStats> getPhaseStats(); // Sorted by decreasing median time
+	static void printPhaseStats();
+
+	static const char* currentScope(); // Name of the calling thread's innermost scope, or nullptr
+
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(const char* name, bool isTask = false);
+		~ScopedTimer();
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		const char*   m_name;
+		const char*   m_outerScope;
+		std::int64_t  m_start;
+		bool          m_isTask;
+		bool          m_active;
+	};
+
+private:
+	static std::int64_t now(); // Nanoseconds since the profiler started
+};
+
+#ifdef TORUSPARTICLES_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_TASK(name) Profiler::ScopedTimer PROFILE_CONCAT(profileTask, __LINE__)(name, true)
+#define PROFILE_CURRENT_SCOPE() Profiler::currentScope()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_TASK(name)
+#define PROFILE_CURRENT_SCOPE() nullptr
+#endif
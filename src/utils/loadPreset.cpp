@@ -38,6 +38,16 @@ Preset loadPreset(const std::string& filepath)
 	preset.dt = jsonTotal["dt"].asFloat();
 	preset.worldAspectRatio = jsonTotal["worldAspectRatio"].asFloat();
 	preset.antialiasing = jsonTotal["antialiasing"].asBool();
+	preset.solver = jsonTotal.get("solver", "SpatialHash").asString(); // Optional
+	preset.numThreads = jsonTotal.get("numThreads", 0).asUInt(); // Optional
+	preset.autoTuneGrid = jsonTotal.get("autoTuneGrid", true).asBool(); // Optional
+	preset.reorderInterval = jsonTotal.get("reorderInterval", 0).asUInt(); // Optional
+	preset.neighbourSkin = jsonTotal.get("neighbourSkin", 0.0f).asFloat(); // Optional
+	preset.incrementalGrid = jsonTotal.get("incrementalGrid", false).asBool(); // Optional
+	preset.pinThreads = jsonTotal.get("pinThreads", false).asBool(); // Optional
+	preset.hugePages = jsonTotal.get("hugePages", "off").asString(); // Optional
+	preset.statsInterval = jsonTotal.get("statsInterval", 0).asUInt(); // Optional
+	preset.seed = jsonTotal.get("seed", 0).asUInt64(); // Optional
 	
 	std::vector<BallType>& ballTypes = preset.ballTypes;
 
@@ -99,6 +109,11 @@ Preset loadPreset(const std::string& filepath)
 		std::cout << "Error: worldAspectRatio must be positive" << std::endl;
 		return preset;
 	}
+	if (preset.hugePages != "off" && preset.hugePages != "thp" && preset.hugePages != "hugetlb")
+	{
+		std::cout << "Error: hugePages must be \"off\", \"thp\" or \"hugetlb\"" << std::endl;
+		return preset;
+	}
 
 	// Successful load
 	preset.loadSuccessful = true;
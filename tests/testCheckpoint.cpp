@@ -0,0 +1,226 @@
+/**
+ ************** TORUS PARTICLE SIMULATOR (CHECKPOINT TEST) **************
+ *
+ * Checks that a checkpoint restores a run exactly.
+ *
+ * Each solver is run for a few steps and checkpointed, then
+ * the checkpoint is loaded back and compared with the solver's
+ * state field by field: every particle array bit for bit, the
+ * BallTypes, the world, the timestep and the step count. A
+ * second solver is then started from the checkpoint, and both
+ * are run on for more steps on one thread with a fixed grid,
+ * after which every particle (found by ID) must match bit for
+ * bit. EventDrivenSolver is skipped here, since it keeps its
+ * balls in double precision between steps, which checkpoints
+ * do not hold. Finally, a truncated copy of the file must be
+ * rejected.
+ *
+ * Usage:
+ *     ./TorusParticlesTestCheckpoint [DIRECTORY]
+ *
+ * Files are written to DIRECTORY (the system's temporary
+ * directory by default) and removed afterwards. Prints each
+ * case's result, and returns nonzero if any fails.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+
+#include "Checkpoint.hpp"
+#include "createSolver.hpp"
+
+static const std::size_t STEPS_BEFORE = 25; // Steps run before checkpointing
+static const std::size_t STEPS_AFTER  = 25; // Steps run by both solvers after restarting
+
+static BallType makeBallType(float mass, float radius, std::size_t count)
+{
+    BallType ballType;
+    ballType.mass = mass;
+    ballType.radius = radius;
+    ballType.count = count;
+    ballType.rgba = { 1.0f, 0.5f, 0.25f, 1.0f };
+    ballType.totalMomentum = { 0.5f, -0.25f };
+    ballType.wrapTexture = true;
+    ballType.render = false;
+    return ballType;
+}
+
+template <typename T>
+static bool sameBits(const BigArray<T>& a, const BigArray<T>& b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+static std::string compareParticles(const Particles& a, const Particles& b)
+/**
+ * Name the first array that differs between a and b (an
+ * empty string if none do).
+ */
+{
+    if (a.size() != b.size())
+        return "number of particles";
+    if (!sameBits(a.x, b.x))
+        return "x";
+    if (!sameBits(a.y, b.y))
+        return "y";
+    if (!sameBits(a.vx, b.vx))
+        return "vx";
+    if (!sameBits(a.vy, b.vy))
+        return "vy";
+    if (!sameBits(a.radius, b.radius))
+        return "radius";
+    if (!sameBits(a.invMass, b.invMass))
+        return "invMass";
+    if (!sameBits(a.typeindex, b.typeindex))
+        return "typeindex";
+    if (!sameBits(a.id, b.id))
+        return "id";
+
+    return "";
+}
+
+static std::string compareBallTypes(const std::vector<BallType>& a, const std::vector<BallType>& b)
+{
+    if (a.size() != b.size())
+        return "number of BallTypes";
+
+    for (std::size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].radius != b[i].radius || a[i].mass != b[i].mass || a[i].count != b[i].count ||
+            a[i].rgba != b[i].rgba || a[i].totalMomentum.x != b[i].totalMomentum.x ||
+            a[i].totalMomentum.y != b[i].totalMomentum.y ||
+            a[i].wrapTexture != b[i].wrapTexture || a[i].render != b[i].render)
+            return "BallType " + std::to_string(i);
+    }
+
+    return "";
+}
+
+static bool fail(const std::string& name, const std::string& message)
+{
+    std::cout << "FAILED " << name << ": " << message << std::endl;
+    return false;
+}
+
+static bool runCase(const std::string& name, const Preset& preset, const std::string& path, bool exactRestart)
+{
+    std::unique_ptr<Solver> solver = createSolver(preset);
+
+    if (!solver)
+        return fail(name, "no solver");
+
+    for (std::size_t step = 0; step < STEPS_BEFORE; step++)
+        solver->update(preset.dt);
+
+    {
+        CheckpointWriter writer;
+        writer.save(path, *solver, preset.dt, STEPS_BEFORE);
+        writer.wait();
+
+        if (writer.getNumWritten() != 1)
+            return fail(name, "checkpoint not written");
+    }
+
+    Checkpoint checkpoint;
+
+    if (!loadCheckpoint(path, checkpoint))
+        return fail(name, "checkpoint not loaded");
+
+    std::string difference = compareParticles(checkpoint.particles, solver->getParticles());
+    if (difference.empty())
+        difference = compareBallTypes(checkpoint.ballTypes, solver->getBallTypes());
+
+    if (!difference.empty())
+        return fail(name, "checkpoint differs from the solver in " + difference);
+
+    const World& world = solver->getWorld();
+
+    if (checkpoint.world.xMin != world.xMin || checkpoint.world.xMax != world.xMax ||
+        checkpoint.world.yMin != world.yMin || checkpoint.world.yMax != world.yMax)
+        return fail(name, "checkpoint differs from the solver in world");
+
+    if (checkpoint.dt != preset.dt || checkpoint.step != STEPS_BEFORE)
+        return fail(name, "checkpoint differs from the solver in dt or step");
+
+    // Restart from the checkpoint, as headless --restart does
+    Preset restartPreset           = preset;
+    restartPreset.ballTypes        = checkpoint.ballTypes;
+    restartPreset.worldAspectRatio = checkpoint.world.xWidth / checkpoint.world.yWidth;
+    restartPreset.dt               = checkpoint.dt;
+
+    std::unique_ptr<Solver> restarted = createSolver(restartPreset, checkpoint.world, std::move(checkpoint.particles));
+
+    if (!restarted)
+        return fail(name, "no restarted solver");
+
+    for (std::size_t step = 0; step < STEPS_AFTER; step++)
+    {
+        solver->update(preset.dt);
+        restarted->update(preset.dt);
+    }
+
+    const Particles& original  = solver->getParticles();
+    const Particles& continued = restarted->getParticles();
+
+    for (std::size_t id = 0; exactRestart && id < original.size(); id++)
+    {
+        std::size_t i = solver->getSlot(id);
+        std::size_t j = restarted->getSlot(id);
+
+        if (std::memcmp(&original.x[i], &continued.x[j], sizeof(float)) != 0 ||
+            std::memcmp(&original.y[i], &continued.y[j], sizeof(float)) != 0 ||
+            std::memcmp(&original.vx[i], &continued.vx[j], sizeof(float)) != 0 ||
+            std::memcmp(&original.vy[i], &continued.vy[j], sizeof(float)) != 0)
+            return fail(name, "restarted run differs from the original at particle " + std::to_string(id));
+    }
+
+    // A truncated file must be rejected rather than misread
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+
+    Checkpoint truncated;
+    std::cout << "(expecting an error) ";
+    if (loadCheckpoint(path, truncated))
+        return fail(name, "truncated checkpoint loaded");
+
+    std::cout << "ok     " << name << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::filesystem::path directory = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path();
+    std::string path = (directory / "TorusParticlesTestCheckpoint.ckp").string();
+
+    Preset preset;
+    preset.dt = 0.01f;
+    preset.worldAspectRatio = 1.5f;
+    preset.antialiasing = false;
+    preset.loadSuccessful = true;
+    preset.numThreads = 1;
+    preset.autoTuneGrid = false; // So the restarted solver's grid matches the original's
+    preset.seed = 7;
+    preset.ballTypes = { makeBallType(6.4f, 0.1f, 3), makeBallType(1.5f, 0.03f, 40), makeBallType(0.1f, 0.006f, 1500) };
+
+    int numFailed = 0;
+
+    for (const char* solverName : { "SpatialHash", "SweepAndPrune", "EventDriven" })
+    {
+        preset.solver = solverName;
+        numFailed += !runCase(solverName, preset, path, preset.solver != "EventDriven");
+    }
+
+    std::remove(path.c_str());
+
+    if (numFailed > 0)
+    {
+        std::cout << numFailed << " cases failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ ************** TORUS PARTICLE SIMULATOR (PAIR TEST) **************
+ *
+ * Checks that the solvers find exactly the overlapping pairs a
+ * brute-force search finds, on workloads mixing ball sizes.
+ *
+ * Before each step, every pair of balls is compared at its
+ * nearest image on the torus. After the step, the solver's
+ * SolverStats must report as many overlapping pairs (and as
+ * many across the edges of the world) as were found, so a
+ * missed pair, a pair found twice or a pair found at the wrong
+ * image fails the test. Pairs lying within rounding of
+ * touching may be counted either way.
+ *
+ * SpatialHashSolver is run with its grid rebuilt every step
+ * and updated incrementally, with neighbour lists, with
+ * particles reordered along the space-filling curve, and with
+ * all three at once, on one and several threads.
+ * SweepAndPruneSolver is run on one and several threads.
+ *
+ * Usage:
+ *     ./TorusParticlesTestPairs
+ *
+ * Prints each case's result, and returns nonzero if any fails.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+
+#include "createSolver.hpp"
+
+static const std::size_t NUM_STEPS = 110; // Long enough for the grid to be auto-tuned once
+
+struct PairCounts
+{
+    std::size_t certain        = 0; // Pairs overlapping by more than rounding
+    std::size_t possible       = 0; // Pairs overlapping or within rounding of touching
+    std::size_t certainWrapped = 0; // The same, for pairs across the edges of the world
+    std::size_t possibleWrapped = 0;
+};
+
+static BallType makeBallType(float mass, float radius, std::size_t count)
+{
+    BallType ballType;
+    ballType.mass = mass;
+    ballType.radius = radius;
+    ballType.count = count;
+    ballType.rgba = { 1.0f, 1.0f, 1.0f, 1.0f };
+    ballType.totalMomentum = { 0.0f, 0.0f };
+    ballType.wrapTexture = true;
+    ballType.render = true;
+    return ballType;
+}
+
+static Preset makePreset(const std::string& workload)
+/**
+ * The mixed-size workloads: the sizes of preset2.json and
+ * preset5.json (the latter in a world 3 times wider than it
+ * is tall), and a few large balls among many small ones
+ * moving slowly.
+ */
+{
+    Preset preset;
+    preset.dt = 0.01f;
+    preset.worldAspectRatio = 1.0f;
+    preset.antialiasing = false;
+    preset.loadSuccessful = true;
+
+    if (workload == "polydisperse")
+    {
+        preset.ballTypes = { makeBallType(6.4f, 0.15f, 2), makeBallType(3.4f, 0.07f, 10),
+                             makeBallType(1.5f, 0.04f, 30), makeBallType(0.1f, 0.005f, 1500) };
+    }
+    else if (workload == "anisotropic")
+    {
+        preset.worldAspectRatio = 3.0f;
+        preset.ballTypes = { makeBallType(6.4f, 0.09f, 4), makeBallType(3.4f, 0.04f, 20),
+                             makeBallType(1.5f, 0.025f, 60), makeBallType(0.5f, 0.015f, 120) };
+    }
+    else
+    {
+        preset.dt = 0.001f;
+        preset.ballTypes = { makeBallType(5.0f, 0.1f, 30), makeBallType(1.0f, 0.006f, 1500) };
+    }
+
+    return preset;
+}
+
+static PairCounts countPairs(const Solver& solver)
+{
+    const Particles& particles = solver.getParticles();
+    const World&     world     = solver.getWorld();
+    const float      tolerance = 1.0e-5f;
+
+    PairCounts counts;
+
+    for (std::size_t i = 0; i < particles.size(); i++)
+    {
+        for (std::size_t j = i + 1; j < particles.size(); j++)
+        {
+            float dx = particles.x[i] - particles.x[j];
+            float dy = particles.y[i] - particles.y[j];
+
+            // Nearest image
+            bool wrapped = std::abs(dx) > 0.5f * world.xWidth || std::abs(dy) > 0.5f * world.yWidth;
+            dx -= world.xWidth * std::round(dx / world.xWidth);
+            dy -= world.yWidth * std::round(dy / world.yWidth);
+
+            float distSq    = dx * dx + dy * dy;
+            float radiusSum = particles.radius[i] + particles.radius[j];
+            float touchSq   = radiusSum * radiusSum;
+
+            if (distSq < touchSq * (1.0f - tolerance))
+            {
+                counts.certain++;
+                counts.certainWrapped += wrapped;
+            }
+
+            if (distSq <= touchSq * (1.0f + tolerance))
+            {
+                counts.possible++;
+                counts.possibleWrapped += wrapped;
+            }
+        }
+    }
+
+    return counts;
+}
+
+static bool runCase(const std::string& name, const std::string& workload, Preset preset)
+{
+    std::unique_ptr<Solver> solver = createSolver(preset);
+
+    if (!solver)
+        return false;
+
+    std::size_t numPairs = 0;
+
+    for (std::size_t step = 0; step < NUM_STEPS; step++)
+    {
+        PairCounts counts = countPairs(*solver);
+
+        solver->update(preset.dt);
+
+        const SolverStats& stats = solver->getStats();
+
+        if (stats.overlapsFound < counts.certain || stats.overlapsFound > counts.possible ||
+            stats.wrappedPairs < counts.certainWrapped || stats.wrappedPairs > counts.possibleWrapped)
+        {
+            std::cout << "FAILED " << name << " on " << workload << " at step " << step << ": found "
+                      << stats.overlapsFound << " pairs (" << stats.wrappedPairs << " across edges), brute force found "
+                      << counts.certain << " to " << counts.possible << " (" << counts.certainWrapped << " to "
+                      << counts.possibleWrapped << " across edges)" << std::endl;
+            return false;
+        }
+
+        numPairs += stats.overlapsFound;
+    }
+
+    std::cout << "ok     " << name << " on " << workload << " (" << numPairs << " pairs)" << std::endl;
+    return true;
+}
+
+int main()
+{
+    struct Case
+    {
+        std::string  name;
+        std::string  solver;
+        unsigned int numThreads;
+        bool         incrementalGrid;
+        float        neighbourSkin;   // As a fraction of the smallest radius
+        unsigned int reorderInterval;
+    };
+
+    const std::vector<Case> cases = {
+        { "SpatialHash",                        "SpatialHash",   1, false, 0.0f, 0 },
+        { "SpatialHash, 3 threads",             "SpatialHash",   3, false, 0.0f, 0 },
+        { "SpatialHash incremental",            "SpatialHash",   1, true,  0.0f, 0 },
+        { "SpatialHash incremental, 3 threads", "SpatialHash",   3, true,  0.0f, 0 },
+        { "SpatialHash neighbour lists",        "SpatialHash",   1, false, 0.5f, 0 },
+        { "SpatialHash reordered",              "SpatialHash",   1, false, 0.0f, 7 },
+        { "SpatialHash all, 3 threads",         "SpatialHash",   3, true,  0.5f, 7 },
+        { "SweepAndPrune",                      "SweepAndPrune", 1, false, 0.0f, 0 },
+        { "SweepAndPrune, 3 threads",           "SweepAndPrune", 3, false, 0.0f, 0 },
+    };
+
+    const std::vector<std::string> workloads = { "polydisperse", "anisotropic", "dense" };
+
+    int numFailed = 0;
+
+    for (const std::string& workload : workloads)
+    {
+        for (const Case& testCase : cases)
+        {
+            Preset preset = makePreset(workload);
+
+            float minRadius = preset.ballTypes[0].radius;
+            for (const BallType& ballType : preset.ballTypes)
+                minRadius = std::min(minRadius, ballType.radius);
+
+            preset.solver          = testCase.solver;
+            preset.numThreads      = testCase.numThreads;
+            preset.incrementalGrid = testCase.incrementalGrid;
+            preset.neighbourSkin   = testCase.neighbourSkin * minRadius;
+            preset.reorderInterval = testCase.reorderInterval;
+
+            numFailed += !runCase(testCase.name, workload, preset);
+        }
+    }
+
+    if (numFailed > 0)
+    {
+        std::cout << numFailed << " cases failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+/**
+ ************** TORUS PARTICLE SIMULATOR (TRAJECTORY TEST) **************
+ *
+ * Checks that trajectories play back what was recorded.
+ *
+ * A solver is run while a TrajectoryWriter records it, and the
+ * position of every ball is kept at each step recorded. The
+ * file is then read back with a TrajectoryReader, and checked
+ * against the run: the world, timestep, BallTypes, IDs and
+ * BallType of each recorded ball, and every frame's positions,
+ * which must lie within half a quantisation step of the balls'
+ * (at the nearest image, as the world wraps). Frames are read
+ * forwards, backwards and in a scattered order, so decoding
+ * starts both from keyframes and from the previous frame.
+ * Frames may be dropped if the writer falls behind, but those
+ * written must match.
+ *
+ * The file is then cut short by a byte, losing its index as a
+ * crash would, and must still yield every frame written.
+ *
+ * Cases record every ball and a subset of tracers, at full
+ * and reduced precision.
+ *
+ * Usage:
+ *     ./TorusParticlesTestTrajectory [DIRECTORY]
+ *
+ * Files are written to DIRECTORY (the system's temporary
+ * directory by default) and removed afterwards. Prints each
+ * case's result, and returns nonzero if any fails.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+
+#include "Trajectory.hpp"
+#include "createSolver.hpp"
+
+static const std::size_t NUM_STEPS = 60;
+
+static BallType makeBallType(float mass, float radius, std::size_t count)
+{
+    BallType ballType;
+    ballType.mass = mass;
+    ballType.radius = radius;
+    ballType.count = count;
+    ballType.rgba = { 0.25f, 0.5f, 1.0f, 1.0f };
+    ballType.totalMomentum = { 0.0f, 1.0f };
+    ballType.wrapTexture = false;
+    ballType.render = true;
+    return ballType;
+}
+
+struct Positions // Of every ball, by ID
+{
+    std::vector<float> x;
+    std::vector<float> y;
+};
+
+static bool fail(const std::string& name, const std::string& message)
+{
+    std::cout << "FAILED " << name << ": " << message << std::endl;
+    return false;
+}
+
+static bool checkFrame(TrajectoryReader& reader, std::size_t frame, const std::map<std::uint64_t, Positions>& recorded,
+                       unsigned int numBits, std::string& message)
+{
+    std::vector<float> x, y;
+
+    if (!reader.readFrame(frame, x, y))
+    {
+        message = "frame " + std::to_string(frame) + " not read";
+        return false;
+    }
+
+    auto found = recorded.find(reader.getStep(frame));
+
+    if (found == recorded.end())
+    {
+        message = "frame " + std::to_string(frame) + " has a step that was not recorded";
+        return false;
+    }
+
+    const World&     world     = reader.getWorld();
+    const Positions& positions = found->second;
+    const float      xStep     = world.xWidth / static_cast<float>(std::uint64_t(1) << numBits);
+    const float      yStep     = world.yWidth / static_cast<float>(std::uint64_t(1) << numBits);
+
+    for (std::size_t i = 0; i < reader.getNumParticles(); i++)
+    {
+        const std::uint32_t id = reader.getIds()[i];
+
+        float dx = x[i] - positions.x[id];
+        float dy = y[i] - positions.y[id];
+        dx -= world.xWidth * std::round(dx / world.xWidth);
+        dy -= world.yWidth * std::round(dy / world.yWidth);
+
+        // Half a step, and a little for rounding
+        if (std::abs(dx) > 0.501f * xStep + 1.0e-6f || std::abs(dy) > 0.501f * yStep + 1.0e-6f)
+        {
+            message = "frame " + std::to_string(frame) + " places ball " + std::to_string(id) + " "
+                    + std::to_string(std::max(std::abs(dx) / xStep, std::abs(dy) / yStep)) + " steps away";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool runCase(const std::string& name, const Preset& preset, const std::string& path,
+                    std::size_t numTracers, unsigned int numBits)
+{
+    std::unique_ptr<Solver> solver = createSolver(preset);
+
+    if (!solver)
+        return fail(name, "no solver");
+
+    const std::size_t interval         = 2;
+    const std::size_t keyframeInterval = 5;
+
+    std::map<std::uint64_t, Positions> recorded;
+    std::size_t numWritten = 0;
+
+    {
+        TrajectoryWriter writer(path, *solver, preset.dt, interval, numTracers, numBits, keyframeInterval);
+
+        if (!writer.isOpen())
+            return fail(name, "trajectory not opened");
+
+        for (std::uint64_t step = 0; step <= NUM_STEPS; step++)
+        {
+            if (step % interval == 0)
+            {
+                const Particles& particles = solver->getParticles();
+                Positions& positions = recorded[step];
+
+                positions.x.resize(particles.size());
+                positions.y.resize(particles.size());
+
+                for (std::size_t id = 0; id < particles.size(); id++)
+                {
+                    positions.x[id] = particles.x[solver->getSlot(id)];
+                    positions.y[id] = particles.y[solver->getSlot(id)];
+                }
+            }
+
+            writer.record(*solver, step);
+            solver->update(preset.dt);
+        }
+
+        writer.close();
+        numWritten = writer.getNumWritten();
+
+        if (numWritten + writer.getNumDropped() != recorded.size())
+            return fail(name, "frames written and dropped don't add up to the frames recorded");
+    }
+
+    std::string message;
+
+    {
+        TrajectoryReader reader(path);
+
+        if (!reader.isOpen())
+            return fail(name, "trajectory not read");
+
+        const World& world = solver->getWorld();
+
+        if (reader.getNumFrames() != numWritten)
+            return fail(name, std::to_string(reader.getNumFrames()) + " frames read, " + std::to_string(numWritten) + " written");
+
+        if (reader.getDt() != preset.dt || reader.getWorld().xMin != world.xMin || reader.getWorld().xMax != world.xMax ||
+            reader.getWorld().yMin != world.yMin || reader.getWorld().yMax != world.yMax)
+            return fail(name, "timestep or world differ");
+
+        if (reader.getBallTypes().size() != solver->getBallTypes().size())
+            return fail(name, "BallTypes differ");
+
+        for (std::size_t type = 0; type < reader.getBallTypes().size(); type++)
+        {
+            const BallType& read = reader.getBallTypes()[type];
+            const BallType& run  = solver->getBallTypes()[type];
+
+            if (read.radius != run.radius || read.mass != run.mass || read.rgba != run.rgba || read.render != run.render)
+                return fail(name, "BallType " + std::to_string(type) + " differs");
+        }
+
+        const std::size_t expectedParticles = numTracers == 0 ? solver->getParticles().size() : numTracers;
+
+        if (reader.getNumParticles() != expectedParticles)
+            return fail(name, std::to_string(reader.getNumParticles()) + " balls recorded, expected " + std::to_string(expectedParticles));
+
+        for (std::size_t i = 0; i < reader.getNumParticles(); i++)
+        {
+            const std::uint32_t id = reader.getIds()[i];
+
+            if (reader.getTypeIndices()[i] != solver->getParticles().typeindex[solver->getSlot(id)])
+                return fail(name, "ball " + std::to_string(id) + " has the wrong BallType");
+        }
+
+        const std::size_t numFrames = reader.getNumFrames();
+
+        for (std::size_t frame = 0; frame < numFrames; frame++)
+            if (!checkFrame(reader, frame, recorded, numBits, message))
+                return fail(name, message + " (reading forwards)");
+
+        for (std::size_t frame = numFrames; frame-- > 0;)
+            if (!checkFrame(reader, frame, recorded, numBits, message))
+                return fail(name, message + " (reading backwards)");
+
+        for (std::size_t k = 0; k < numFrames; k++)
+            if (!checkFrame(reader, (k * 7 + 3) % numFrames, recorded, numBits, message))
+                return fail(name, message + " (reading scattered frames)");
+    }
+
+    // Lose the index, as if the writer had crashed before closing the file
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+
+    {
+        TrajectoryReader reader(path);
+
+        if (!reader.isOpen() || reader.getNumFrames() != numWritten)
+            return fail(name, "frames lost when reading a file without an index");
+
+        for (std::size_t frame = 0; frame < reader.getNumFrames(); frame++)
+            if (!checkFrame(reader, frame, recorded, numBits, message))
+                return fail(name, message + " (reading a file without an index)");
+    }
+
+    std::cout << "ok     " << name << " (" << numWritten << " frames)" << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::filesystem::path directory = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path();
+    std::string path = (directory / "TorusParticlesTestTrajectory.trj").string();
+
+    Preset preset;
+    preset.dt = 0.01f;
+    preset.worldAspectRatio = 2.0f;
+    preset.antialiasing = false;
+    preset.loadSuccessful = true;
+    preset.numThreads = 1;
+    preset.seed = 3;
+    preset.ballTypes = { makeBallType(6.4f, 0.1f, 3), makeBallType(1.5f, 0.03f, 40), makeBallType(0.1f, 0.006f, 2000) };
+
+    int numFailed = 0;
+
+    numFailed += !runCase("every ball, 16 bits", preset, path, 0, 16);
+    numFailed += !runCase("every ball, 10 bits", preset, path, 0, 10);
+    numFailed += !runCase("100 tracers, 16 bits", preset, path, 100, 16);
+    numFailed += !runCase("100 tracers, 20 bits", preset, path, 100, 20);
+
+    std::remove(path.c_str());
+
+    if (numFailed > 0)
+    {
+        std::cout << numFailed << " cases failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}